@@ -0,0 +1,226 @@
+#include <iostream>
+#include <chrono>
+#include <tuple>
+#include <list>
+#include <deque>
+#include <cstring>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <tokenizer_combo.hpp>
+#include <tensortype_inc.hpp>
+
+#include "memory.hpp"
+
+const size_t MEM_CTX_SIZE = 4 * 1024 * 1024 * 1024l;
+
+// Micro-batches are independent prompts kept in flight together, so stage 0 runs micro-batch i+1
+// while stage 1 runs micro-batch i. Every micro-batch holds one KV cache entry ( MAX_BATCH of DAG ).
+struct MicroBatch {
+    std::vector<int> id;
+    std::vector<int> mask;
+    std::vector<int> out_tokens;
+    bool eos;
+};
+
+struct BenchApplication {
+    BenchApplication() {
+        tokenizer_ = vt::build_tokenizer_qwen("./qwen.tiktoken");
+    }
+    ~BenchApplication() {
+        delete tokenizer_;
+    }
+
+    void write_all(const void* buf, size_t nbyte) {
+        vt_assert( vt::CollectiveContext::pipe_write(1, buf, nbyte) > 0, "write_all error");
+        vt_assert( vt::CollectiveContext::pipe_write(2, buf, nbyte) > 0, "write_all error");
+    }
+
+    void wait_all_ready() {
+        int dummy = -1;
+        vt::CollectiveContext::pipe_read(&dummy, sizeof(int));
+        vt_assert(dummy == 1, "wait_all_ready error");
+        dummy = -1;
+        vt::CollectiveContext::pipe_read(&dummy, sizeof(int));
+        vt_assert(dummy == 1, "wait_all_ready error");
+    }
+
+    const int micro_batches = 2;
+    const int max_output = 128;
+
+    // both stages get every request, stage 1 returns results in the same order
+    void submit(MicroBatch& mb) {
+        int batch = 1;
+        int len = mb.id.size();
+        write_all(&batch, sizeof(int));
+        write_all(&len, sizeof(int));
+        write_all(mb.id.data(), mb.id.size() * sizeof(int));
+        write_all(mb.mask.data(), mb.mask.size() * sizeof(int));
+    }
+
+    void run(int inflight) {
+        wait_all_ready();
+
+        const char* questions[] = {
+            "Tell me a story about the sea.",
+            "What is the capital of France, and why?",
+            "Write a short poem about autumn.",
+            "Explain how a transformer model works."
+        };
+
+        std::vector<MicroBatch> mbs(micro_batches);
+        for (int i = 0; i < micro_batches; i++) {
+            std::string prompt = "<|im_start|>system\nYou are a helpful assistant.<|im_end|>\n";
+            prompt = prompt + "<|im_start|>user\n" + questions[i % 4] + "<|im_end|>\n<|im_start|>assistant\n";
+            mbs[i].id = tokenizer_->encode(prompt);
+            mbs[i].mask.resize(mbs[i].id.size(), 1);
+            mbs[i].mask.back() = 2;
+            mbs[i].eos = false;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::deque<int> flight;
+        size_t total = 0;
+        for (int i = 0; i < micro_batches; i++) {
+            if ( (int)flight.size() == inflight ) {
+                break;
+            }
+            submit(mbs[i]);
+            flight.push_back(i);
+        }
+        int waiting = micro_batches - (int)flight.size();
+
+        while ( flight.size() > 0 ) {
+            int i = flight.front();
+            flight.pop_front();
+
+            int next = -1;
+            vt::CollectiveContext::pipe_read(&next, sizeof(int));
+            MicroBatch& mb = mbs[i];
+            if ( next == tokenizer_->token_eos() ) {
+                mb.eos = true;
+            } else {
+                mb.out_tokens.push_back(next);
+                mb.id.push_back(next);
+                mb.mask.back() = 1;
+                mb.mask.push_back(2);
+                total++;
+            }
+
+            // refill the pipeline, finished micro-batch gives its place to a waiting one
+            if ( !mb.eos && (int)mb.out_tokens.size() < max_output ) {
+                submit(mb);
+                flight.push_back(i);
+            } else if ( waiting > 0 ) {
+                int w = micro_batches - waiting;
+                waiting--;
+                submit(mbs[w]);
+                flight.push_back(w);
+            }
+        }
+        auto stop = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+
+        for (int i = 0; i < micro_batches; i++) {
+            std::cout << "########### micro-batch " << i << " : " << tokenizer_->decode( mbs[i].out_tokens ) << std::endl;
+        }
+        std::cout << "\n====== Generated " << total << " total tokens, micro-batches = " << micro_batches << ", in flight = " << inflight;
+        std::cout << ", using " << duration.count() / 1000.0 << " seconds ===== " << std::endl;
+
+        int n = -1;
+        write_all(&n, sizeof(int));
+    }
+
+private:
+    vt::Tokenizer* tokenizer_;
+};
+
+void do_inference(vt::Enviroment* env, const char* dag_file, const char* init_cmd, const char* main_cmd) {
+    {
+        std::string all_code = vt::fileToString(dag_file);
+
+        vt::DaG* init_bin = env->build(all_code);
+#ifdef _USING_DEVICE_CUDA_
+        env->stack().push_string("cuda");
+#endif
+#ifdef _USING_DEVICE_DCU_
+        env->stack().push_string("dcu");
+#endif
+        env->run(init_bin);
+        delete init_bin;
+    }
+    env->execute(init_cmd);
+
+    int ok = 1;
+    vt_assert( vt::CollectiveContext::pipe_write(0, &ok, sizeof(int)) > 0, "pipe_write error");
+
+    vt::DaG* target_cmd = env->build(main_cmd);
+
+    for (;;) {
+        int batches = -1;
+        int id = -1;
+        vt::CollectiveContext::pipe_read(&batches, sizeof(int));;
+        if ( batches <= 0) {
+            break;
+        }
+
+        vt::CollectiveContext::pipe_read(&id, sizeof(int));;
+        vt_assert(id > 0, "tokens can't must more than zero!");
+
+        env->stack().push_number(batches);
+        env->stack().push_number(id);
+        env->run(target_cmd);
+    }
+
+    delete target_cmd;
+}
+
+int main(int argc, char* argv[] ) {
+    if ( argc < 2 ) {
+        std::cout << "usage: ./bench [dag_file] [in flight micro-batches, 1 runs stages in turn] " << std::endl;
+        return -1;
+    }
+    const char* dag_file = argv[1];
+    int inflight = argc > 2 ? atoi(argv[2]) : 2;
+
+    // VT_LINK=pipe hands hidden states over by shared memory instead of nccl
+    const char* link = getenv("VT_LINK");
+    bool pipe = link != nullptr && strcmp(link, "pipe") == 0;
+    vt::CollectiveContext::boot_pipe(2);
+
+    if ( vt::CollectiveContext::pipe_rank == 0) {
+        BenchApplication* app = new BenchApplication();
+        app->run(inflight);
+        delete app;
+
+        // wait for all child processes finished
+        {
+            int status = 0;
+            while ( wait(&status) != -1) {
+            }
+        }
+    } else {
+        int rank = vt::CollectiveContext::pipe_rank;
+        vt::MemoryContext::boot( MEM_CTX_SIZE );
+#ifdef _USING_DEVICE_CUDA_
+        vt::ComputingContext::boot_cuda( rank - 1 );
+#endif
+#ifdef _USING_DEVICE_DCU_
+        vt::ComputingContext::boot_dcu( rank - 1 );
+#endif
+        vt::Enviroment* env = new vt::Enviroment();
+        env->insert_native_word("app.mem", MemoryCounting::creator);
+
+        if ( rank == 1 ) {
+            do_inference(env, dag_file, "gpu0_init", pipe ? "pipe0_main" : "gpu0_main");
+        } else {
+            do_inference(env, dag_file, "gpu1_init", pipe ? "pipe1_main" : "gpu1_main");
+        }
+
+        delete env;
+        vt::ComputingContext::shutdown();
+        vt::MemoryContext::shutdown();
+    }
+
+    vt::CollectiveContext::shutdown();
+}
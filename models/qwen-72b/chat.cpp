@@ -2,6 +2,7 @@
 #include <chrono>
 #include <tuple>
 #include <list>
+#include <cstring>
 #include <unistd.h>
 #include <sys/wait.h>
 
@@ -181,6 +182,10 @@ int main(int argc, char* argv[] ) {
         return -1;
     }
     const char* dag_file = argv[1];
+
+    // VT_LINK=pipe hands hidden states over by shared memory instead of nccl
+    const char* link = getenv("VT_LINK");
+    bool pipe = link != nullptr && strcmp(link, "pipe") == 0;
     vt::CollectiveContext::boot_pipe(2);
 
     if ( vt::CollectiveContext::pipe_rank == 0) {
@@ -200,7 +205,7 @@ int main(int argc, char* argv[] ) {
         vt::Enviroment* env = new vt::Enviroment();
         env->insert_native_word("app.mem", MemoryCounting::creator);
 
-        do_inference(env, dag_file, "gpu0_init", "gpu0_main");
+        do_inference(env, dag_file, "gpu0_init", pipe ? "pipe0_main" : "gpu0_main");
 
         delete env;
         vt::ComputingContext::shutdown();
@@ -212,7 +217,7 @@ int main(int argc, char* argv[] ) {
         vt::Enviroment* env = new vt::Enviroment();
         env->insert_native_word("app.mem", MemoryCounting::creator);
 
-        do_inference(env, dag_file, "gpu1_init", "gpu1_main");
+        do_inference(env, dag_file, "gpu1_init", pipe ? "pipe1_main" : "gpu1_main");
 
         delete env;
         vt::ComputingContext::shutdown();
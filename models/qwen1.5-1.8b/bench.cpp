@@ -10,6 +10,13 @@
 
 #include "memory.hpp"
 
+// VT_NBEST=1 sends the prompt once and forks it to batch rows sharing its KV cache ( gpu_nbest ),
+// else every row is a copy of the prompt ( gpu_main )
+static bool nbest_mode() {
+    const char* nbest = getenv("VT_NBEST");
+    return nbest != nullptr && atoi(nbest) != 0;
+}
+
 const size_t MEM_CTX_SIZE = 4 * 1024 * 1024 * 1024l;
 const char* batched_text = R"___(下面请仔细阅读。
 　　孔雀东南飞，五里一徘徊。
@@ -90,10 +97,11 @@ struct ChatApplication {
 
             std::cout << "########### Prompt Length = " << id.size() << std::endl;
 
+            const bool nbest = nbest_mode();
+            std::vector<std::vector<int>> row_ids(batch, id);
             std::vector<int> ids;
             std::vector<int> masks;
             std::vector<int> nexts;
-            std::vector<int> next{0};
 
             std::vector<int> out_tokens;
             auto start = std::chrono::high_resolution_clock::now();
@@ -101,15 +109,21 @@ struct ChatApplication {
                 ids.clear();
                 masks.clear();
 
-                for (int b = 0; b < batch; b ++) {
-                    ids.insert(ids.begin(), id.begin(), id.end());
-                    masks.insert(masks.begin(), mask.begin(), mask.end());
+                int first = nbest && t == 0;
+                int rows = first ? 1 : batch;
+                for (int b = 0; b < rows; b ++) {
+                    const std::vector<int>& row = nbest ? row_ids[b] : id;
+                    ids.insert(ids.end(), row.begin(), row.end());
+                    masks.insert(masks.end(), mask.begin(), mask.end());
                 }
                 nexts.resize(batch, 0);
 
                 int len = id.size();
-                write_all(&batch, sizeof(int));
+                write_all(&rows, sizeof(int));
                 write_all(&len, sizeof(int));
+                if ( nbest ) {
+                    write_all(&first, sizeof(int));
+                }
                 write_all(ids.data(), ids.size() * sizeof(int));
                 write_all(masks.data(), masks.size() * sizeof(int));
 
@@ -117,6 +131,9 @@ struct ChatApplication {
                 if ( nexts[0] == tokenizer_->token_eos() ) {
                     break;
                 }
+                for (int b = 0; b < batch; b++) {
+                    row_ids[b].push_back(nexts[b]);
+                }
                 out_tokens.push_back(nexts[0]);
                 id.push_back(nexts[0]);
                 mask.back() = 1;
@@ -170,7 +187,8 @@ private:
 
 void do_inference(vt::Enviroment* env, const char* dag_file) {
     const char* init_cmd = "gpu_init";
-    const char* main_cmd = "gpu_main";
+    const bool nbest = nbest_mode();
+    const char* main_cmd = nbest ? "gpu_nbest" : "gpu_main";
     {
         std::string all_code = vt::fileToString(dag_file);
 
@@ -184,12 +202,23 @@ void do_inference(vt::Enviroment* env, const char* dag_file) {
         env->run(init_bin);
         delete init_bin;
     }
+    if ( nbest ) {
+        // prompt's entry plus NBEST forked rows
+        env->execute("\"NBEST\" @ 1 + \"MAX_BATCH\" !");
+    }
     env->execute(init_cmd);
 
+    // VT_MEM_DUMP=1 prints memory tags and their allocators after init
+    const char* mem_dump = getenv("VT_MEM_DUMP");
+    if ( mem_dump != nullptr && atoi(mem_dump) != 0 ) {
+        vt::MemoryContext::dump();
+    }
+
     int ok = 1;
     vt_assert( vt::CollectiveContext::pipe_write(0, &ok, sizeof(int)) > 0, "pipe_write error");
 
     vt::DaG* target_cmd = env->build(main_cmd);
+    vt::DaG* first_cmd = env->build("\"NBEST_FIRST\" !");
 
     for (;;) {
         int batches = -1;
@@ -202,12 +231,20 @@ void do_inference(vt::Enviroment* env, const char* dag_file) {
         vt::CollectiveContext::pipe_read(&id, sizeof(int));;
         vt_assert(id > 0, "tokens can't must more than zero!");
 
+        if ( nbest ) {
+            int first = 0;
+            vt::CollectiveContext::pipe_read(&first, sizeof(int));
+            env->stack().push_number(first);
+            env->run(first_cmd);
+        }
+
         env->stack().push_number(batches);
         env->stack().push_number(id);
         env->run(target_cmd);
     }
 
     delete target_cmd;
+    delete first_cmd;
 }
 
 
@@ -53,7 +53,11 @@ struct ChatApplication {
             std::string new_user =  "<|im_start|>user\n" + text + "<|im_end|>\n";
             history.push_back(new_user);
             history.push_back("<|im_start|>assistant\n");
-            std::vector<int> input_tokens = build_from_history(history);
+            std::vector<int> input_tokens;
+            {
+                vt::TraceSpan span("tokenize", "app");
+                input_tokens = build_from_history(history);
+            }
 
             std::vector<int> id;
             std::vector<int> mask;
@@ -68,6 +72,7 @@ struct ChatApplication {
             auto start = std::chrono::high_resolution_clock::now();
             int next = -1;
             for ( int t = 0; t < (int)max_output; t++) {
+                vt::TraceSpan span("token", "app");
                 int batch = 1;
                 int len = id.size();
                 write_all(&batch, sizeof(int));
@@ -85,6 +90,7 @@ struct ChatApplication {
                 mask.back() = 1;
                 mask.push_back(2);
 
+                vt::TraceSpan decode_span("decode", "app");
                 std::string nstr = tokenizer_->decode(next);
                 //std::cout << nstr << std::flush;
                 printf("%s", nstr.c_str());
@@ -131,8 +137,11 @@ private:
     vt::Tokenizer* tokenizer_;
 };
 
-void do_inference(vt::Enviroment* env, const char* dag_file) {
-    const char* init_cmd = "gpu_init";
+void do_inference(vt::Enviroment* env, const char* dag_file, bool snapshot) {
+    // VT_SHARED=1 keeps one copy of weights in shared memory for all chat processes of the host ( inference_fp32.dag )
+    const char* shared_env = getenv("VT_SHARED");
+    const bool shared = shared_env != nullptr && atoi(shared_env) != 0;
+    const char* init_cmd = shared ? "gpu_shared_init" : "gpu_init";
     const char* main_cmd = "gpu_main";
     {
         std::string all_code = vt::fileToString(dag_file);
@@ -157,8 +166,29 @@ void do_inference(vt::Enviroment* env, const char* dag_file) {
 #endif
         env->run(init_bin);
         delete init_bin;
+
+        // VT_NUMA=shard splits linear weights by rows over NUMA nodes of the engine, VT_NUMA=interleave spreads them
+        const char* numa = getenv("VT_NUMA");
+        if ( numa != nullptr ) {
+            env->stack().push_string(numa);
+            env->execute("\"G_NUMA\" !");
+        }
+    }
+    if ( snapshot ) {
+        // first start converts & saves, later ones restore snapshot directly
+        env->execute("gpu_snapshot_init");
+        if ( env->stack().pop_number() == 0 ) {
+            env->execute("gpu_load gpu_snapshot_save");
+        }
+    } else {
+        env->execute(init_cmd);
+    }
+
+    // VT_MEM_DUMP=1 prints memory tags and their allocators after init
+    const char* mem_dump = getenv("VT_MEM_DUMP");
+    if ( mem_dump != nullptr && atoi(mem_dump) != 0 ) {
+        vt::MemoryContext::dump();
     }
-    env->execute(init_cmd);
 
     int ok = 1;
     vt_assert( vt::CollectiveContext::pipe_write(0, &ok, sizeof(int)) > 0, "pipe_write error");
@@ -182,19 +212,30 @@ void do_inference(vt::Enviroment* env, const char* dag_file) {
     }
 
     delete target_cmd;
+    if ( shared && !snapshot ) {
+        env->execute("gpu_shared_close");
+    }
 }
 
 
 
 int main(int argc, char* argv[] ) {
     if ( argc < 2 ) {
-        std::cout << "usage: ./chat [dag_file] " << std::endl;
+        std::cout << "usage: ./chat [dag_file] [snapshot]" << std::endl;
         return -1;
     }
     const char* dag_file = argv[1];
+    bool snapshot = argc > 2 && std::string(argv[2]) == "snapshot";
+
+    // VT_TRACE=/tmp/chat saves timeline of app and worker into /tmp/chat.json
+    const char* trace = getenv("VT_TRACE");
+    if ( trace != nullptr ) {
+        vt::TraceContext::boot(trace);
+    }
     vt::CollectiveContext::boot_pipe(1);
 
     if ( vt::CollectiveContext::pipe_rank == 0) {
+        vt::TraceContext::name("app");
         ChatApplication* app = new ChatApplication();
         app->run();
         delete app;
@@ -205,8 +246,18 @@ int main(int argc, char* argv[] ) {
             while ( wait(&status) != -1) {
             }
         }
+        vt::TraceContext::shutdown();
+        vt::TraceContext::merge();
     } else if ( vt::CollectiveContext::pipe_rank == 1) {
+        vt::TraceContext::name("worker 1");
         vt::MemoryContext::boot( MEM_CTX_SIZE );
+
+        // VT_THREADS=16 VT_CPUS=0-15 keeps the engine on its cores, replicas of one box don't share them
+        const char* threads = getenv("VT_THREADS");
+        const char* cpus = getenv("VT_CPUS");
+        if ( threads != nullptr || cpus != nullptr ) {
+            vt::ComputingContext::boot_threads(threads != nullptr ? atoi(threads) : 0, cpus != nullptr ? cpus : "");
+        }
 #ifdef _USING_DEVICE_CUDA_
         vt::ComputingContext::boot_cuda( 0 );
 #endif
@@ -224,10 +275,18 @@ int main(int argc, char* argv[] ) {
         vt::Enviroment* env = new vt::Enviroment();
         env->insert_native_word("app.mem", MemoryCounting::creator);
         env->insert_native_word("app.align", MemoryAlign::creator);
+        env->insert_pure_word("app.align");
+
+        // VT_DAG_CACHE=/tmp/dags keeps linked DAGs, later starts don't compile them again
+        const char* dag_cache = getenv("VT_DAG_CACHE");
+        if ( dag_cache != nullptr ) {
+            env->cache(dag_cache);
+        }
 
-        do_inference(env, dag_file);
+        do_inference(env, dag_file, snapshot);
 
         delete env;
+        vt::TraceContext::shutdown();
         vt::ComputingContext::shutdown();
         vt::MemoryContext::shutdown();
     }
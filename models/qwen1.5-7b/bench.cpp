@@ -9,6 +9,7 @@
 #include <tensortype_inc.hpp>
 
 #include "memory.hpp"
+#include "session.hpp"
 
 const size_t MEM_CTX_SIZE = 4 * 1024 * 1024 * 1024l;
 const char* batched_text = R"___(下面请仔细阅读。
@@ -80,47 +81,28 @@ struct ChatApplication {
             history.push_back("<|im_start|>assistant\n");
             std::vector<int> input_tokens = std::move( build_from_history(history) );
 
-            std::vector<int> id;
-            std::vector<int> mask;
-            for (size_t i = 0; i < input_tokens.size(); i++ ) {
-                id.push_back( input_tokens[i] );
-                mask.push_back(1);
-            }
-            mask.back() = 2;
-
-            std::cout << "########### Prompt Length = " << id.size() << std::endl;
+            std::cout << "########### Prompt Length = " << input_tokens.size() << std::endl;
 
-            std::vector<int> ids;
-            std::vector<int> masks;
+            // every session gets the prompt once, then only its sampled token
+            std::vector<int> handles;
+            std::vector<std::vector<int>> news;
+            for (int b = 0; b < batch; b++) {
+                handles.push_back( session_.open() );
+                news.push_back( input_tokens );
+            }
             std::vector<int> nexts;
-            std::vector<int> next{0};
 
             std::vector<int> out_tokens;
             auto start = std::chrono::high_resolution_clock::now();
             for ( int t = 0; t < (int)max_output; t++) {
-                ids.clear();
-                masks.clear();
-
-                for (int b = 0; b < batch; b ++) {
-                    ids.insert(ids.begin(), id.begin(), id.end());
-                    masks.insert(masks.begin(), mask.begin(), mask.end());
-                }
-                nexts.resize(batch, 0);
-
-                int len = id.size();
-                write_all(&batch, sizeof(int));
-                write_all(&len, sizeof(int));
-                write_all(ids.data(), ids.size() * sizeof(int));
-                write_all(masks.data(), masks.size() * sizeof(int));
-
-                vt::CollectiveContext::pipe_read(nexts.data(), nexts.size() * sizeof(int));
+                session_.step(handles, news, nexts);
                 if ( nexts[0] == tokenizer_->token_eos() ) {
                     break;
                 }
                 out_tokens.push_back(nexts[0]);
-                id.push_back(nexts[0]);
-                mask.back() = 1;
-                mask.push_back(2);
+                for (int b = 0; b < batch; b++) {
+                    news[b] = {nexts[b]};
+                }
 
                 if ( t == 1 ) {
                     start = std::chrono::high_resolution_clock::now();
@@ -139,11 +121,13 @@ struct ChatApplication {
             //std::cout << talk << std::endl;
             //talk = talk + "<|im_end|>\n";
             //history.push_back(talk);
+            for (int b = 0; b < batch; b++) {
+                session_.close( handles[b] );
+            }
             break;
         }
 
-        int n = -1;
-        write_all(&n, sizeof(int));
+        write_all(&SESSION_QUIT, sizeof(int));
     }
 
     std::vector<int> build_from_history(const std::list<std::string>& history) {
@@ -166,11 +150,13 @@ struct ChatApplication {
 
 private:
     vt::Tokenizer* tokenizer_;
+    SessionClient session_;
 };
 
 void do_inference(vt::Enviroment* env, const char* dag_file) {
     const char* init_cmd = "gpu_init";
     const char* main_cmd = "gpu_main";
+    const char* step_cmd = "gpu_session_main";
     {
         std::string all_code = vt::fileToString(dag_file);
 
@@ -194,25 +180,9 @@ void do_inference(vt::Enviroment* env, const char* dag_file) {
     int ok = 1;
     vt_assert( vt::CollectiveContext::pipe_write(0, &ok, sizeof(int)) > 0, "pipe_write error");
 
-    vt::DaG* target_cmd = env->build(main_cmd);
-
-    for (;;) {
-        int batches = -1;
-        int id = -1;
-        vt::CollectiveContext::pipe_read(&batches, sizeof(int));;
-        if ( batches <= 0) {
-            break;
-        }
-
-        vt::CollectiveContext::pipe_read(&id, sizeof(int));;
-        vt_assert(id > 0, "tokens can't must more than zero!");
-
-        env->stack().push_number(batches);
-        env->stack().push_number(id);
-        env->run(target_cmd);
+    SessionServer server(env, main_cmd, step_cmd);
+    while ( server.serve() ) {
     }
-
-    delete target_cmd;
 }
 
 
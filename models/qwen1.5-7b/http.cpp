@@ -18,6 +18,7 @@
 #include <tensortype_inc.hpp>
 
 #include "memory.hpp"
+#include "session.hpp"
 
 const size_t MEM_CTX_SIZE = 4 * 1024 * 1024 * 1024l;
 
@@ -83,8 +84,10 @@ struct ChatApplication {
     void run() {
         wait_all_ready();
 
-        std::list<std::string>  history;
-        history.push_back("<|im_start|>system\nYou are a helpful assistant.<|im_end|>\n");
+        // the conversation lives in worker's KV cache, only tokens of new turn are sent
+        const std::string system = "<|im_start|>system\nYou are a helpful assistant.<|im_end|>\n";
+        int handle = session_.open();
+        std::vector<int> pending = tokenizer_->encode(system);
 
         std::string text;
         while( readline(text) ) {
@@ -92,47 +95,35 @@ struct ChatApplication {
                 continue;
             }
             if ( text == "!" ) {
-                history.clear();
-                history.push_back("<|im_start|>system\nYou are a helpful assistant.<|im_end|>\n");
+                session_.close(handle);
+                handle = session_.open();
+                pending = tokenizer_->encode(system);
                 continue;
             }
 
             inferencing_ = true;
 
             std::string new_user =  "<|im_start|>user\n" + text + "<|im_end|>\n";
-            history.push_back(new_user);
-            history.push_back("<|im_start|>assistant\n");
-            std::vector<int> input_tokens = std::move( build_from_history(history) );
-
-            std::vector<int> id;
-            std::vector<int> mask;
-            for (size_t i = 0; i < input_tokens.size(); i++ ) {
-                id.push_back( input_tokens[i] );
-                mask.push_back(1);
+            auto turn = tokenizer_->encode(new_user + "<|im_start|>assistant\n");
+            pending.insert(pending.end(), turn.begin(), turn.end());
+            if ( pending.size() > max_input ) {
+                pending.erase(pending.begin(), pending.end() - max_input);
             }
-            mask.back() = 2;
 
             std::vector<int> out_tokens;
 
             auto start = std::chrono::high_resolution_clock::now();
             int next = -1;
+            std::vector<int> nexts;
             for ( int t = 0; t < (int)max_output; t++) {
-                int batch = 1;
-                int len = id.size();
-                write_all(&batch, sizeof(int));
-                write_all(&len, sizeof(int));
-                write_all(id.data(), id.size() * sizeof(int));
-                write_all(mask.data(), mask.size() * sizeof(int));
-
-                next = -1;
-                vt::CollectiveContext::pipe_read(&next, sizeof(int));
+                session_.step({handle}, {pending}, nexts);
+                next = nexts[0];
+                pending.clear();
                 if ( next == tokenizer_->token_eos() ) {
                     break;
                 }
                 out_tokens.push_back(next);
-                id.push_back(next);
-                mask.back() = 1;
-                mask.push_back(2);
+                pending.push_back(next);
 
                 std::string nstr = tokenizer_->decode(next);
 
@@ -152,25 +143,12 @@ struct ChatApplication {
             writetoken("");
             inferencing_ = false;
 
-            talk = talk + "<|im_end|>\n";
-            history.push_back(talk);
+            auto ending = tokenizer_->encode("<|im_end|>\n");
+            pending.insert(pending.end(), ending.begin(), ending.end());
         }
 
-        int n = -1;
-        write_all(&n, sizeof(int));
-    }
-
-    std::vector<int> build_from_history(const std::list<std::string>& history) {
-        std::vector<int> all_tokens;
-        for ( auto i = history.rbegin(); i != history.rend(); i++) {
-            auto one_talk = tokenizer_->encode( *i );
-            if ( one_talk.size() + all_tokens.size() >= max_input ) {
-                break;
-            }
-            all_tokens.insert( all_tokens.end(), one_talk.rbegin(), one_talk.rend() );
-        }
-        std::reverse(all_tokens.begin(), all_tokens.end());
-        return all_tokens;
+        session_.close(handle);
+        write_all(&SESSION_QUIT, sizeof(int));
     }
 
     void writetoken(std::string token) {
@@ -216,11 +194,13 @@ private:
     std::condition_variable ocv_;
 
     vt::Tokenizer* tokenizer_;
+    SessionClient session_;
 };
 
 void do_inference(vt::Enviroment* env, const char* dag_file) {
     const char* init_cmd = "gpu_init";
     const char* main_cmd = "gpu_main";
+    const char* step_cmd = "gpu_session_main";
     {
         std::string all_code = vt::fileToString(dag_file);
 
@@ -242,25 +222,9 @@ void do_inference(vt::Enviroment* env, const char* dag_file) {
     int ok = 1;
     vt_assert( vt::CollectiveContext::pipe_write(0, &ok, sizeof(int)) > 0, "pipe_write error");
 
-    vt::DaG* target_cmd = env->build(main_cmd);
-
-    for (;;) {
-        int batches = -1;
-        int id = -1;
-        vt::CollectiveContext::pipe_read(&batches, sizeof(int));;
-        if ( batches <= 0) {
-            break;
-        }
-
-        vt::CollectiveContext::pipe_read(&id, sizeof(int));;
-        vt_assert(id > 0, "tokens can't must more than zero!");
-
-        env->stack().push_number(batches);
-        env->stack().push_number(id);
-        env->run(target_cmd);
+    SessionServer server(env, main_cmd, step_cmd);
+    while ( server.serve() ) {
     }
-
-    delete target_cmd;
 }
 
 
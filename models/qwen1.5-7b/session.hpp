@@ -0,0 +1,115 @@
+#ifndef _SESSION_HPP_
+#define _SESSION_HPP_
+
+// A positive first int of a request keeps the old protocol, batch & tokens & full history of ids and masks.
+// Sessions hold their history in worker's KV cache, so a step only sends new tokens of each session.
+const int SESSION_QUIT = -1;
+const int SESSION_OPEN = -2;        // handle
+const int SESSION_STEP = -3;        // batch, tokens, handles[batch], ids[batch][tokens], lens[batch]
+const int SESSION_CLOSE = -4;       // handle
+
+struct SessionClient {
+    SessionClient() : next_handle_(0) {}
+
+    int open() {
+        int h = next_handle_++;
+        write_all(&SESSION_OPEN, sizeof(int));
+        write_all(&h, sizeof(int));
+        return h;
+    }
+
+    void close(int h) {
+        write_all(&SESSION_CLOSE, sizeof(int));
+        write_all(&h, sizeof(int));
+    }
+
+    // new tokens of handles[b] are news[b], sampled ids are returned in nexts
+    void step(const std::vector<int>& handles, const std::vector<std::vector<int>>& news, std::vector<int>& nexts) {
+        int batch = handles.size();
+        int tokens = 0;
+        std::vector<int> lens;
+        for (int b = 0; b < batch; b++) {
+            vt_assert( news[b].size() > 0, "Session step must have new tokens");
+            lens.push_back( news[b].size() );
+            tokens = std::max(tokens, (int)news[b].size() );
+        }
+
+        std::vector<int> ids(batch * tokens, 0);
+        for (int b = 0; b < batch; b++) {
+            std::copy( news[b].begin(), news[b].end(), ids.begin() + b * tokens);
+        }
+
+        write_all(&SESSION_STEP, sizeof(int));
+        write_all(&batch, sizeof(int));
+        write_all(&tokens, sizeof(int));
+        write_all(handles.data(), batch * sizeof(int));
+        write_all(ids.data(), ids.size() * sizeof(int));
+        write_all(lens.data(), batch * sizeof(int));
+
+        nexts.resize(batch, 0);
+        vt::CollectiveContext::pipe_read(nexts.data(), nexts.size() * sizeof(int));
+    }
+
+private:
+    void write_all(const void* buf, size_t nbyte) {
+        vt_assert( vt::CollectiveContext::pipe_write(1, buf, nbyte) > 0, "write_all error");
+    }
+
+    int next_handle_;
+};
+
+// worker side, DAGs of every request are built once
+struct SessionServer {
+    SessionServer(vt::Enviroment* env, const char* main_cmd, const char* step_cmd) : env_(env) {
+        main_bin_ = env_->build(main_cmd);
+        step_bin_ = env_->build(step_cmd);
+        open_bin_ = env_->build("gpu_session_open");
+        close_bin_ = env_->build("gpu_session_close");
+    }
+    ~SessionServer() {
+        delete main_bin_;
+        delete step_bin_;
+        delete open_bin_;
+        delete close_bin_;
+    }
+
+    // returns false when the app quits
+    bool serve() {
+        int batches = -1;
+        vt::CollectiveContext::pipe_read(&batches, sizeof(int));
+        if ( batches == SESSION_OPEN || batches == SESSION_CLOSE ) {
+            int handle = -1;
+            vt::CollectiveContext::pipe_read(&handle, sizeof(int));
+            env_->stack().push_number(handle);
+            env_->run( batches == SESSION_OPEN ? open_bin_ : close_bin_ );
+            return true;
+        }
+
+        vt::DaG* target = main_bin_;
+        if ( batches == SESSION_STEP ) {
+            vt::CollectiveContext::pipe_read(&batches, sizeof(int));
+            target = step_bin_;
+        }
+        if ( batches <= 0) {
+            return false;
+        }
+
+        int id = -1;
+        vt::CollectiveContext::pipe_read(&id, sizeof(int));
+        vt_assert(id > 0, "tokens can't must more than zero!");
+
+        env_->stack().push_number(batches);
+        env_->stack().push_number(id);
+        env_->run(target);
+        return true;
+    }
+
+private:
+    vt::Enviroment* env_;
+    vt::DaG* main_bin_;
+    vt::DaG* step_bin_;
+    vt::DaG* open_bin_;
+    vt::DaG* close_bin_;
+};
+
+#endif
@@ -32,6 +32,9 @@ struct TransformerComputing {
     virtual ComputingReturn io_save(tensor_t self, const char* fileName) {
         return OP_TODO_ERROR;
     }
+    virtual ComputingReturn io_mmap(tensor_t self, const char* fileName, bool populate) {
+        return OP_TODO_ERROR;
+    }
     virtual ComputingReturn io_dump(tensor_t self) {
         return OP_TODO_ERROR;
     }
@@ -56,6 +59,12 @@ struct TransformerComputing {
     virtual ComputingReturn io_pipe_write(tensor_t self, int n) {
         return OP_TODO_ERROR;
     }
+    virtual ComputingReturn io_pipe_send(tensor_t self, int n) {
+        return OP_TODO_ERROR;
+    }
+    virtual ComputingReturn io_pipe_recv(tensor_t self, int n) {
+        return OP_TODO_ERROR;
+    }
 
     virtual std::variant<ComputingReturn, size_t> op_sizeof(tensor_t self) {
         return OP_TODO_ERROR;
@@ -87,6 +96,12 @@ struct TransformerComputing {
     virtual std::variant<ComputingReturn, tensor_t> op_view_as(tensor_t self, size_t offset, const std::vector<size_t>& newShape, const char* dtype) {
         return OP_TODO_ERROR;
     }
+    virtual std::variant<ComputingReturn, tensor_t> op_view_strided(tensor_t self, size_t offset, const std::vector<size_t>& newShape, const std::vector<size_t>& newStrides) {
+        return OP_TODO_ERROR;
+    }
+    virtual ComputingReturn op_view_rebind(tensor_t self, tensor_t parent, size_t offset, const std::vector<size_t>& newShape) {
+        return OP_TODO_ERROR;
+    }
     virtual ComputingReturn op_reshape(tensor_t self, size_t offset, const std::vector<size_t>& newShape) {
         return OP_TODO_ERROR;
     }
@@ -138,6 +153,9 @@ struct TransformerComputing {
     virtual ComputingReturn op_attn(tensor_t self, tensor_t v, tensor_t attn) {
         return OP_TODO_ERROR;
     }
+    virtual ComputingReturn op_attn_score(tensor_t self, tensor_t score) {
+        return OP_TODO_ERROR;
+    }
     virtual ComputingReturn op_xattn(tensor_t self, tensor_t k, tensor_t v, tensor_t qk, tensor_t attn) {
         return OP_TODO_ERROR;
     }
@@ -147,6 +165,16 @@ struct TransformerComputing {
     virtual ComputingReturn op_silu_product(tensor_t self, tensor_t up, tensor_t dst) {
         return OP_TODO_ERROR;
     }
+    // fused words, same results with the sequence, intermediate ( y, c ) is written too
+    virtual ComputingReturn op_linear_add(tensor_t self, tensor_t w, tensor_t bias, tensor_t y, tensor_t r, tensor_t out) {
+        return OP_TODO_ERROR;
+    }
+    virtual ComputingReturn op_add_rmsnorm(tensor_t self, tensor_t b, tensor_t c, tensor_t scale, tensor_t norm2, tensor_t y, float eps) {
+        return OP_TODO_ERROR;
+    }
+    virtual ComputingReturn op_linear_silu_product(tensor_t self, tensor_t w, tensor_t bias, tensor_t y, tensor_t up, tensor_t out) {
+        return OP_TODO_ERROR;
+    }
     virtual std::variant<ComputingReturn, int> op_all_logits(tensor_t self, tensor_t mask, tensor_t lm_head, tensor_t output ) {
         return OP_TODO_ERROR;
     }
@@ -156,6 +184,9 @@ struct TransformerComputing {
     virtual std::variant<ComputingReturn, tensor_t> op_sampling_top3(tensor_t self, float temp) {
         return OP_TODO_ERROR;
     }
+    virtual ComputingReturn op_logprob_topk(tensor_t self, tensor_t ids, tensor_t logprob, float temp) {
+        return OP_TODO_ERROR;
+    }
     virtual ComputingReturn op_conv2d(tensor_t self, tensor_t weight, tensor_t bias, tensor_t dst, int stride, int padding) {
         return OP_TODO_ERROR;
     }
@@ -1,5 +1,26 @@
 #include <time.h>
+#include <glob.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <linux/mempolicy.h>
+#include <linux/futex.h>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "vt.hpp"
 #include "context.hpp"
@@ -7,42 +28,419 @@
 namespace vt {
 
 #ifdef _USING_DEVICE_DNNL_
-dnnl::engine* ComputingContext::dnnl_engine = nullptr;
-dnnl::stream* ComputingContext::dnnl_stream = nullptr;
+thread_local dnnl::engine* ComputingContext::dnnl_engine = nullptr;
+thread_local dnnl::stream* ComputingContext::dnnl_stream = nullptr;
+thread_local std::vector<dnnl::stream*> ComputingContext::dnnl_team_streams;
+thread_local dnnl::stream* ComputingContext::dnnl_team_stream = nullptr;
+#ifdef _DNNL_THREADPOOL_
+thread_local EnginePool* ComputingContext::dnnl_pool = nullptr;
+#endif
 #ifdef _DNNL_GPU_
-dnnl::engine* ComputingContext::dnnl_gpu_engine = nullptr;
-dnnl::stream* ComputingContext::dnnl_gpu_stream = nullptr;
+thread_local dnnl::engine* ComputingContext::dnnl_gpu_engine = nullptr;
+thread_local dnnl::stream* ComputingContext::dnnl_gpu_stream = nullptr;
 #endif
 #endif
 
 #ifdef _USING_DEVICE_CUDA_
-int ComputingContext::cuda_device = -1;
-cudaStream_t ComputingContext::cuda_stream = nullptr;
-cudaStream_t ComputingContext::assist_streams[ ALL_CUDA_STREAMS ];
-cudaEvent_t ComputingContext::events[ ALL_CUDA_EVENTS ];
-cublasHandle_t ComputingContext::cublas_handle = nullptr;
-cublasLtHandle_t ComputingContext::cublasLt_handle = nullptr;
-cudnnHandle_t ComputingContext::cudnn_handle = nullptr;
-void* ComputingContext::cuda_workspace = nullptr;
+thread_local int ComputingContext::cuda_device = -1;
+thread_local cudaStream_t ComputingContext::cuda_stream = nullptr;
+thread_local cudaStream_t ComputingContext::assist_streams[ ALL_CUDA_STREAMS ];
+thread_local cudaEvent_t ComputingContext::events[ ALL_CUDA_EVENTS ];
+thread_local cublasHandle_t ComputingContext::cublas_handle = nullptr;
+thread_local cublasLtHandle_t ComputingContext::cublasLt_handle = nullptr;
+thread_local cudnnHandle_t ComputingContext::cudnn_handle = nullptr;
+thread_local void* ComputingContext::cuda_workspace = nullptr;
 #endif
 
 #ifdef _USING_DEVICE_DCU_
-int ComputingContext::dcu_device = -1;
-hipStream_t ComputingContext::dcu_stream = nullptr;
-hipblasHandle_t ComputingContext::hipblas_handle = nullptr;
-void* ComputingContext::dcu_workspace = nullptr;
+thread_local int ComputingContext::dcu_device = -1;
+thread_local hipStream_t ComputingContext::dcu_stream = nullptr;
+thread_local hipblasHandle_t ComputingContext::hipblas_handle = nullptr;
+thread_local void* ComputingContext::dcu_workspace = nullptr;
 #endif
 
 #ifdef _USING_DEVICE_COREX_
-int ComputingContext::corex_device = -1;
-cudaStream_t ComputingContext::corex_stream = nullptr;
-cublasHandle_t ComputingContext::cxblas_handle = nullptr;
-void* ComputingContext::corex_workspace = nullptr;
+thread_local int ComputingContext::corex_device = -1;
+thread_local cudaStream_t ComputingContext::corex_stream = nullptr;
+thread_local cublasHandle_t ComputingContext::cxblas_handle = nullptr;
+thread_local void* ComputingContext::corex_workspace = nullptr;
+#endif
+
+thread_local int ComputingContext::team_threads = 1;
+thread_local void* ComputingContext::host_workspace = nullptr;
+thread_local size_t ComputingContext::workspace_size = 0;
+thread_local std::mt19937* ComputingContext::rng = nullptr;
+thread_local int ComputingContext::engine_threads = 0;
+thread_local std::vector<int> ComputingContext::engine_cpus;
+thread_local std::vector<int> ComputingContext::numa_nodes;
+thread_local std::vector<std::vector<int>> ComputingContext::numa_cpus;
+thread_local NumaPool* ComputingContext::numa_pool = nullptr;
+
+namespace threads {
+    // "0-3,8,10-11" to cpu ids
+    std::vector<int> parse_cpus(const std::string& cpus) {
+        std::vector<int> ret;
+        std::stringstream ss(cpus);
+        std::string item;
+        while ( std::getline(ss, item, ',') ) {
+            if ( item.empty() ) {
+                continue;
+            }
+            int a = 0, b = 0;
+            if ( sscanf(item.c_str(), "%d-%d", &a, &b) == 2 ) {
+                vt_assert(a <= b, "Wrong cpu range");
+                for (int c = a; c <= b; c++) {
+                    ret.push_back(c);
+                }
+            } else {
+                vt_assert(sscanf(item.c_str(), "%d", &a) == 1, "Wrong cpu list");
+                ret.push_back(a);
+            }
+        }
+        return ret;
+    }
+
+    // threads created later by the thread ( OpenMP workers ) inherit the mask
+    void pin(const int* cpus, size_t n) {
+        if ( n == 0 ) {
+            return;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (size_t i = 0; i < n; i++) {
+            CPU_SET(cpus[i], &set);
+        }
+        vt_assert(pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0, "Can't set cpu affinity");
+    }
+
+    // sizes OpenMP team of calling thread, every other member is pinned to one cpu, the team is
+    // reused by later parallel regions of the thread with same size
+    void pin_team(int n, const int* cpus, size_t ncpus) {
+#ifdef _OPENMP
+        omp_set_num_threads(n);
+        if ( ncpus == 0 ) {
+            return;
+        }
+        pin(cpus, ncpus);
+#pragma omp parallel num_threads(n)
+        {
+            // thread 0 is the caller, it keeps all cpus of the team
+            int i = omp_get_thread_num();
+            if ( i > 0 ) {
+                pin(&cpus[i % ncpus], 1);
+            }
+        }
+#else
+        pin(cpus, ncpus);
+#endif
+    }
+}
+
+namespace numa {
+    // nodes having some of cpus ( any cpu when it's empty ) in id order, and those cpus of every node
+    void nodes(const std::vector<int>& cpus, std::vector<int>& ids, std::vector<std::vector<int>>& node_cpus) {
+        ids.clear();
+        node_cpus.clear();
+        glob_t g;
+        if ( glob("/sys/devices/system/node/node[0-9]*", 0, nullptr, &g) != 0 ) {
+            return;
+        }
+        std::map<int, std::vector<int>> all;
+        for (size_t i = 0; i < g.gl_pathc; i++) {
+            std::string path = g.gl_pathv[i];
+            int id = atoi( path.c_str() + path.rfind("node") + 4 );
+
+            char line[4096] = {0};
+            FILE* f = fopen( (path + "/cpulist").c_str(), "r");
+            if ( f == nullptr ) {
+                continue;
+            }
+            if ( fgets(line, sizeof(line), f) == nullptr ) {
+                line[0] = 0;
+            }
+            fclose(f);
+            line[ strcspn(line, "\n") ] = 0;
+
+            std::vector<int> mine;
+            for (auto c : threads::parse_cpus(line)) {
+                if ( cpus.size() == 0 || std::find(cpus.begin(), cpus.end(), c) != cpus.end() ) {
+                    mine.push_back(c);
+                }
+            }
+            if ( mine.size() > 0 ) {
+                all[id] = mine;
+            }
+        }
+        globfree(&g);
+        for (auto& n : all) {
+            ids.push_back(n.first);
+            node_cpus.push_back(n.second);
+        }
+    }
+
+    // policy of pages not touched yet, kernels without NUMA ( or containers denying it ) leave them alone
+    void place(void* m, size_t len, int mode, const int* ids, size_t n) {
+        unsigned long mask[16] = {0};
+        for (size_t i = 0; i < n; i++) {
+            vt_assert(ids[i] >= 0 && ids[i] < (int)sizeof(mask) * 8, "Wrong NUMA node");
+            mask[ ids[i] / 64 ] |= 1ul << (ids[i] % 64);
+        }
+        if ( syscall(SYS_mbind, m, len, mode, mask, sizeof(mask) * 8 + 1, 0) != 0 ) {
+            static bool warned = false;
+            if ( !warned ) {
+                std::cout << "mbind failed, NUMA policy isn't applied: " << strerror(errno) << std::endl;
+                warned = true;
+            }
+        }
+    }
+}
+
+#ifdef _DNNL_THREADPOOL_
+// oneDNN built with threadpool runtime asks it to run parallel_for, workers are pinned like an OpenMP team
+struct EnginePool : public dnnl::threadpool_interop::threadpool_iface {
+    EnginePool(int n, const std::vector<int>& cpus) : n_(n) {
+        for (int i = 1; i < n; i++) {
+            int cpu = cpus.size() > 0 ? cpus[i % cpus.size()] : -1;
+            workers_.push_back( std::thread([this, i, cpu] {
+                if ( cpu >= 0 ) {
+                    threads::pin(&cpu, 1);
+                }
+                work(i);
+            }) );
+        }
+    }
+    ~EnginePool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        cond_.notify_all();
+        for (auto& w : workers_) {
+            w.join();
+        }
+    }
+
+    int get_num_threads() const override {
+        return n_;
+    }
+    bool get_in_parallel() const override {
+        return in_parallel_;
+    }
+    uint64_t get_flags() const override {
+        return 0;
+    }
+    // fn(i, n) for all i, the caller takes part, returns when all are done
+    void parallel_for(int n, const std::function<void(int, int)>& fn) override {
+        if ( n == 1 || in_parallel_ ) {
+            for (int i = 0; i < n; i++) {
+                fn(i, n);
+            }
+            return;
+        }
+        // an index is claimed together with its round in one word, so a worker late from last round
+        // fails its claim instead of taking an index of this round twice
+        uint32_t round;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            fn_ = &fn;
+            total_ = n;
+            pending_ = n;
+            round_++;
+            round = (uint32_t)round_;
+            claim_ = (uint64_t)round << 32;
+        }
+        cond_.notify_all();
+        run(round);
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+private:
+    void run(uint32_t round) {
+        in_parallel_ = true;
+        uint64_t c = claim_.load();
+        for (;;) {
+            if ( (uint32_t)(c >> 32) != round ) {
+                break;
+            }
+            if ( !claim_.compare_exchange_weak(c, c + 1) ) {
+                continue;
+            }
+            // round is still current after claiming, fn_ and total_ belong to it
+            int i = (int)(uint32_t)c;
+            int total = total_;
+            if ( i >= total ) {
+                break;
+            }
+            (*fn_)(i, total);
+            if ( --pending_ == 0 ) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_.notify_all();
+            }
+            c = claim_.load();
+        }
+        in_parallel_ = false;
+    }
+    void work(int id) {
+        size_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [&] { return quit_ || round_ != seen; });
+                if ( quit_ ) {
+                    return;
+                }
+                seen = round_;
+            }
+            run((uint32_t)seen);
+        }
+    }
+
+    const int n_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::condition_variable done_;
+    std::atomic<const std::function<void(int, int)>*> fn_{nullptr};
+    std::atomic<int> total_{0};
+    std::atomic<uint64_t> claim_{0};                // round << 32 | next index
+    std::atomic<int> pending_;
+    size_t round_ = 0;
+    bool quit_ = false;
+    static thread_local bool in_parallel_;
+};
+thread_local bool EnginePool::in_parallel_ = false;
+#endif
+
+// one worker per NUMA node, pinned on the node's cpus with its own OpenMP team ( or oneDNN threadpool )
+// and stream, kernels of the node's shard run there
+struct NumaPool {
+    NumaPool() : engine_( ComputingContext::capture() ), tasks_( ComputingContext::numa_nodes.size() ) {
+        for (size_t k = 0; k < tasks_.size(); k++) {
+            workers_.push_back( std::thread([this, k] { work(k); }) );
+        }
+    }
+    ~NumaPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        cond_.notify_all();
+        for (auto& w : workers_) {
+            w.join();
+        }
+        delete engine_;
+    }
+
+    // teams of one engine share the pool, their runs are one by one
+    void run(const std::function<void(int)>& task) {
+        std::lock_guard<std::mutex> serial(serial_);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t k = 0; k < tasks_.size(); k++) {
+                tasks_[k] = [&task, k] { task(k); };
+            }
+            pending_ = tasks_.size();
+            round_++;
+        }
+        cond_.notify_all();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+private:
+    void work(int node) {
+        ComputingContext::bind(engine_);
+        const auto& cpus = ComputingContext::numa_cpus[node];
+        threads::pin_team(cpus.size(), cpus.data(), cpus.size());
+#ifdef _USING_DEVICE_DNNL_
+        dnnl::stream* stream = nullptr;
+#ifdef _DNNL_THREADPOOL_
+        EnginePool* pool = new EnginePool(cpus.size(), cpus);
+        ComputingContext::dnnl_pool = pool;
+        if ( ComputingContext::dnnl_engine != nullptr ) {
+            stream = new dnnl::stream( dnnl::threadpool_interop::make_stream(*ComputingContext::dnnl_engine, pool) );
+        }
+#else
+        if ( ComputingContext::dnnl_engine != nullptr ) {
+            stream = new dnnl::stream(*ComputingContext::dnnl_engine);
+        }
+#endif
+        ComputingContext::dnnl_team_stream = stream;
+#endif
+
+        size_t seen = 0;
+        for (;;) {
+            std::function<void()> t;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [&] { return quit_ || round_ != seen; });
+                if ( quit_ ) {
+                    break;
+                }
+                seen = round_;
+                t.swap( tasks_[node] );
+            }
+            if ( !t ) {
+                continue;
+            }
+            t();
+#ifdef _USING_DEVICE_DNNL_
+            if ( stream != nullptr ) {
+                stream->wait();
+            }
+#endif
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_--;
+            }
+            done_.notify_one();
+        }
+
+#ifdef _USING_DEVICE_DNNL_
+        ComputingContext::dnnl_team_stream = nullptr;
+        delete stream;
+#ifdef _DNNL_THREADPOOL_
+        ComputingContext::dnnl_pool = nullptr;
+        delete pool;
+#endif
+#endif
+    }
+
+    ComputingContext::Engine* engine_;
+    std::vector<std::function<void()>> tasks_;
+    std::vector<std::thread> workers_;
+    std::mutex serial_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::condition_variable done_;
+    size_t pending_ = 0;
+    size_t round_ = 0;
+    bool quit_ = false;
+};
+
+#ifdef _DNNL_THREADPOOL_
+void ComputingContext::pool_for(size_t n, const std::function<void(size_t, size_t)>& fn) {
+    if ( dnnl_pool == nullptr || n <= 1 ) {
+        fn(0, n);
+        return;
+    }
+    int parts = (int)std::min(n, (size_t)dnnl_pool->get_num_threads());
+    dnnl_pool->parallel_for(parts, [&](int k, int parts) {
+        fn(n * k / parts, n * (k + 1) / parts);
+    });
+}
 #endif
 
-void* ComputingContext::host_workspace = nullptr;
-size_t ComputingContext::workspace_size = 0;
-std::mt19937* ComputingContext::rng = nullptr;
+void ComputingContext::boot_threads(int n, const std::string& cpus) {
+    engine_cpus = threads::parse_cpus(cpus);
+    if ( n <= 0 ) {
+        n = engine_cpus.size() > 0 ? engine_cpus.size() : std::thread::hardware_concurrency();
+    }
+    engine_threads = n;
+    threads::pin_team(n, engine_cpus.data(), engine_cpus.size());
+}
 
 void ComputingContext::boot_host() {
     workspace_size = 1024 * 1024 * 32 * 4;
@@ -55,7 +453,12 @@ void ComputingContext::boot_dnnl(int cud) {
 
 #ifdef _USING_DEVICE_DNNL_
     dnnl_engine = new dnnl::engine(dnnl::engine::kind::cpu, 0);
+#ifdef _DNNL_THREADPOOL_
+    dnnl_pool = new EnginePool(engine_threads > 0 ? engine_threads : std::thread::hardware_concurrency(), engine_cpus);
+    dnnl_stream = new dnnl::stream( dnnl::threadpool_interop::make_stream(*dnnl_engine, dnnl_pool) );
+#else
     dnnl_stream = new dnnl::stream(*dnnl_engine);
+#endif
 
 #ifdef _DNNL_GPU_
     dnnl_gpu_engine = new dnnl::engine(dnnl::engine::kind::gpu, 0);
@@ -125,17 +528,38 @@ void ComputingContext::boot_corex(int cud) {
 }
 
 void ComputingContext::shutdown() {
+    // workers use the engine's handles
+    delete numa_pool;
+    numa_pool = nullptr;
+    numa_nodes.clear();
+    numa_cpus.clear();
+
     free(host_workspace);
+    host_workspace = nullptr;
+    delete rng;
+    rng = nullptr;
 
 #ifdef _USING_DEVICE_DNNL_
+    for (auto s : dnnl_team_streams) {
+        delete s;
+    }
+    dnnl_team_streams.clear();
     if ( dnnl_stream != nullptr ) {
         delete dnnl_stream;
         delete dnnl_engine;
+        dnnl_stream = nullptr;
+        dnnl_engine = nullptr;
     }
+#ifdef _DNNL_THREADPOOL_
+    delete dnnl_pool;
+    dnnl_pool = nullptr;
+#endif
 #ifdef _DNNL_GPU_
     if ( dnnl_gpu_stream != nullptr ) {
         delete dnnl_gpu_stream;
         delete dnnl_gpu_engine;
+        dnnl_gpu_stream = nullptr;
+        dnnl_gpu_engine = nullptr;
     }
 #endif
 #endif
@@ -153,6 +577,7 @@ void ComputingContext::shutdown() {
         for (int i = 1; i < ALL_CUDA_STREAMS; i++) {
             CUDA_CHECK( cudaStreamDestroy(assist_streams[i]) );
         }
+        cuda_stream = nullptr;
     }
 #endif
 
@@ -161,6 +586,7 @@ void ComputingContext::shutdown() {
         HIP_CHECK( hipFree(dcu_workspace) );
         HIPBLAS_CHECK( hipblasDestroy(hipblas_handle) );
         HIP_CHECK( hipStreamDestroy(dcu_stream) );
+        dcu_stream = nullptr;
     }
 #endif
 
@@ -169,10 +595,246 @@ void ComputingContext::shutdown() {
         COREX_CHECK( cudaFree(corex_workspace) );
         CXBLAS_CHECK( cublasDestroy(cxblas_handle) );
         COREX_CHECK( cudaStreamDestroy(corex_stream) );
+        corex_stream = nullptr;
     }
 #endif
 }
 
+void ComputingContext::sync() {
+#ifdef _USING_DEVICE_DNNL_
+    if ( dnnl_stream != nullptr ) {
+        dnnl_stream->wait();
+    }
+#ifdef _DNNL_GPU_
+    if ( dnnl_gpu_stream != nullptr ) {
+        dnnl_gpu_stream->wait();
+    }
+#endif
+#endif
+#ifdef _USING_DEVICE_CUDA_
+    CUDA_CHECK(cudaStreamSynchronize(cuda_stream));
+#endif
+#ifdef _USING_DEVICE_DCU_
+    HIP_CHECK(hipStreamSynchronize(dcu_stream));
+#endif
+#ifdef _USING_DEVICE_COREX_
+    COREX_CHECK(cudaStreamSynchronize(corex_stream));
+#endif
+}
+
+// engine bound to the thread by bind(), the booting thread has none
+static thread_local const ComputingContext::Engine* bound_engine = nullptr;
+
+ComputingContext::Engine* ComputingContext::capture() {
+    Engine* e = new Engine();
+#ifdef _USING_DEVICE_DNNL_
+    e->dnnl_engine = dnnl_engine;
+    e->dnnl_stream = dnnl_stream;
+    e->dnnl_team_streams = dnnl_team_streams;
+#ifdef _DNNL_GPU_
+    e->dnnl_gpu_engine = dnnl_gpu_engine;
+    e->dnnl_gpu_stream = dnnl_gpu_stream;
+#endif
+#endif
+#ifdef _USING_DEVICE_CUDA_
+    e->cuda_device = cuda_device;
+    e->cuda_stream = cuda_stream;
+    for (int i = 0; i < ALL_CUDA_STREAMS; i++) {
+        e->assist_streams[i] = assist_streams[i];
+    }
+    for (int i = 0; i < ALL_CUDA_EVENTS; i++) {
+        e->events[i] = events[i];
+    }
+    e->cublas_handle = cublas_handle;
+    e->cublasLt_handle = cublasLt_handle;
+    e->cudnn_handle = cudnn_handle;
+    e->cuda_workspace = cuda_workspace;
+#endif
+#ifdef _USING_DEVICE_DCU_
+    e->dcu_device = dcu_device;
+    e->dcu_stream = dcu_stream;
+    e->hipblas_handle = hipblas_handle;
+    e->dcu_workspace = dcu_workspace;
+#endif
+#ifdef _USING_DEVICE_COREX_
+    e->corex_device = corex_device;
+    e->corex_stream = corex_stream;
+    e->cxblas_handle = cxblas_handle;
+    e->corex_workspace = corex_workspace;
+#endif
+    e->host_workspace = host_workspace;
+    e->workspace_size = workspace_size;
+    e->rng = rng;
+    e->team_threads = team_threads;
+    e->engine_threads = engine_threads;
+    e->engine_cpus = engine_cpus;
+    e->numa_nodes = numa_nodes;
+    e->numa_cpus = numa_cpus;
+    e->numa_pool = numa_pool;
+#ifdef _DNNL_THREADPOOL_
+    e->dnnl_pool = dnnl_pool;
+#endif
+    return e;
+}
+
+void ComputingContext::bind(const Engine* e) {
+    if ( e == bound_engine ) {
+        return;
+    }
+    bound_engine = e;
+#ifdef _USING_DEVICE_DNNL_
+    dnnl_engine = e->dnnl_engine;
+    dnnl_stream = e->dnnl_stream;
+    dnnl_team_streams = e->dnnl_team_streams;
+#ifdef _DNNL_GPU_
+    dnnl_gpu_engine = e->dnnl_gpu_engine;
+    dnnl_gpu_stream = e->dnnl_gpu_stream;
+#endif
+#endif
+#ifdef _USING_DEVICE_CUDA_
+    cuda_device = e->cuda_device;
+    cuda_stream = e->cuda_stream;
+    for (int i = 0; i < ALL_CUDA_STREAMS; i++) {
+        assist_streams[i] = e->assist_streams[i];
+    }
+    for (int i = 0; i < ALL_CUDA_EVENTS; i++) {
+        events[i] = e->events[i];
+    }
+    cublas_handle = e->cublas_handle;
+    cublasLt_handle = e->cublasLt_handle;
+    cudnn_handle = e->cudnn_handle;
+    cuda_workspace = e->cuda_workspace;
+    CUDA_CHECK( cudaSetDevice(cuda_device) );
+#endif
+#ifdef _USING_DEVICE_DCU_
+    dcu_device = e->dcu_device;
+    dcu_stream = e->dcu_stream;
+    hipblas_handle = e->hipblas_handle;
+    dcu_workspace = e->dcu_workspace;
+    HIP_CHECK( hipSetDevice(dcu_device) );
+#endif
+#ifdef _USING_DEVICE_COREX_
+    corex_device = e->corex_device;
+    corex_stream = e->corex_stream;
+    cxblas_handle = e->cxblas_handle;
+    corex_workspace = e->corex_workspace;
+    COREX_CHECK( cudaSetDevice(corex_device) );
+#endif
+    host_workspace = e->host_workspace;
+    workspace_size = e->workspace_size;
+    rng = e->rng;
+    team_threads = e->team_threads;
+    engine_threads = e->engine_threads;
+    engine_cpus = e->engine_cpus;
+    numa_nodes = e->numa_nodes;
+    numa_cpus = e->numa_cpus;
+    numa_pool = e->numa_pool;
+#ifdef _DNNL_THREADPOOL_
+    dnnl_pool = e->dnnl_pool;
+#endif
+
+    // OpenMP team of the thread is made on its cpus
+    threads::pin(engine_cpus.data(), engine_cpus.size());
+#ifdef _OPENMP
+    if ( engine_threads > 0 ) {
+        omp_set_num_threads(engine_threads);
+    }
+#endif
+}
+
+int ComputingContext::boot_teams(int n) {
+#if defined(_USING_DEVICE_CUDA_) || defined(_USING_DEVICE_DCU_) || defined(_USING_DEVICE_COREX_) || defined(_DNNL_GPU_) || defined(_DNNL_THREADPOOL_)
+    return 1;
+#else
+    n = std::max(n, 1);
+#ifdef _USING_DEVICE_DNNL_
+    for (auto s : dnnl_team_streams) {
+        delete s;
+    }
+    dnnl_team_streams.clear();
+    if ( dnnl_engine != nullptr ) {
+        for (int i = 0; i < n; i++) {
+            dnnl_team_streams.push_back( new dnnl::stream(*dnnl_engine) );
+        }
+    }
+#endif
+    int all = engine_threads > 0 ? engine_threads : (int)std::thread::hardware_concurrency();
+    team_threads = std::max(1, all / n);
+    return n;
+#endif
+}
+
+bool ComputingContext::fused_kernel(const char* word) {
+#if defined(_USING_DEVICE_CUDA_) || defined(_USING_DEVICE_DCU_) || defined(_USING_DEVICE_COREX_) || defined(_DNNL_GPU_)
+    return false;
+#else
+#ifdef _USING_DEVICE_DNNL_
+    if ( dnnl_engine != nullptr ) {
+        return strcmp(word, "op.add_rmsnorm") == 0;
+    }
+#endif
+    return false;
+#endif
+}
+
+// the caller is team 0, its stream and threads are restored when leaving
+static thread_local int team_saved_threads = 0;
+static thread_local int team_pinned = -1;
+
+void ComputingContext::team_enter(int team) {
+#ifdef _USING_DEVICE_DNNL_
+    if ( team < (int)dnnl_team_streams.size() ) {
+        dnnl_team_stream = dnnl_team_streams[team];
+    }
+#endif
+    // workers get their slice of engine's cpus, the caller's team is pinned on first cpus already
+    if ( team > 0 && team != team_pinned && engine_cpus.size() > 0 ) {
+        std::vector<int> slice;
+        for (int i = 0; i < team_threads; i++) {
+            slice.push_back( engine_cpus[ (team * team_threads + i) % engine_cpus.size() ] );
+        }
+        threads::pin_team(team_threads, slice.data(), slice.size());
+        team_pinned = team;
+    }
+#ifdef _OPENMP
+    team_saved_threads = omp_get_max_threads();
+    omp_set_num_threads(team_threads);
+#endif
+}
+
+void ComputingContext::team_leave() {
+#ifdef _USING_DEVICE_DNNL_
+    if ( dnnl_team_stream != nullptr ) {
+        dnnl_team_stream->wait();
+        dnnl_team_stream = nullptr;
+    }
+#endif
+#ifdef _OPENMP
+    omp_set_num_threads(team_saved_threads);
+#endif
+}
+
+int ComputingContext::boot_numa() {
+    if ( numa_pool != nullptr ) {
+        return numa_nodes.size();
+    }
+    numa::nodes(engine_cpus, numa_nodes, numa_cpus);
+    if ( numa_nodes.size() > 1 ) {
+        numa_pool = new NumaPool();
+    }
+    return std::max((int)numa_nodes.size(), 1);
+}
+
+void ComputingContext::numa_run(const std::function<void(int)>& task) {
+    if ( numa_pool == nullptr ) {
+        for (int k = 0; k < std::max((int)numa_nodes.size(), 1); k++) {
+            task(k);
+        }
+        return;
+    }
+    numa_pool->run(task);
+}
+
 #ifdef _USING_DEVICE_CUDA_
 float ComputingContext::cuda_event(int flag) {
     if ( flag == 0 ) {
@@ -202,6 +864,8 @@ int      CollectiveContext::mpi_rank = -1;
 int      CollectiveContext::pipe_world = -1;
 int      CollectiveContext::pipe_rank = -1;
 int*     CollectiveContext::pipe_fds = nullptr;
+char*    CollectiveContext::pipe_rings = nullptr;
+size_t   CollectiveContext::pipe_ring_size = 0;
 
 #ifdef _USING_DEVICE_CUDA_
 ncclUniqueId    CollectiveContext::nccl_id;
@@ -210,13 +874,175 @@ int             CollectiveContext::nccl_rank = -1;
 int             CollectiveContext::nccl_world = -1;
 #endif
 
-void CollectiveContext::boot_pipe(int gpus) {
+namespace ring {
+    const size_t header_size = 256;
+
+    // placed at the front of every ring, data follows
+    struct Header {
+        pthread_mutex_t writer;             // one message is written at once, robust
+        std::atomic<uint32_t> broken;       // a writer died in a message, the stream is lost
+        std::atomic<uint64_t> head;         // bytes written
+        std::atomic<uint64_t> tail;         // bytes read
+        std::atomic<uint32_t> seq;          // futex word, bumped when head or tail moves
+        std::atomic<uint32_t> waiters;
+    };
+    static_assert(sizeof(Header) <= header_size, "ring header is too large");
+
+    pid_t parent = 0;
+    std::vector<pid_t> children;
+
+    // inboxes of every rank come first, then links of every ( src, dst ) pair
+    int channels() {
+        return CollectiveContext::pipe_world * (CollectiveContext::pipe_world + 1);
+    }
+    int link(int src, int dst) {
+        return CollectiveContext::pipe_world * (src + 1) + dst;
+    }
+
+    Header* at(int channel) {
+        return (Header *)(CollectiveContext::pipe_rings + channel * (header_size + CollectiveContext::pipe_ring_size));
+    }
+    char* data(Header* h) {
+        return (char *)h + header_size;
+    }
+
+    void notify(Header* h) {
+        h->seq++;
+        if ( h->waiters.load() > 0 ) {
+            syscall(SYS_futex, (uint32_t *)&h->seq, FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+        }
+    }
+
+    // parent of ranks > 0, every child of rank 0, exited ones are left for the app to reap
+    bool peers_alive() {
+        if ( CollectiveContext::pipe_rank > 0 ) {
+            return getppid() == parent;
+        }
+        for (auto pid : children) {
+            siginfo_t info;
+            info.si_pid = 0;
+            if ( waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid ) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // spins shortly ( peer can't run meanwhile on one cpu ) then sleeps until ready() or a peer process
+    // has gone, the futex isn't private across processes
+    template<typename F>
+    bool wait(Header* h, F ready) {
+        static const int spins = std::thread::hardware_concurrency() > 1 ? 256 : 0;
+        for (int spin = 0; ; spin++) {
+            uint32_t s = h->seq.load();
+            if ( ready() ) {
+                return true;
+            }
+            if ( spin < spins ) {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#endif
+                continue;
+            }
+            h->waiters++;
+            if ( !ready() ) {
+                timespec timeout = {0, 100 * 1000 * 1000};
+                syscall(SYS_futex, (uint32_t *)&h->seq, FUTEX_WAIT, s, &timeout, nullptr, 0);
+            }
+            h->waiters--;
+            if ( !ready() && (h->broken.load() || !peers_alive()) ) {
+                return false;
+            }
+        }
+    }
+
+    int write(int channel, const void* buf, size_t nbyte) {
+        Header* h = at(channel);
+        const size_t size = CollectiveContext::pipe_ring_size;
+        const char* src = (const char *)buf;
+
+        int ret = pthread_mutex_lock(&h->writer);
+        if ( ret == EOWNERDEAD ) {
+            // the dead writer may have left half a message, readers can't find the next one
+            h->broken.store(1);
+            notify(h);
+            pthread_mutex_consistent(&h->writer);
+            pthread_mutex_unlock(&h->writer);
+            return -1;
+        }
+        vt_assert( ret == 0, "Can't lock ring");
+        if ( h->broken.load() ) {
+            pthread_mutex_unlock(&h->writer);
+            return -1;
+        }
+        size_t done = 0;
+        while ( done < nbyte ) {
+            uint64_t head = h->head.load();
+            if ( !wait(h, [&] { return head - h->tail.load() < size || h->broken.load(); }) || h->broken.load() ) {
+                pthread_mutex_unlock(&h->writer);
+                return -1;
+            }
+            size_t space = size - (head - h->tail.load());
+            size_t offset = head % size;
+            size_t len = std::min( {nbyte - done, space, size - offset} );
+            memcpy(data(h) + offset, src + done, len);
+            h->head.store(head + len);
+            notify(h);
+            done += len;
+        }
+        pthread_mutex_unlock(&h->writer);
+        return nbyte;
+    }
+
+    int read(int channel, void* buf, size_t nbyte) {
+        Header* h = at(channel);
+        const size_t size = CollectiveContext::pipe_ring_size;
+        char* dst = (char *)buf;
+
+        size_t done = 0;
+        while ( done < nbyte ) {
+            uint64_t tail = h->tail.load();
+            if ( !wait(h, [&] { return h->head.load() != tail || h->broken.load(); }) || h->broken.load() ) {
+                return -1;
+            }
+            size_t avail = h->head.load() - tail;
+            size_t offset = tail % size;
+            size_t len = std::min( {nbyte - done, avail, size - offset} );
+            memcpy(dst + done, data(h) + offset, len);
+            h->tail.store(tail + len);
+            notify(h);
+            done += len;
+        }
+        return nbyte;
+    }
+}
+
+void CollectiveContext::boot_pipe(int gpus, size_t ring_size) {
     current = time(nullptr);
 
     pipe_rank = 0;
-    pipe_fds = (int *)malloc(sizeof(int) * 2 * (gpus + 1) );
-    for (int i = 0; i < gpus + 1; i++) {
-        vt_assert( pipe(pipe_fds + i * 2) >= 0, "Can't create pipe between parent and child process!");
+    pipe_world = gpus + 1;
+    if ( ring_size > 0 ) {
+        pipe_ring_size = (ring_size + ring::header_size - 1) / ring::header_size * ring::header_size;
+        size_t all = (ring::header_size + pipe_ring_size) * ring::channels();
+        pipe_rings = (char *)mmap(nullptr, all, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        vt_assert( pipe_rings != (char *)MAP_FAILED, "Can't map rings between parent and child process!");
+
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        for (int i = 0; i < ring::channels(); i++) {
+            ring::Header* h = new (ring::at(i)) ring::Header();
+            pthread_mutex_init(&h->writer, &attr);
+        }
+        pthread_mutexattr_destroy(&attr);
+        ring::parent = getpid();
+    } else {
+        pipe_fds = (int *)malloc(sizeof(int) * 2 * ring::channels() );
+        for (int i = 0; i < ring::channels(); i++) {
+            vt_assert( pipe(pipe_fds + i * 2) >= 0, "Can't create pipe between parent and child process!");
+        }
     }
 
 #ifdef _USING_DEVICE_CUDA_
@@ -226,8 +1052,10 @@ void CollectiveContext::boot_pipe(int gpus) {
         int n = fork();
         if ( n == 0 ) {
             pipe_rank = i + 1;
+            ring::children.clear();
             break;
         }
+        ring::children.push_back(n);
     }
 
 #ifdef _USING_DEVICE_CUDA_
@@ -289,25 +1117,85 @@ void CollectiveContext::shutdown() {
     }
 #endif
 
-    for (int i = 0; i < pipe_world * 2; i++) {
-        close( pipe_fds[i] );
+    if ( pipe_fds != nullptr ) {
+        for (int i = 0; i < ring::channels() * 2; i++) {
+            close( pipe_fds[i] );
+        }
+        free(pipe_fds);
+        pipe_fds = nullptr;
+    }
+    if ( pipe_rings != nullptr ) {
+        munmap(pipe_rings, (ring::header_size + pipe_ring_size) * ring::channels());
+        pipe_rings = nullptr;
     }
 }
 
-int CollectiveContext::pipe_write(const int n, const void *buf, size_t nbyte) {
-    if ( pipe_fds == nullptr ) {
-        vt_panic("pipe_fds is note initialized!");
+namespace ring {
+    int send(int channel, const void *buf, size_t nbyte) {
+        if ( CollectiveContext::pipe_rings != nullptr ) {
+            return write(channel, buf, nbyte);
+        }
+        if ( CollectiveContext::pipe_fds == nullptr ) {
+            vt_panic("pipe_fds is note initialized!");
+        }
+        int fd = CollectiveContext::pipe_fds[channel * 2 + 1];
+        size_t done = 0;
+        while ( done < nbyte ) {
+            ssize_t ret = ::write(fd, (const char *)buf + done, nbyte - done);
+            if ( ret < 0 && errno == EINTR ) {
+                continue;
+            }
+            if ( ret <= 0 ) {
+                return -1;
+            }
+            done += ret;
+        }
+        return nbyte;
+    }
+
+    int recv(int channel, void *buf, size_t nbyte) {
+        if ( CollectiveContext::pipe_rings != nullptr ) {
+            return read(channel, buf, nbyte);
+        }
+        if ( CollectiveContext::pipe_fds == nullptr ) {
+            vt_panic("pipe_fds is note initialized!");
+        }
+        int fd = CollectiveContext::pipe_fds[channel * 2 + 0];
+        size_t done = 0;
+        while ( done < nbyte ) {
+            ssize_t ret = ::read(fd, (char *)buf + done, nbyte - done);
+            if ( ret < 0 && errno == EINTR ) {
+                continue;
+            }
+            if ( ret <= 0 ) {
+                return -1;
+            }
+            done += ret;
+        }
+        return nbyte;
     }
-    int fd = pipe_fds[n * 2 + 1];
-    return write(fd, buf, nbyte);
+}
+
+int CollectiveContext::pipe_write(const int n, const void *buf, size_t nbyte) {
+    TraceSpan span("pipe_write", "io");
+    return ring::send(n, buf, nbyte);
 }
 
 int CollectiveContext::pipe_read(void *buf, size_t nbyte) {
-    if ( pipe_fds == nullptr ) {
-        vt_panic("pipe_fds is note initialized!");
-    }
-    int fd = pipe_fds[pipe_rank * 2 + 0];
-    return read(fd, buf, nbyte);
+    TraceSpan span("pipe_read", "io");
+    return ring::recv(pipe_rank, buf, nbyte);
+}
+
+int CollectiveContext::pipe_send(const int n, const void *buf, size_t nbyte) {
+    TraceSpan span("pipe_send", "io");
+    vt_assert( n >= 0 && n < pipe_world && n != pipe_rank, "pipe_send to a wrong rank");
+    return ring::send(ring::link(pipe_rank, n), buf, nbyte);
+}
+
+int CollectiveContext::pipe_recv(const int n, void *buf, size_t nbyte) {
+    TraceSpan span("pipe_recv", "io");
+    vt_assert( n >= 0 && n < pipe_world && n != pipe_rank, "pipe_recv from a wrong rank");
+    return ring::recv(ring::link(n, pipe_rank), buf, nbyte);
 }
 
 int CollectiveContext::now() {
@@ -315,35 +1203,628 @@ int CollectiveContext::now() {
     return n - current;
 }
 
+/**************************************************************/
+namespace trace {
+    struct Event {
+        char name[48];          // copied, names of native words are owned by DaG
+        const char* cat;        // literal
+        uint64_t begin;
+        uint64_t end;
+    };
+    struct Ring {
+        int tid;
+        size_t next;            // total recorded, ring keeps the last ones
+        std::vector<Event> events;
+    };
+
+    std::mutex lock;
+    std::vector<Ring*> rings;
+    std::string prefix;
+    std::string process = "vt";
+    size_t ring_size = 0;
+    thread_local Ring* current = nullptr;
+
+    Ring* new_ring() {
+        Ring* r = new Ring();
+        r->tid = (int)syscall(SYS_gettid);
+        r->next = 0;
+        r->events.resize(ring_size);
+
+        std::lock_guard<std::mutex> guard(lock);
+        rings.push_back(r);
+        return r;
+    }
+
+    // only the forking thread lives in child, its ring restarts with new tid
+    void after_fork() {
+        for (auto r : rings) {
+            if ( r != current ) {
+                delete r;
+            }
+        }
+        rings.clear();
+        if ( current != nullptr ) {
+            current->tid = (int)syscall(SYS_gettid);
+            current->next = 0;
+            rings.push_back(current);
+        }
+        process = "vt";
+    }
+
+    void escape(std::ostream& os, const char* s) {
+        for (; *s != 0; s++) {
+            if ( *s == '"' || *s == '\\' ) {
+                os << '\\';
+            }
+            os << *s;
+        }
+    }
+}
+
+bool TraceContext::enabled = false;
+
+void TraceContext::boot(const char* prefix, size_t ring_size) {
+    vt_assert(ring_size > 0, "ring of trace can't be empty");
+    trace::prefix = prefix;
+    trace::ring_size = ring_size;
+
+    // removing files of last run, otherwise merge() picks them up
+    glob_t files;
+    std::string pattern = trace::prefix + ".*.json";
+    if ( glob(pattern.c_str(), 0, nullptr, &files) == 0 ) {
+        for (size_t i = 0; i < files.gl_pathc; i++) {
+            unlink(files.gl_pathv[i]);
+        }
+        globfree(&files);
+    }
+    pthread_atfork(nullptr, nullptr, trace::after_fork);
+    enabled = true;
+}
+
+void TraceContext::name(const char* process_name) {
+    trace::process = process_name;
+}
+
+void TraceContext::record(const char* name, const char* cat, uint64_t begin, uint64_t end) {
+    if ( trace::ring_size == 0 ) {
+        return;
+    }
+    if ( trace::current == nullptr ) {
+        trace::current = trace::new_ring();
+    }
+    trace::Ring* r = trace::current;
+    trace::Event& e = r->events[ r->next % trace::ring_size ];
+    strncpy(e.name, name, sizeof(e.name) - 1);
+    e.name[ sizeof(e.name) - 1] = 0;
+    e.cat = cat;
+    e.begin = begin;
+    e.end = end;
+    r->next++;
+}
+
+void TraceContext::save() {
+    if ( trace::ring_size == 0 ) {
+        return;
+    }
+    int pid = getpid();
+    std::string fname = trace::prefix + "." + std::to_string(pid) + ".json";
+    std::ofstream os(fname);
+    if ( !os.is_open() ) {
+        std::cerr << "Can't write trace to " << fname << std::endl;
+        return;
+    }
+
+    os << std::fixed << std::setprecision(3);
+    os << "[\n";
+    os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":0,\"args\":{\"name\":\"";
+    trace::escape(os, trace::process.c_str());
+    os << "\"}}";
+
+    std::lock_guard<std::mutex> guard(trace::lock);
+    for (auto r : trace::rings) {
+        size_t n = std::min(r->next, trace::ring_size);
+        for (size_t i = r->next - n; i < r->next; i++) {
+            auto& e = r->events[i % trace::ring_size];
+            os << ",\n{\"name\":\"";
+            trace::escape(os, e.name);
+            os << "\",\"cat\":\"" << e.cat << "\",\"ph\":\"X\"";
+            os << ",\"ts\":" << e.begin / 1000.0 << ",\"dur\":" << (e.end - e.begin) / 1000.0;
+            os << ",\"pid\":" << pid << ",\"tid\":" << r->tid << "}";
+        }
+        if ( r->next > trace::ring_size ) {
+            std::cerr << "Trace ring of thread " << r->tid << " dropped " << r->next - trace::ring_size << " spans" << std::endl;
+        }
+    }
+    os << "\n]\n";
+}
+
+// called by one process after all others saved, e.g. the app after waiting its workers
+void TraceContext::merge() {
+    if ( trace::prefix.empty() ) {
+        return;
+    }
+    glob_t files;
+    std::string pattern = trace::prefix + ".*.json";
+    if ( glob(pattern.c_str(), 0, nullptr, &files) != 0 ) {
+        return;
+    }
+
+    std::string fname = trace::prefix + ".json";
+    std::ofstream os(fname);
+    os << "[";
+    bool first = true;
+    for (size_t i = 0; i < files.gl_pathc; i++) {
+        std::string body = fileToString(files.gl_pathv[i]);
+        size_t b = body.find('[');
+        size_t e = body.rfind(']');
+        if ( b == std::string::npos || e == std::string::npos || e <= b + 1 ) {
+            continue;
+        }
+        if ( !first ) {
+            os << ",";
+        }
+        os << body.substr(b + 1, e - b - 1);
+        first = false;
+    }
+    os << "]\n";
+    globfree(&files);
+}
+
+void TraceContext::shutdown() {
+    if ( enabled ) {
+        save();
+    }
+    enabled = false;
+
+    std::lock_guard<std::mutex> guard(trace::lock);
+    for (auto r : trace::rings) {
+        delete r;
+    }
+    trace::rings.clear();
+    trace::current = nullptr;
+    trace::ring_size = 0;
+}
+
 /**************************************************************/
 const size_t MemoryContext::aligen_size = 4;
+const size_t MemoryContext::align_bytes = 64;
 size_t MemoryContext::total_size = 0;
 size_t MemoryContext::currentp = 0;
+std::vector<MemoryContext::Tag> MemoryContext::tags;
+thread_local int MemoryContext::current_tag = 0;
+std::unordered_map<void*, int> MemoryContext::owners;
+std::mutex MemoryContext::mt;
+size_t MemoryContext::mapped_size = 0;
+
+const size_t PAGE_SIZE_4K = 4096;
+const size_t PAGE_SIZE_2M = 2 * 1024 * 1024;
+
+static size_t round_up(size_t s, size_t align) {
+    return (s + align - 1) / align * align;
+}
+
+void* AlignedAllocator::alloc(size_t blk_size) {
+    size_t align = blk_size >= PAGE_SIZE_2M ? PAGE_SIZE_4K : MemoryContext::align_bytes;
+    void* ret = nullptr;
+    if ( posix_memalign(&ret, align, round_up(blk_size, align)) != 0 ) {
+        vt_panic("Can't allocate memory, posix_memalign failed");
+    }
+    return ret;
+}
+
+void AlignedAllocator::free(void* m, size_t blk_size) {
+    ::free(m);
+}
+
+ArenaAllocator::ArenaAllocator(size_t chunk_size, bool huge_page) : chunk_size_( round_up(chunk_size, PAGE_SIZE_2M) ), huge_page_(huge_page) {
+    used_ = 0;
+}
+
+ArenaAllocator::~ArenaAllocator() {
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        munmap(chunks_[i].base, chunks_[i].size);
+    }
+}
+
+void ArenaAllocator::new_chunk(size_t size) {
+    Chunk c;
+    c.size = round_up(size, PAGE_SIZE_2M);
+    c.hugetlb = false;
+    c.base = (char *)MAP_FAILED;
+    if ( huge_page_ ) {
+        c.base = (char *)mmap(nullptr, c.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        c.hugetlb = c.base != (char *)MAP_FAILED;
+    }
+    if ( c.base == (char *)MAP_FAILED ) {
+        c.base = (char *)mmap(nullptr, c.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if ( c.base == (char *)MAP_FAILED ) {
+            vt_panic("Can't allocate memory, mmap arena failed");
+        }
+#ifdef MADV_HUGEPAGE
+        if ( huge_page_ ) {
+            madvise(c.base, c.size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    c.free_[0] = c.size;
+    chunks_.push_back(c);
+}
+
+void* ArenaAllocator::alloc(size_t blk_size) {
+    size_t align = blk_size >= PAGE_SIZE_2M ? PAGE_SIZE_4K : MemoryContext::align_bytes;
+    size_t s = round_up(blk_size, align);
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < chunks_.size(); i++) {
+            auto& fl = chunks_[i].free_;
+            // best fit
+            auto best = fl.end();
+            for (auto it = fl.begin(); it != fl.end(); it++) {
+                size_t pad = round_up(it->first, align) - it->first;
+                if ( it->second >= s + pad && (best == fl.end() || it->second < best->second) ) {
+                    best = it;
+                }
+            }
+            if ( best == fl.end() ) {
+                continue;
+            }
+
+            size_t offset = best->first;
+            size_t len = best->second;
+            size_t pad = round_up(offset, align) - offset;
+            fl.erase(best);
+            if ( pad > 0 ) {
+                fl[offset] = pad;
+            }
+            if ( len > pad + s ) {
+                fl[offset + pad + s] = len - pad - s;
+            }
+            used_ += s;
+            return chunks_[i].base + offset + pad;
+        }
+        new_chunk( std::max(chunk_size_, s) );
+    }
+    vt_panic("Can't be here!");
+    return nullptr;
+}
+
+void ArenaAllocator::free(void* m, size_t blk_size) {
+    size_t align = blk_size >= PAGE_SIZE_2M ? PAGE_SIZE_4K : MemoryContext::align_bytes;
+    size_t s = round_up(blk_size, align);
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        char* p = (char *)m;
+        if ( p < chunks_[i].base || p >= chunks_[i].base + chunks_[i].size ) {
+            continue;
+        }
+        auto& fl = chunks_[i].free_;
+        size_t offset = p - chunks_[i].base;
+        auto it = fl.insert({offset, s}).first;
+
+        // coalescing with neighbours
+        auto next = std::next(it);
+        if ( next != fl.end() && it->first + it->second == next->first ) {
+            it->second += next->second;
+            fl.erase(next);
+        }
+        if ( it != fl.begin() ) {
+            auto prev = std::prev(it);
+            if ( prev->first + prev->second == it->first ) {
+                prev->second += it->second;
+                fl.erase(it);
+            }
+        }
+        used_ -= s;
+        return;
+    }
+    vt_panic("Free a block not in arena");
+}
+
+const char* ArenaAllocator::name() {
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        if ( chunks_[i].hugetlb ) {
+            return "arena(hugetlb)";
+        }
+    }
+    return huge_page_ ? "arena(thp)" : "arena";
+}
+
+size_t ArenaAllocator::holding() {
+    size_t all = 0;
+    for (size_t i = 0; i < chunks_.size(); i++) {
+        all += chunks_[i].size;
+    }
+    return all - used_;
+}
+
+PoolAllocator::PoolAllocator(size_t max_cached) : max_cached_(max_cached) {
+    cached_ = 0;
+}
+
+PoolAllocator::~PoolAllocator() {
+    for (auto& fl : free_lists_) {
+        for (size_t i = 0; i < fl.second.size(); i++) {
+            sys_.free(fl.second[i], fl.first);
+        }
+    }
+}
+
+// four classes for every power of two, wasting 25% at most
+size_t PoolAllocator::size_class(size_t blk_size) {
+    size_t s = round_up(blk_size, MemoryContext::align_bytes);
+    size_t p = MemoryContext::align_bytes;
+    while ( p * 2 < s ) {
+        p = p * 2;
+    }
+    size_t step = std::max(p / 4, MemoryContext::align_bytes);
+    return round_up(s, step);
+}
+
+void* PoolAllocator::alloc(size_t blk_size) {
+    size_t c = size_class(blk_size);
+    auto& fl = free_lists_[c];
+    if ( fl.size() > 0 ) {
+        void* ret = fl.back();
+        fl.pop_back();
+        cached_ -= c;
+        return ret;
+    }
+    return sys_.alloc(c);
+}
+
+void PoolAllocator::free(void* m, size_t blk_size) {
+    size_t c = size_class(blk_size);
+    if ( cached_ + c > max_cached_ ) {
+        sys_.free(m, c);
+        return;
+    }
+    free_lists_[c].push_back(m);
+    cached_ += c;
+}
+
+std::atomic<size_t> NumaAllocator::sharded_blocks{0};
+
+NumaAllocator::NumaAllocator(bool shard, const std::vector<int>& nodes) : shard_(shard), nodes_(nodes) {
+}
+
+void* NumaAllocator::alloc(size_t blk_size) {
+    size_t s = round_up(blk_size, PAGE_SIZE_4K);
+    char* m = (char *)mmap(nullptr, s, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ( m == (char *)MAP_FAILED ) {
+        vt_panic("Can't allocate memory, mmap numa block failed");
+    }
+#ifdef MADV_HUGEPAGE
+    if ( s >= PAGE_SIZE_2M ) {
+        madvise(m, s, MADV_HUGEPAGE);
+    }
+#endif
+    if ( nodes_.size() == 0 ) {
+        return m;
+    }
+    if ( !shard_ ) {
+        numa::place(m, s, MPOL_INTERLEAVE, nodes_.data(), nodes_.size());
+        return m;
+    }
+
+    // shard k is pages of [s * k / n, s * (k+1) / n), linear kernels split rows the same way, so
+    // only rows crossing a page on the boundary are read from the neighbour. Preferred node falls
+    // back to others when it's full.
+    size_t n = nodes_.size();
+    for (size_t k = 0; k < n; k++) {
+        size_t b = shard_begin(s, k);
+        size_t e = shard_begin(s, k + 1);
+        if ( e > b ) {
+            numa::place(m + b, e - b, MPOL_PREFERRED, &nodes_[k], 1);
+        }
+    }
+    blocks_[m] = s;
+    sharded_blocks++;
+    return m;
+}
+
+void NumaAllocator::free(void* m, size_t blk_size) {
+    if ( blocks_.erase( (char *)m ) > 0 ) {
+        sharded_blocks--;
+    }
+    munmap(m, round_up(blk_size, PAGE_SIZE_4K));
+}
+
+size_t NumaAllocator::shard_begin(size_t blk_size, size_t k) {
+    size_t pages = round_up(blk_size, PAGE_SIZE_4K) / PAGE_SIZE_4K;
+    return pages * k / nodes_.size() * PAGE_SIZE_4K;
+}
+
+bool NumaAllocator::find(const void* m, char*& base, size_t& size) {
+    auto it = blocks_.upper_bound( (char *)m );
+    if ( it == blocks_.begin() ) {
+        return false;
+    }
+    --it;
+    if ( (const char *)m >= it->first + it->second ) {
+        return false;
+    }
+    base = it->first;
+    size = it->second;
+    return true;
+}
 
 void MemoryContext::boot(size_t total_bytes) {
     total_size = total_bytes;
     currentp = 0;
+
+    tags.clear();
+    current_tag = 0;
+    set_allocator("default", new PoolAllocator(256 * 1024 * 1024l));
+}
+
+void MemoryContext::shutdown() {
+    for (size_t i = 0; i < tags.size(); i++) {
+        if ( tags[i].current != 0 ) {
+            std::cout << "Memory tag " << tags[i].name << " has " << tags[i].current << " bytes in use when shutdown" << std::endl;
+            continue;
+        }
+        delete tags[i].allocator;
+        tags[i].allocator = nullptr;
+    }
+}
+
+int MemoryContext::find_tag(const char* name) {
+    for (size_t i = 0; i < tags.size(); i++) {
+        if ( tags[i].name == name ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void MemoryContext::use_tag(const char* name) {
+    std::lock_guard<std::mutex> lk(mt);
+    int t = find_tag(name);
+    if ( t == -1 ) {
+        tags.push_back({name, new AlignedAllocator(), 0, 0, 0});
+        t = tags.size() - 1;
+    }
+    current_tag = t;
+}
+
+void MemoryContext::set_allocator(const char* name, MemoryAllocator* allocator) {
+    std::lock_guard<std::mutex> lk(mt);
+    int t = find_tag(name);
+    if ( t == -1 ) {
+        tags.push_back({name, allocator, 0, 0, 0});
+        return;
+    }
+    if ( tags[t].current != 0 ) {
+        vt_panic("Can't change allocator of a memory tag in use");
+    }
+    delete tags[t].allocator;
+    tags[t].allocator = allocator;
+}
+
+const MemoryContext::Tag& MemoryContext::query_tag(const char* name) {
+    int t = find_tag(name);
+    if ( t == -1 ) {
+        vt_panic("Can't find memory tag");
+    }
+    return tags[t];
+}
+
+int MemoryContext::numa_shards(const void* m) {
+    std::lock_guard<std::mutex> lk(mt);
+    auto it = owners.find( const_cast<void *>(m) );
+    if ( it == owners.end() ) {
+        return 0;
+    }
+    NumaAllocator* numa = dynamic_cast<NumaAllocator *>( tags[it->second].allocator );
+    if ( numa == nullptr ) {
+        return 0;
+    }
+    return numa->shards();
+}
+
+bool MemoryContext::numa_rows(const void* m, size_t rows, size_t row_bytes, std::vector<size_t>& bounds) {
+    if ( NumaAllocator::sharded_blocks.load(std::memory_order_relaxed) == 0 ) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lk(mt);
+    for (auto& tag : tags) {
+        NumaAllocator* numa = dynamic_cast<NumaAllocator *>( tag.allocator );
+        char* base = nullptr;
+        size_t size = 0;
+        if ( numa == nullptr || numa->shards() <= 1 || !numa->find(m, base, size) ) {
+            continue;
+        }
+        size_t offset = (const char *)m - base;
+        size_t n = numa->shards();
+        bounds.resize(n + 1);
+        for (size_t k = 0; k <= n; k++) {
+            size_t b = numa->shard_begin(size, k);
+            size_t r = b <= offset ? 0 : (b - offset + row_bytes - 1) / row_bytes;
+            bounds[k] = std::min(r, rows);
+        }
+        bounds[n] = rows;
+        return true;
+    }
+    return false;
+}
+
+void MemoryContext::dump() {
+    const double oneM = 1024.0 * 1024.0;
+    std::cout << "Memory total " << currentp / oneM << " / " << total_size / oneM << " MB" << std::endl;
+    for (size_t i = 0; i < tags.size(); i++) {
+        std::cout << "  " << tags[i].name << "\t" << tags[i].allocator->name()
+                  << "\tcurrent " << tags[i].current / oneM << " MB"
+                  << "\tpeak " << tags[i].peak / oneM << " MB"
+                  << "\tholding " << tags[i].allocator->holding() / oneM << " MB"
+                  << "\tallocs " << tags[i].count << std::endl;
+    }
+    if ( mapped_size > 0 ) {
+        std::cout << "  mapped files\t" << mapped_size / oneM << " MB" << std::endl;
+    }
+}
+
+void* MemoryContext::map_file(const char* fileName, size_t size, bool populate) {
+    int fd = open(fileName, O_RDONLY);
+    if ( fd < 0 ) {
+        std::cout << "Can't open " << fileName << std::endl;
+        vt_panic("Can't open file");
+    }
+    struct stat st;
+    vt_assert( fstat(fd, &st) == 0, "fstat mapped file failed");
+    vt_assert( (size_t)st.st_size == size, "file size dont't match tensor");
+
+    int flags = MAP_SHARED;
+    if ( populate ) {
+        flags |= MAP_POPULATE;
+    }
+    void* m = mmap(nullptr, size, PROT_READ, flags, fd, 0);
+    close(fd);
+    if ( m == MAP_FAILED ) {
+        vt_panic("mmap weight file failed");
+    }
+    if ( !populate ) {
+        madvise(m, size, MADV_WILLNEED);
+    }
+
+    std::lock_guard<std::mutex> lk(mt);
+    mapped_size += size;
+    return m;
+}
+
+void MemoryContext::unmap_file(void* m, size_t size) {
+    munmap(m, size);
+    std::lock_guard<std::mutex> lk(mt);
+    mapped_size -= size;
 }
 
 void MemoryContext::free(void *m, size_t s) {
+    std::lock_guard<std::mutex> lk(mt);
     if ( currentp < s) {
         vt_panic("Memory leaking");
     }
-    ::free(m);
-    currentp -= s;
-}
-
-void MemoryContext::shutdown() {
+    auto it = owners.find(m);
+    vt_assert(it != owners.end(), "Free a block not allocated by MemoryContext");
+    Tag& tag = tags[it->second];
+    owners.erase(it);
 
+    tag.allocator->free(m, std::max(s, aligen_size));
+    tag.current -= s;
+    currentp -= s;
 }
 
 void* MemoryContext::alloc(size_t blk_size) {
     vt_assert(blk_size % aligen_size == 0, "block size must be aligend");
+    std::lock_guard<std::mutex> lk(mt);
     if ( blk_size + currentp > total_size ) {
         vt_panic("Can't allocate memory, out of pre-allocating");
     }
+    Tag& tag = tags[current_tag];
+    void* ret = tag.allocator->alloc( std::max(blk_size, aligen_size) );
+    owners[ret] = current_tag;
+
     currentp += blk_size;
-    void* ret = malloc(blk_size);
+    tag.current += blk_size;
+    tag.peak = std::max(tag.peak, tag.current);
+    tag.count++;
     return ret;
 }
 
@@ -6,6 +6,10 @@
 #ifdef _DNNL_GPU_
 #include <dnnl_ocl.hpp>
 #endif
+#if DNNL_CPU_THREADING_RUNTIME == DNNL_RUNTIME_THREADPOOL
+#include <dnnl_threadpool.hpp>
+#define _DNNL_THREADPOOL_
+#endif
 #endif
 
 #ifdef _USING_DEVICE_CUDA_
@@ -37,7 +41,15 @@
 #include <mpi.h>
 #endif
 
+#include <atomic>
+#include <ctime>
+#include <functional>
 #include <random>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "vt.hpp"
 
 #define COMPLAIN_ERROR_AND_EXIT(what, status) \
@@ -112,49 +124,75 @@
 
 namespace vt {
 
+#ifdef _DNNL_THREADPOOL_
+struct EnginePool;
+#endif
+struct NumaPool;
+
 #ifdef _USING_DEVICE_CUDA_
 #define ALL_CUDA_STREAMS 8
 #define ALL_CUDA_EVENTS 8
 #endif
 
+// Devices booted by one boot_xxx ( streams, library handles, workspaces, rng ) are an engine. Members
+// are the engine bound to calling thread, which is the booting thread or one bound by bind(), so each
+// thread of a process can boot and run its own engine.
 struct ComputingContext {
 #ifdef _USING_DEVICE_DNNL_
-    static dnnl::engine*    dnnl_engine;
-    static dnnl::stream*    dnnl_stream;
+    static thread_local dnnl::engine*    dnnl_engine;
+    static thread_local dnnl::stream*    dnnl_stream;
+    static thread_local std::vector<dnnl::stream*> dnnl_team_streams;
+    static thread_local dnnl::stream* dnnl_team_stream;
+#ifdef _DNNL_THREADPOOL_
+    static thread_local EnginePool* dnnl_pool;      // oneDNN built with threadpool runtime runs on it
+    static void pool_for(size_t n, const std::function<void(size_t, size_t)>& fn);    // fn(begin, end) of n items
+#endif
+
+    // cpu kernels are queued into stream of current team
+    static dnnl::stream& dnnl_current() {
+        return dnnl_team_stream != nullptr ? *dnnl_team_stream : *dnnl_stream;
+    }
 #ifdef _DNNL_GPU_   
-    static dnnl::engine*    dnnl_gpu_engine;
-    static dnnl::stream*    dnnl_gpu_stream;
+    static thread_local dnnl::engine*    dnnl_gpu_engine;
+    static thread_local dnnl::stream*    dnnl_gpu_stream;
 #endif
 #endif
 
 #ifdef _USING_DEVICE_CUDA_
-    static int cuda_device;
-    static cudaStream_t cuda_stream;
-    static cudaStream_t assist_streams[ ALL_CUDA_STREAMS ];
-    static cudaEvent_t events[ ALL_CUDA_STREAMS ];
-    static cublasHandle_t cublas_handle;
-    static cublasLtHandle_t cublasLt_handle;
-    static cudnnHandle_t cudnn_handle;
-    static void* cuda_workspace;
+    static thread_local int cuda_device;
+    static thread_local cudaStream_t cuda_stream;
+    static thread_local cudaStream_t assist_streams[ ALL_CUDA_STREAMS ];
+    static thread_local cudaEvent_t events[ ALL_CUDA_STREAMS ];
+    static thread_local cublasHandle_t cublas_handle;
+    static thread_local cublasLtHandle_t cublasLt_handle;
+    static thread_local cudnnHandle_t cudnn_handle;
+    static thread_local void* cuda_workspace;
 #endif
 
 #ifdef _USING_DEVICE_DCU_
-    static int dcu_device;
-    static hipStream_t dcu_stream;
-    static hipblasHandle_t hipblas_handle;
-    static void* dcu_workspace;
+    static thread_local int dcu_device;
+    static thread_local hipStream_t dcu_stream;
+    static thread_local hipblasHandle_t hipblas_handle;
+    static thread_local void* dcu_workspace;
 #endif
 
 #ifdef _USING_DEVICE_COREX_
-    static int corex_device;
-    static cudaStream_t corex_stream;
-    static cublasHandle_t cxblas_handle;
-    static void* corex_workspace;
+    static thread_local int corex_device;
+    static thread_local cudaStream_t corex_stream;
+    static thread_local cublasHandle_t cxblas_handle;
+    static thread_local void* corex_workspace;
 #endif
 
-    static void* host_workspace;
-    static size_t workspace_size;
-    static std::mt19937* rng;
+    static thread_local void* host_workspace;
+    static thread_local size_t workspace_size;
+    static thread_local std::mt19937* rng;
+
+    // Threads of the engine & cpus they are pinned to ( "0-15,32-47", empty isn't pinned ), it's
+    // booted before boot_xxx. Custom kernels and oneDNN run on OpenMP team of the engine's thread,
+    // which is sized & pinned here, so replicas of one box don't oversubscribe or migrate.
+    static void boot_threads(int threads, const std::string& cpus = "");
+    static thread_local int engine_threads;             // 0 is all of OpenMP's default
+    static thread_local std::vector<int> engine_cpus;
 
     static void boot_dnnl(int device);
     static void boot_acl(int device);
@@ -163,6 +201,78 @@ struct ComputingContext {
     static void boot_dcu(int device);
     static void shutdown();
 
+    // waits all queued kernels of booted devices
+    static void sync();
+
+    // independent native words run concurrently on teams of threads, returns teams really used,
+    // it's 1 for backends with one in-order stream shared by library handles.
+    static int boot_teams(int n);
+    static void team_enter(int team);       // on thread of the team
+    static void team_leave();               // waits kernels queued by the team
+    static thread_local int team_threads;
+
+    // fused native word ( "op.add_rmsnorm" ... ) has kernels on all devices booted by the engine,
+    // DAGs are fused only then, fallback sequence of a fused word runs slower than the plain one.
+    static bool fused_kernel(const char* word);
+
+    // NUMA nodes holding the engine's cpus ( all cpus when it isn't pinned ), booted after boot_xxx.
+    // Every node gets a worker pinned on its cpus, which computes the shard of linear weights placed
+    // on the node by NumaAllocator. Returns nodes used, nothing is sharded with one node.
+    static int boot_numa();
+    static void numa_run(const std::function<void(int)>& task);    // task(k) of every node, waits all
+    static thread_local std::vector<int> numa_nodes;               // node ids
+    static thread_local std::vector<std::vector<int>> numa_cpus;   // cpus of every node
+    static thread_local NumaPool* numa_pool;
+
+    // handle of an engine, which is captured on a thread it's bound to
+    struct Engine {
+#ifdef _USING_DEVICE_DNNL_
+        dnnl::engine* dnnl_engine;
+        dnnl::stream* dnnl_stream;
+        std::vector<dnnl::stream*> dnnl_team_streams;
+#ifdef _DNNL_GPU_
+        dnnl::engine* dnnl_gpu_engine;
+        dnnl::stream* dnnl_gpu_stream;
+#endif
+#endif
+#ifdef _USING_DEVICE_CUDA_
+        int cuda_device;
+        cudaStream_t cuda_stream;
+        cudaStream_t assist_streams[ ALL_CUDA_STREAMS ];
+        cudaEvent_t events[ ALL_CUDA_EVENTS ];
+        cublasHandle_t cublas_handle;
+        cublasLtHandle_t cublasLt_handle;
+        cudnnHandle_t cudnn_handle;
+        void* cuda_workspace;
+#endif
+#ifdef _USING_DEVICE_DCU_
+        int dcu_device;
+        hipStream_t dcu_stream;
+        hipblasHandle_t hipblas_handle;
+        void* dcu_workspace;
+#endif
+#ifdef _USING_DEVICE_COREX_
+        int corex_device;
+        cudaStream_t corex_stream;
+        cublasHandle_t cxblas_handle;
+        void* corex_workspace;
+#endif
+        void* host_workspace;
+        size_t workspace_size;
+        std::mt19937* rng;
+        int team_threads;
+        int engine_threads;
+        std::vector<int> engine_cpus;
+        std::vector<int> numa_nodes;
+        std::vector<std::vector<int>> numa_cpus;
+        NumaPool* numa_pool;
+#ifdef _DNNL_THREADPOOL_
+        EnginePool* dnnl_pool;
+#endif
+    };
+    static Engine* capture();                   // caller owns the handle, engine lives until its shutdown
+    static void bind(const Engine* engine);     // nothing is done when it's bound already
+
 #ifdef _USING_DEVICE_CUDA_
     static float cuda_event(int flag);
 #endif
@@ -177,6 +287,8 @@ struct CollectiveContext {
     static int      pipe_world;
     static int      pipe_rank;
     static int*     pipe_fds;
+    static char*    pipe_rings;         // shared by forked processes, replaces pipe_fds when booted
+    static size_t   pipe_ring_size;
 #ifdef _USING_HPC_OPENMPI_
     static int      mpi_world;
     static int      mpi_rank;
@@ -191,24 +303,201 @@ struct CollectiveContext {
 #ifdef _USING_HPC_OPENMPI_
     static void boot_mpi(int argc, char* argv[], int gpus);
 #endif
-    static void boot_pipe(int gpus);
+    // every process reads from its own ring in memory shared by forked processes, writers spin or
+    // sleep on a futex when it's full and messages of any size are streamed through. Zero ring_size
+    // keeps unix pipes.
+    static void boot_pipe(int gpus, size_t ring_size = 1024 * 1024);
     static void shutdown();
 
+    // whole buffer is moved, returns nbyte or -1 ( a worker returns -1 when the app is gone )
     static int pipe_write(const int n, const void *buf, size_t nbyte);
     static int pipe_read(void* buf, size_t nbyte);
 
+    // point to point link from current rank to rank n ( and back ), apart from the inboxes above,
+    // so tensors between pipeline stages never interleave with requests from the app
+    static int pipe_send(const int n, const void *buf, size_t nbyte);
+    static int pipe_recv(const int n, void* buf, size_t nbyte);
+
     static int now();
 };
 
+// timeline spans in chrome trace format ( chrome://tracing or ui.perfetto.dev ),
+// every thread records into its own ring, every process saves "<prefix>.<pid>.json" at shutdown,
+// then merge() joins files of all processes ( app + forked workers ) into "<prefix>.json".
+struct TraceContext {
+    static bool enabled;
+
+    // boot before CollectiveContext::boot_pipe, so forked workers inherit it with empty rings
+    static void boot(const char* prefix, size_t ring_size = 64 * 1024);
+    static void name(const char* process_name);
+    static void save();
+    static void merge();
+    static void shutdown();
+
+    // CLOCK_MONOTONIC in ns, same timeline for all processes of one host
+    static uint64_t now() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ul + ts.tv_nsec;
+    }
+    static void record(const char* name, const char* cat, uint64_t begin, uint64_t end);
+};
+
+struct TraceSpan {
+    TraceSpan(const char* name, const char* cat) : name_(name), cat_(cat), begin_(0) {
+        if ( TraceContext::enabled ) {
+            begin_ = TraceContext::now();
+        }
+    }
+    ~TraceSpan() {
+        if ( begin_ != 0 && TraceContext::enabled ) {
+            TraceContext::record(name_, cat_, begin_, TraceContext::now());
+        }
+    }
+
+private:
+    const char* name_;
+    const char* cat_;
+    uint64_t begin_;
+};
+
+struct MemoryAllocator {
+    virtual ~MemoryAllocator() {}
+    virtual void* alloc(size_t blk_size) = 0;
+    virtual void free(void* m, size_t blk_size) = 0;
+    virtual const char* name() = 0;
+    virtual size_t holding() {       // bytes reserved but not used by tensors
+        return 0;
+    }
+};
+
+// cache line aligned, page aligned for large blocks
+struct AlignedAllocator : public MemoryAllocator {
+    void* alloc(size_t blk_size) override;
+    void free(void* m, size_t blk_size) override;
+    const char* name() override {
+        return "aligned";
+    }
+};
+
+// mmaped chunks backed by huge pages (hugetlb or THP), for long lived weights and kv caches
+struct ArenaAllocator : public MemoryAllocator {
+    ArenaAllocator(size_t chunk_size, bool huge_page);
+    ~ArenaAllocator();
+
+    void* alloc(size_t blk_size) override;
+    void free(void* m, size_t blk_size) override;
+    const char* name() override;
+    size_t holding() override;
+
+private:
+    struct Chunk {
+        char* base;
+        size_t size;
+        bool hugetlb;
+        std::map<size_t, size_t> free_;     // offset -> size, coalesced
+    };
+    void new_chunk(size_t size);
+
+    const size_t chunk_size_;
+    const bool huge_page_;
+    size_t used_;
+    std::vector<Chunk> chunks_;
+};
+
+// every block is mapped alone and placed by NUMA policy before it's touched, so weights loaded by one
+// thread don't land on its node. Blocks are interleaved over nodes page by page, or split into one
+// shard per node, then rows of a linear weight are local to the node computing them.
+struct NumaAllocator : public MemoryAllocator {
+    NumaAllocator(bool shard, const std::vector<int>& nodes);
+
+    void* alloc(size_t blk_size) override;
+    void free(void* m, size_t blk_size) override;
+    const char* name() override {
+        return shard_ ? "numa(shard)" : "numa(interleave)";
+    }
+    int shards() {
+        return shard_ ? nodes_.size() : 1;
+    }
+
+    // sharded block holding m, and the offset where shard k of a block begins
+    bool find(const void* m, char*& base, size_t& size);
+    size_t shard_begin(size_t blk_size, size_t k);
+
+    // sharded blocks of all NumaAllocators, read without lock so kernels skip lookups when it's 0
+    static std::atomic<size_t> sharded_blocks;
+
+private:
+    const bool shard_;
+    const std::vector<int> nodes_;
+    std::map<char*, size_t> blocks_;        // sharded blocks, guarded by MemoryContext::mt
+};
+
+// size class free lists, for transient tensors created and released in every step
+struct PoolAllocator : public MemoryAllocator {
+    PoolAllocator(size_t max_cached);
+    ~PoolAllocator();
+
+    void* alloc(size_t blk_size) override;
+    void free(void* m, size_t blk_size) override;
+    const char* name() override {
+        return "pool";
+    }
+    size_t holding() override {
+        return cached_;
+    }
+
+    static size_t size_class(size_t blk_size);
+
+private:
+    AlignedAllocator sys_;
+    const size_t max_cached_;
+    size_t cached_;
+    std::map<size_t, std::vector<void*>> free_lists_;
+};
+
 struct MemoryContext {
     const static size_t aligen_size;
+    const static size_t align_bytes;
     static size_t  total_size;
     static size_t  currentp;
 
+    // every allocation is accounted to current tag, and served by the tag's allocator
+    struct Tag {
+        std::string name;
+        MemoryAllocator* allocator;
+        size_t current;
+        size_t peak;
+        size_t count;
+    };
+    static std::vector<Tag> tags;
+    static thread_local int current_tag;       // each thread ( engine ) uses its own tag
+
     static void* alloc(size_t blk_size);
     static void free(void* m, size_t s);
     static void boot(size_t total_bytes);
     static void shutdown();
+
+    static void use_tag(const char* name);
+    static void set_allocator(const char* name, MemoryAllocator* allocator);
+    static const Tag& query_tag(const char* name);
+    static void dump();
+
+    // 0 when the block isn't placed by NumaAllocator, otherwise its shards ( 1 is interleaved )
+    static int numa_shards(const void* m);
+    // bounds of rows of a matrix at m ( a block or a view inside ) held by each shard of its sharded
+    // block, a row belongs to the shard where it begins. False when m isn't in a sharded block
+    static bool numa_rows(const void* m, size_t rows, size_t row_bytes, std::vector<size_t>& bounds);
+
+    // read only mapping of a whole file, pages are shared with page cache and other processes
+    static size_t mapped_size;
+    static void* map_file(const char* fileName, size_t size, bool populate);
+    static void unmap_file(void* m, size_t size);
+
+private:
+    static int find_tag(const char* name);
+    static std::unordered_map<void*, int> owners;
+    static std::mutex mt;
 };
 
 // some common function and strcut
@@ -1,9 +1,33 @@
 #include <regex>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <unordered_set>
+#include <cstring>
+#include <glob.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 #include "tensortype.hpp"
+#include "context.hpp"
 #include "dag.hpp"
 
 namespace vt {
 
+const std::string* Cell::intern(const std::string& str) {
+    static std::mutex lock;
+    static std::unordered_set<std::string> pool;
+
+    std::lock_guard<std::mutex> guard(lock);
+    return &(*pool.insert(str).first);
+}
+
 std::ostream& operator<<(std::ostream& os, Cell& c) {
     if ( c.type_ == Cell::T_String ) {
         os << "S:" << c.as_string();
@@ -316,6 +340,14 @@ UserWord Enviroment::compile(const std::string& txt) {
                 w.erase(w.begin());
                 user_words_[name] = w;
 
+                std::stringstream ss;
+                ss << std::setprecision(17) << name;
+                for (auto& c : w) {
+                    ss << " " << c;
+                }
+                words_digest_ = digest(ss.str(), words_digest_);
+                defined_.push_back(name);
+
                 user_code.reset();
                 continue;
             }
@@ -397,9 +429,8 @@ namespace builtin {
             auto& hash = env->hash();
             auto& stack = env->stack();
 
-            auto name = stack.pop_string();
-            auto value = hash.find(name);
-            stack.push( Hash::Item2Cell(value) );
+            const auto& name = stack.pop_string();
+            stack.push( hash.find(name) );
             return 1;
         }
     };
@@ -409,9 +440,8 @@ namespace builtin {
             auto& hash = env->hash();
             auto& stack = env->stack();
 
-            auto name = stack.pop_string();
-            Cell cell = stack.pop();
-            hash.set(name, Hash::Cell2Item(cell));
+            const auto& name = stack.pop_string();
+            hash.set(name, stack.pop());
             return 1;
         }
     };
@@ -423,7 +453,7 @@ namespace builtin {
             auto& hash = env->hash();
             auto& stack = env->stack();
 
-            auto name = stack.pop_string();
+            const auto& name = stack.pop_string();
             hash.drop(name);
             return 1;
         }
@@ -458,163 +488,1830 @@ namespace builtin {
             return 1;
         }
     };
+
+    BuiltinOperator* create(const std::string& name) {
+        if ( name == "@" ) {
+            return new BuiltinGet();
+        } else if ( name == "!" ) {
+            return new BuiltinSet();
+        } else if ( name == "!!" ) {
+            return new BuiltinRemove();
+        } else if ( name == "jnz" ) {
+            return new BuiltinJNZ();
+        } else if ( name == "jz" ) {
+            return new BuiltinJZ();
+        }
+        vt_panic("Find an unsupoorted builtin operator!");
+        return nullptr;
+    }
+}
+
+namespace cache {
+    // files of other formats or other builds of the builder ( fusing, scheduling ) get other keys
+    static constexpr const char* version = "VTDAG002 " __DATE__ " " __TIME__;
+}
+
+namespace fusion {
+    std::string available();
+}
+
+DaG* Enviroment::build(const std::string& txt) {
+    DaG* dag = new DaG(this);
+
+    // key is made before compiling, which defines words
+    uint64_t key = 0;
+    if ( cache_dir_ != "" ) {
+        key = digest(txt, digest(fusion_ ? "fused " + fusion::available() : "plain", digest(cache::version, words_digest_)));
+        if ( load_cached(*dag, key) ) {
+            return dag;
+        }
+    }
+
+    defined_.clear();
+    UserWord myCode = compile(txt);
+    linking(*dag, myCode);
+    if ( fusion_ ) {
+        fuse(*dag);
+    }
+    schedule(*dag);
+
+    if ( cache_dir_ != "" ) {
+        save_cached(*dag, key);
+    }
+    return dag;
+}
+
+void Enviroment::execute(const std::string& txt) {
+    if ( engine_ != nullptr ) {
+        ComputingContext::bind(engine_);
+    }
+    auto i = executed_.find(txt);
+    if ( i != executed_.end() ) {
+        run_(i->second);
+        return;
+    }
+
+    DaG* dag = new DaG(this);
+    defined_.clear();
+    UserWord myCode = compile(txt);
+    linking(*dag, myCode);
+
+    // definitions can't be made twice, such texts are run once
+    if ( defined_.size() > 0 ) {
+        run_(dag);
+        delete dag;
+        return;
+    }
+
+    const size_t max_executed = 1024;
+    if ( executed_.size() >= max_executed ) {
+        for (auto& e : executed_) {
+            delete e.second;
+        }
+        executed_.clear();
+    }
+    executed_[txt] = dag;
+    run_(dag);
+}
+
+namespace cache {
+    // Linked DAG file, numbers are little endian, strings are u32 length & bytes
+    //   "VTDAG002" key
+    //   defined words { name codes { type number|string } }
+    //   natives { name path } builtins { name } strings { str }
+    //   bytes { type number|index }, strings and slot names are indices of strings
+    //   groups { length units { begin native } }
+    //   digest of the above from key
+    //   "VTDAG002"
+    static constexpr const char* magic = "VTDAG002";
+
+    void write_u32(std::ostream& os, uint32_t v) {
+        os.write((const char *)&v, sizeof(v));
+    }
+    void write_u64(std::ostream& os, uint64_t v) {
+        os.write((const char *)&v, sizeof(v));
+    }
+    void write_f64(std::ostream& os, double v) {
+        os.write((const char *)&v, sizeof(v));
+    }
+    void write_str(std::ostream& os, const std::string& s) {
+        write_u32(os, s.size());
+        os.write(s.data(), s.size());
+    }
+
+    // reading stops at the end, a truncated file reads zeros and fails the final check
+    struct Reader {
+        const char* p;
+        const char* end;
+        bool failed = false;
+
+        void read(void* v, size_t n) {
+            if ( (size_t)(end - p) < n ) {
+                failed = true;
+                memset(v, 0, n);
+                p = end;
+                return;
+            }
+            memcpy(v, p, n);
+            p += n;
+        }
+        uint32_t u32() {
+            uint32_t v;
+            read(&v, sizeof(v));
+            return v;
+        }
+        uint64_t u64() {
+            uint64_t v;
+            read(&v, sizeof(v));
+            return v;
+        }
+        double f64() {
+            double v;
+            read(&v, sizeof(v));
+            return v;
+        }
+        // number of following records, each takes n bytes at least
+        uint32_t count(size_t n) {
+            uint32_t v = u32();
+            if ( v > (size_t)(end - p) / n ) {
+                failed = true;
+                p = end;
+                return 0;
+            }
+            return v;
+        }
+        std::string str() {
+            uint32_t n = u32();
+            if ( (size_t)(end - p) < n ) {
+                failed = true;
+                p = end;
+                return "";
+            }
+            std::string s(p, n);
+            p += n;
+            return s;
+        }
+    };
+
+    std::string file_name(const std::string& dir, uint64_t key) {
+        std::stringstream ss;
+        ss << dir << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".vtdag";
+        return ss.str();
+    }
+}
+
+bool Enviroment::load_cached(DaG& dag, uint64_t key) {
+    std::ifstream inf(cache::file_name(cache_dir_, key), std::ios::binary | std::ios::ate);
+    if ( !inf.is_open() ) {
+        return false;
+    }
+    std::string data( inf.tellg(), '\0' );
+    inf.seekg(0);
+    inf.read(&data[0], data.size());
+    if ( data.size() < 32 || data.compare(0, 8, cache::magic) != 0 || data.compare(data.size() - 8, 8, cache::magic) != 0 ) {
+        return false;
+    }
+    uint64_t sum;
+    memcpy(&sum, data.data() + data.size() - 16, sizeof(sum));
+    if ( digest( data.substr(8, data.size() - 24) ) != sum ) {
+        return false;
+    }
+    cache::Reader r{data.data() + 8, data.data() + data.size() - 16};
+    if ( r.u64() != key ) {
+        return false;
+    }
+
+    // everything is read before touching the enviroment
+    std::vector<std::pair<std::string, UserWord>> defs( r.count(8) );
+    for (auto& d : defs) {
+        d.first = r.str();
+        d.second.resize( r.count(4) );
+        for (auto& c : d.second) {
+            c.type_ = (decltype(c.type_))r.u32();
+            if ( c.type_ == WordCode::Number ) {
+                c.num_ = r.f64();
+            } else {
+                c.str_ = r.str();
+            }
+        }
+    }
+    std::vector<std::string> natives( r.count(8) );
+    std::vector<std::string> paths( natives.size() );
+    for (size_t i = 0; i < natives.size(); i++) {
+        natives[i] = r.str();
+        paths[i] = r.str();
+    }
+    std::vector<std::string> builtins( r.count(4) );
+    for (auto& b : builtins) {
+        b = r.str();
+    }
+    std::vector<std::string> strings( r.count(4) );
+    for (auto& str : strings) {
+        str = r.str();
+    }
+
+    // each string is interned or resolved to slot once
+    std::vector<const std::string*> interned( strings.size(), nullptr );
+    std::vector<long> slots( strings.size(), -1 );
+    UserBinary binary;
+    binary.reserve( r.count(12) );
+    for (size_t i = 0; i < binary.capacity() && !r.failed; i++) {
+        auto type = (WordByte::_WordByteType_)r.u32();
+        if ( type == WordByte::Number ) {
+            binary.push_back( WordByte(r.f64()) );
+            continue;
+        }
+        size_t idx = r.u64();
+        if ( type == WordByte::String || type == WordByte::HashGet || type == WordByte::HashSet ) {
+            if ( idx >= strings.size() ) {
+                return false;
+            }
+            if ( type == WordByte::String ) {
+                if ( interned[idx] == nullptr ) {
+                    interned[idx] = Cell::intern( strings[idx] );
+                }
+                binary.push_back( WordByte(interned[idx]) );
+                continue;
+            }
+            if ( slots[idx] < 0 ) {
+                slots[idx] = hash_.slot( strings[idx] );
+            }
+            idx = slots[idx];
+        }
+        binary.push_back( WordByte(type, idx) );
+    }
+    std::vector<DaG::Group> groups( r.count(12) );
+    for (auto& g : groups) {
+        g.length = r.u64();
+        g.units.resize( r.count(16) );
+        for (auto& u : g.units) {
+            u.begin = r.u64();
+            u.native = r.u64();
+        }
+    }
+    if ( r.failed || r.p != r.end ) {
+        return false;
+    }
+
+    // a damaged or foreign file is rebuilt, indices are checked before they are used
+    std::set<std::string> names;
+    for (auto& d : defs) {
+        names.insert(d.first);
+    }
+    for (auto& d : defs) {
+        for (auto& c : d.second) {
+            if ( (uint32_t)c.type_ > WordCode::User ||
+                 (c.type_ == WordCode::Native && native_words_.find(c.str_) == native_words_.end()) ||
+                 (c.type_ == WordCode::User && names.find(c.str_) == names.end() && user_words_.find(c.str_) == user_words_.end()) ) {
+                return false;
+            }
+        }
+    }
+    for (auto& n : natives) {
+        if ( native_words_.find(n) == native_words_.end() ) {
+            return false;
+        }
+    }
+    for (auto& b : builtins) {
+        if ( b != "@" && b != "!" && b != "!!" && b != "jnz" && b != "jz" ) {
+            return false;
+        }
+    }
+    for (auto& b : binary) {
+        if ( (uint32_t)b.type_ > WordByte::Parallel ||
+             (b.type_ == WordByte::Native && b.idx_ >= natives.size()) ||
+             (b.type_ == WordByte::BuiltinOperator && b.idx_ >= builtins.size()) ||
+             (b.type_ == WordByte::Parallel && b.idx_ >= groups.size()) ) {
+            return false;
+        }
+    }
+    for (auto& g : groups) {
+        for (auto& u : g.units) {
+            if ( u.begin > u.native || u.native >= binary.size() || binary[u.native].type_ != WordByte::Native ) {
+                return false;
+            }
+            auto e = effects_.find( natives[ binary[u.native].idx_ ] );
+            if ( e == effects_.end() || e->second.results != 0 ) {
+                return false;
+            }
+            u.writes = &e->second.writes;
+        }
+    }
+
+    // same as compiling: words are defined and digested in order
+    for (auto& d : defs) {
+        if ( user_words_.find(d.first) != user_words_.end() ) {
+            vt_panic("Can't a valid name for #def macro!");
+        }
+        user_words_[d.first] = d.second;
+        std::stringstream ss;
+        ss << std::setprecision(17) << d.first;
+        for (auto& c : d.second) {
+            ss << " " << c;
+        }
+        words_digest_ = digest(ss.str(), words_digest_);
+    }
+    for (size_t i = 0; i < natives.size(); i++) {
+        dag.natives_.push_back( create_native(natives[i]) );
+        dag.native_names_.push_back( natives[i] );
+        dag.native_paths_.push_back( paths[i] );
+    }
+    for (auto& b : builtins) {
+        dag.builtins_.push_back( builtin::create(b) );
+        dag.builtin_names_.push_back( b );
+    }
+    dag.binary_.swap(binary);
+    dag.groups_.swap(groups);
+    return true;
 }
 
+// written into a temporary file then renamed, processes building same DAG don't see half files
+void Enviroment::save_cached(DaG& dag, uint64_t key) {
+    std::string fileName = cache::file_name(cache_dir_, key);
+    std::string tmpName = fileName + "." + std::to_string(getpid());
+    std::ofstream of(tmpName, std::ios::out | std::ios::binary);
+    if ( !of.is_open() ) {
+        return;
+    }
+
+    std::stringstream wf;
+    cache::write_u64(wf, key);
+    cache::write_u32(wf, defined_.size());
+    for (auto& name : defined_) {
+        auto& w = user_words_[name];
+        cache::write_str(wf, name);
+        cache::write_u32(wf, w.size());
+        for (auto& c : w) {
+            cache::write_u32(wf, c.type_);
+            if ( c.type_ == WordCode::Number ) {
+                cache::write_f64(wf, c.num_);
+            } else {
+                cache::write_str(wf, c.str_);
+            }
+        }
+    }
+    cache::write_u32(wf, dag.natives_.size());
+    for (size_t i = 0; i < dag.natives_.size(); i++) {
+        cache::write_str(wf, dag.native_names_[i]);
+        cache::write_str(wf, dag.native_paths_[i]);
+    }
+    cache::write_u32(wf, dag.builtin_names_.size());
+    for (auto& b : dag.builtin_names_) {
+        cache::write_str(wf, b);
+    }
+
+    std::vector<const std::string*> strings;
+    std::unordered_map<const std::string*, size_t> indices;
+    auto string_index = [&](const std::string* str) {
+        auto i = indices.find(str);
+        if ( i != indices.end() ) {
+            return i->second;
+        }
+        indices[str] = strings.size();
+        strings.push_back(str);
+        return strings.size() - 1;
+    };
+    std::vector<uint64_t> values;
+    for (auto& byte : dag.binary_) {
+        if ( byte.type_ == WordByte::String ) {
+            values.push_back( string_index(byte.str_) );
+        } else if ( byte.type_ == WordByte::HashGet || byte.type_ == WordByte::HashSet ) {
+            values.push_back( string_index(&hash_.name(byte.idx_)) );
+        } else {
+            values.push_back( byte.idx_ );
+        }
+    }
+    cache::write_u32(wf, strings.size());
+    for (auto str : strings) {
+        cache::write_str(wf, *str);
+    }
+    cache::write_u32(wf, dag.binary_.size());
+    for (size_t i = 0; i < dag.binary_.size(); i++) {
+        auto& byte = dag.binary_[i];
+        cache::write_u32(wf, byte.type_);
+        if ( byte.type_ == WordByte::Number ) {
+            cache::write_f64(wf, byte.num_);
+        } else {
+            cache::write_u64(wf, values[i]);
+        }
+    }
+    cache::write_u32(wf, dag.groups_.size());
+    for (auto& g : dag.groups_) {
+        cache::write_u64(wf, g.length);
+        cache::write_u32(wf, g.units.size());
+        for (auto& u : g.units) {
+            cache::write_u64(wf, u.begin);
+            cache::write_u64(wf, u.native);
+        }
+    }
+    std::string body = wf.str();
+    of.write(cache::magic, 8);
+    of.write(body.data(), body.size());
+    cache::write_u64(of, digest(body));
+    of.write(cache::magic, 8);
+    of.close();
+
+    if ( of.fail() || std::rename(tmpName.c_str(), fileName.c_str()) != 0 ) {
+        unlink(tmpName.c_str());
+    }
+}
 
-void Enviroment::linking(DaG& dag, UserWord& word) {
+void Enviroment::linking(DaG& dag, UserWord& word, const std::string& path) {
+    std::map<std::string, size_t> calls;
     auto& builtins_ = dag.builtins_;
     auto& natives_ = dag.natives_;
     auto& binary_ = dag.binary_;
 
     for(size_t i = 0; i < word.size(); i++) {
-        auto code = word[i];
+        auto& code = word[i];
         switch( code.type_ ) {
             case WordCode::Number :
                 binary_.push_back( WordByte( code.num_ ) );
                 break;
 
             case WordCode::String :
-                binary_.push_back( WordByte( code.str_  ) );
+                // constant names of @ and ! are resolved to hash slots
+                if ( i + 1 < word.size() && word[i+1].type_ == WordCode::Builtin ) {
+                    auto& next = word[i+1].str_;
+                    if ( next == "@" || next == "!" ) {
+                        auto t = next == "@" ? WordByte::HashGet : WordByte::HashSet;
+                        binary_.push_back( WordByte(t, hash_.slot(code.str_)) );
+                        break;
+                    }
+                }
+                binary_.push_back( WordByte( Cell::intern(code.str_) ) );
                 break;
 
             case WordCode::Builtin :
-                {
-                    BuiltinOperator* op = nullptr;
-                    if ( code.str_ == "@" ) {
-                        op = new builtin::BuiltinGet();
-                    } else if ( code.str_ == "!" ) {
-                        op = new builtin::BuiltinSet();
-                    } else if ( code.str_ == "!!" ) {
-                        op = new builtin::BuiltinRemove();
-                    } else if ( code.str_ == "jnz" ) {
-                        op = new builtin::BuiltinJNZ();
-                    } else if ( code.str_ == "jz" ) {
-                        op = new builtin::BuiltinJZ();
-                    } else {
-                        vt_panic("Find an unsupoorted builtin operator!");
-                    }
-                    size_t idx = builtins_.size();
-                    builtins_.push_back(op);
-                    binary_.push_back( WordByte( WordByte::BuiltinOperator, idx) );
-                }
+                binary_.push_back( WordByte( WordByte::BuiltinOperator, builtins_.size()) );
+                builtins_.push_back( builtin::create(code.str_) );
+                dag.builtin_names_.push_back( code.str_ );
                 break;
 
             case WordCode::Native :
                 binary_.push_back( WordByte(WordByte::Native, natives_.size() ));
                 natives_.push_back( create_native(code.str_));
+                dag.native_names_.push_back( code.str_ );
+                dag.native_paths_.push_back( path );
                 break;
 
             case WordCode::User :
                 UserWord& new_word = get_user( code.str_ );
-                linking(dag, new_word);
+                std::string sub = code.str_ + "#" + std::to_string( calls[code.str_]++ );
+                linking(dag, new_word, path == "" ? sub : path + "/" + sub);
                 break;
         }
     }
 }
 
-namespace base {
-    struct Exit : public NativeWord {
-        void run(Stack& stack) override {
-            exit(0);
-        }
-        NWORD_CREATOR_DEFINE_LR(Exit)
-    };
+static double item_bytes(DataType dt) {
+    switch( dt ) {
+        case Float:
+        case Int:
+            return 4.0;
+        case FP16:
+        case BF16:
+            return 2.0;
+        case Q8:
+            return 1.0;
+        case Q4:
+            return 68.0 / 128.0;
+        default:
+            break;
+    }
+    return 0.5;
+}
 
-    struct Dump : public NativeWord {
-        void run(Stack& stack) override {
-            std::cout << stack << std::endl;
-        }
-        NWORD_CREATOR_DEFINE_LR(Dump)
+namespace fusion {
+    // second word's input equals first word's output ( last argument ), rules are applied in order
+    struct Rule {
+        const char* first;
+        size_t first_args;
+        const char* second;
+        size_t second_args;
+        size_t second_out;          // index of output in second's arguments, not matched
+        const char* fused;
+    };
+    const Rule rules[] = {
+        {"op.add",    3, "op.rmsnorm",      5, 3, "op.add_rmsnorm"},
+        {"op.linear", 4, "op.add",          3, 2, "op.linear_add"},
+        {"op.linear", 4, "op.silu_product", 3, 2, "op.linear_silu_product"},
     };
 
-    struct Echo : public NativeWord {
-        void run(Stack& stack) override {
-            Cell cell = stack.pop();
-            std::cout << cell << std::endl;
+    // fused words having kernels on current engine, same rules are applied for same list
+    std::string available() {
+        std::string all;
+        for (auto& rule : rules) {
+            if ( ComputingContext::fused_kernel(rule.fused) ) {
+                all = all + rule.fused + " ";
+            }
         }
-        NWORD_CREATOR_DEFINE_LR(Echo)
-    };
+        return all;
+    }
+}
 
-    struct Drop : public NativeWord {
-        void run(Stack& stack) override {
-            stack.drop();
+// Rewrites "args1 first args2 second" to "args1 args2 fused", arguments must be plain pushes
+// ( number, string, "name @" or op.null ) so data flow is known by hash slots. The fused word
+// gets same arguments and writes same tensors, intermediate included, because a name could be
+// read again through a view or by next run of the DAG. A rule is applied only when the engine
+// has a kernel of the fused word, a merged unit reads & writes more and is scheduled worse.
+void Enviroment::fuse(DaG& dag) {
+    auto& binary_ = dag.binary_;
+    auto& natives_ = dag.natives_;
+    auto& names_ = dag.native_names_;
+
+    // jumps are counted in bytes, don't touch them
+    for (auto op : dag.builtins_) {
+        if ( dynamic_cast<builtin::BuiltinJNZ*>(op) != nullptr || dynamic_cast<builtin::BuiltinJZ*>(op) != nullptr ) {
+            return;
         }
-        NWORD_CREATOR_DEFINE_LR(Drop)
-    };
+    }
 
-    struct Dup : public NativeWord {
-        void run(Stack& stack) override {
-            stack.dup();
+    // walks back n arguments ending before pos, slots are -1 for values not from hash
+    auto back_args = [&](size_t pos, size_t n, std::vector<long>& slots) -> std::optional<size_t> {
+        slots.assign(n, -1);
+        for (size_t i = 0; i < n; i++) {
+            if ( pos == 0 ) {
+                return {};
+            }
+            auto& last = binary_[pos - 1];
+            if ( last.type_ == WordByte::Number || last.type_ == WordByte::String ) {
+                pos -= 1;
+            } else if ( last.type_ == WordByte::Native && names_[last.idx_] == "op.null" ) {
+                pos -= 1;
+            } else if ( pos >= 2 && binary_[pos - 2].type_ == WordByte::HashGet ) {
+                slots[n - 1 - i] = binary_[pos - 2].idx_;
+                pos -= 2;
+            } else {
+                return {};
+            }
         }
-        NWORD_CREATOR_DEFINE_LR(Dup)
+        return pos;
     };
 
-    struct Dup2 : public NativeWord {
-        void run(Stack& stack) override {
-            stack.dup2();
+    std::stringstream before;
+    if ( fusion_dump_ ) {
+        dump_binary(&dag, before);
+    }
+
+    size_t fused = 0;
+    for (auto& rule : fusion::rules) {
+        if ( native_words_.find(rule.fused) == native_words_.end() || !ComputingContext::fused_kernel(rule.fused) ) {
+            continue;
         }
-        NWORD_CREATOR_DEFINE_LR(Dup2)
-    };
+        std::vector<bool> removed(binary_.size(), false);
+        std::vector<long> args1, args2;
+        for (size_t p2 = 0; p2 < binary_.size(); p2++) {
+            auto& second = binary_[p2];
+            if ( second.type_ != WordByte::Native || names_[second.idx_] != rule.second ) {
+                continue;
+            }
+            auto s2 = back_args(p2, rule.second_args, args2);
+            if ( !s2.has_value() || s2.value() == 0 ) {
+                continue;
+            }
+            size_t p1 = s2.value() - 1;
+            if ( removed[p1] || binary_[p1].type_ != WordByte::Native || names_[binary_[p1].idx_] != rule.first ) {
+                continue;
+            }
+            if ( !back_args(p1, rule.first_args, args1).has_value() || args1.back() < 0 ) {
+                continue;
+            }
+            bool matched = false;
+            for (size_t i = 0; i < args2.size(); i++) {
+                if ( i != rule.second_out && args2[i] == args1.back() ) {
+                    matched = true;
+                }
+            }
+            if ( !matched ) {
+                continue;
+            }
 
-    struct Swap : public NativeWord {
-        void run(Stack& stack) override {
-            stack.swap();
+            removed[p1] = true;
+            dag.native_paths_.push_back( dag.native_paths_[second.idx_] );
+            second = WordByte(WordByte::Native, natives_.size());
+            natives_.push_back( create_native(rule.fused) );
+            names_.push_back( rule.fused );
+            fused++;
         }
-        NWORD_CREATOR_DEFINE_LR(Swap)
-    };
 
-    struct Rot : public NativeWord {
-        void run(Stack& stack) override {
-            stack.rot();
+        UserBinary result;
+        for (size_t i = 0; i < binary_.size(); i++) {
+            if ( !removed[i] ) {
+                result.push_back( binary_[i] );
+            }
         }
-        NWORD_CREATOR_DEFINE_LR(Rot)
-    };
+        binary_.swap(result);
+    }
 
-    struct Rev : public NativeWord {
-        void run(Stack& stack) override {
-            int n = stack.pop_number();
-            stack.rev(n);
+    if ( fusion_dump_ ) {
+        std::cout << "==== before fusion ====" << std::endl << before.str();
+        std::cout << "==== after fusion ( " << fused << " fused ) ====" << std::endl;
+        dump_binary(&dag, std::cout);
+    }
+}
+
+// Marks runs of independent-looking native calls, each call is a unit of plain pushes followed
+// by a word with registered effect. Whether two units really touch different memory is known
+// only at runtime, run_group checks it with actual tensors before going concurrent.
+void Enviroment::schedule(DaG& dag) {
+    auto& binary_ = dag.binary_;
+    auto& names_ = dag.native_names_;
+
+    // jumps are counted in bytes, don't touch them
+    for (auto op : dag.builtins_) {
+        if ( dynamic_cast<builtin::BuiltinJNZ*>(op) != nullptr || dynamic_cast<builtin::BuiltinJZ*>(op) != nullptr ) {
+            return;
         }
-        NWORD_CREATOR_DEFINE_LR(Rev)
-    };
+    }
+    if ( effects_.size() == 0 ) {
+        return;
+    }
 
-    struct Add : public NativeWord {
-        void run(Stack& stack) override {
-            double a = stack.pop_number();
-            double b = stack.pop_number();
-            stack.push_number( b + a );
+    // a unit ending at pos, which is a native with effect and its arguments
+    auto unit_at = [&](size_t begin, size_t pos) -> std::optional<DaG::Unit> {
+        auto& last = binary_[pos];
+        if ( last.type_ != WordByte::Native ) {
+            return {};
         }
-        NWORD_CREATOR_DEFINE_LR(Add)
+        auto e = effects_.find( names_[last.idx_] );
+        if ( e == effects_.end() || e->second.results != 0 ) {
+            return {};
+        }
+        size_t n = 0;
+        for (size_t i = begin; i < pos; ) {
+            auto& b = binary_[i];
+            if ( b.type_ == WordByte::Number || b.type_ == WordByte::String ) {
+                i += 1;
+            } else if ( b.type_ == WordByte::Native && names_[b.idx_] == "op.null" ) {
+                i += 1;
+            } else if ( b.type_ == WordByte::HashGet ) {
+                i += 2;
+            } else {
+                return {};
+            }
+            n++;
+        }
+        if ( n != e->second.args ) {
+            return {};
+        }
+        return DaG::Unit{begin, pos, &e->second.writes};
     };
 
-    struct Sub : public NativeWord {
-        void run(Stack& stack) override {
-            double a = stack.pop_number();
-            double b = stack.pop_number();
-            stack.push_number( b - a );
+    std::vector<std::pair<size_t, DaG::Group>> found;
+    DaG::Group group;
+    size_t group_begin = 0;
+    auto close = [&](size_t end) {
+        if ( group.units.size() >= 2 ) {
+            group.length = end - group_begin;
+            found.push_back( {group_begin, group} );
         }
-        NWORD_CREATOR_DEFINE_LR(Sub)
+        group.units.clear();
     };
 
-    struct Mul : public NativeWord {
-        void run(Stack& stack) override {
-            double a = stack.pop_number();
-            double b = stack.pop_number();
-            stack.push_number( b * a );
+    size_t begin = 0;
+    for (size_t pos = 0; pos < binary_.size(); pos++) {
+        auto& b = binary_[pos];
+        bool push = b.type_ == WordByte::Number || b.type_ == WordByte::String || b.type_ == WordByte::HashGet ||
+                    (b.type_ == WordByte::Native && names_[b.idx_] == "op.null");
+        if ( push ) {
+            if ( b.type_ == WordByte::HashGet ) {
+                pos++;
+            }
+            continue;
         }
-        NWORD_CREATOR_DEFINE_LR(Mul)
-    };
+        auto unit = unit_at(begin, pos);
+        if ( unit.has_value() ) {
+            if ( group.units.size() == 0 ) {
+                group_begin = begin;
+            }
+            group.units.push_back( unit.value() );
+        } else {
+            close(begin);
+        }
+        begin = pos + 1;
+    }
+    close(begin);
+    if ( found.size() == 0 ) {
+        return;
+    }
 
-    struct Div : public NativeWord {
-        void run(Stack& stack) override {
-            double a = stack.pop_number();
-            double b = stack.pop_number();
-            stack.push_number( b / a );
+    // a Parallel byte before each group, positions of units are shifted
+    UserBinary result;
+    size_t from = 0;
+    for (auto& f : found) {
+        result.insert(result.end(), binary_.begin() + from, binary_.begin() + f.first);
+        size_t shift = result.size() + 1 - f.first;
+        for (auto& u : f.second.units) {
+            u.begin += shift;
+            u.native += shift;
         }
-        NWORD_CREATOR_DEFINE_LR(Div)
-    };
+        result.push_back( WordByte(WordByte::Parallel, dag.groups_.size()) );
+        dag.groups_.push_back( f.second );
+        from = f.first;
+    }
+    result.insert(result.end(), binary_.begin() + from, binary_.end());
+    binary_.swap(result);
+}
 
-    struct IntDiv : public NativeWord {
+// Persistent workers for teams, worker i runs the task of team i, the caller is team 0.
+// Workers are bound to engine of the thread making the pool.
+struct TeamPool {
+    TeamPool(int teams) : tasks_(teams), engine_( ComputingContext::capture() ) {
+        for (int i = 1; i < teams; i++) {
+            workers_.push_back( std::thread([this, i] { work(i); }) );
+        }
+    }
+    ~TeamPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            quit_ = true;
+        }
+        cond_.notify_all();
+        for (auto& w : workers_) {
+            w.join();
+        }
+        delete engine_;
+    }
+
+    // runs tasks [0, n) concurrently and waits them all
+    void run(size_t n, const std::function<void(size_t)>& task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 1; i < n; i++) {
+                tasks_[i] = [&task, i] { task(i); };
+            }
+            pending_ = n - 1;
+            round_++;
+        }
+        cond_.notify_all();
+
+        ComputingContext::team_enter(0);
+        task(0);
+        ComputingContext::team_leave();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return pending_ == 0; });
+    }
+
+private:
+    void work(int team) {
+        ComputingContext::bind(engine_);
+        size_t seen = 0;
+        for (;;) {
+            std::function<void()> t;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [&] { return quit_ || round_ != seen; });
+                if ( quit_ ) {
+                    return;
+                }
+                seen = round_;
+                t.swap( tasks_[team] );
+            }
+            if ( !t ) {
+                continue;
+            }
+            ComputingContext::team_enter(team);
+            t();
+            ComputingContext::team_leave();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_--;
+            }
+            done_.notify_one();
+        }
+    }
+
+    std::vector<std::function<void()>> tasks_;
+    ComputingContext::Engine* engine_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::condition_variable done_;
+    size_t pending_ = 0;
+    size_t round_ = 0;
+    bool quit_ = false;
+};
+
+int Enviroment::run_group(DaG* dag, size_t idx) {
+    auto& group = dag->groups_[idx];
+    // recording keeps the group for replaying, profiling sees words one by one
+    if ( recording_ != nullptr ) {
+        record_hash();
+        recording_units_ = group.units.size();
+        recording_group_ = recording_->steps.size();
+        return 1;
+    }
+    if ( teams_ <= 1 || profiler_.enabled_ ) {
+        return 1;
+    }
+    auto& binary_ = dag->binary_;
+    auto& natives_ = dag->natives_;
+
+    // arguments are evaluated by the caller, the hash isn't touched by teams
+    std::vector<Task> tasks( group.units.size() );
+    for (size_t u = 0; u < group.units.size(); u++) {
+        auto& unit = group.units[u];
+        auto& task = tasks[u];
+        task.word = natives_[ binary_[unit.native].idx_ ];
+        task.name = &dag->native_names_[ binary_[unit.native].idx_ ];
+        task.writes = unit.writes;
+        for (size_t i = unit.begin; i < unit.native; ) {
+            auto& b = binary_[i];
+            if ( b.type_ == WordByte::Number ) {
+                task.args.push_back( Cell(b.num_) );
+                i += 1;
+            } else if ( b.type_ == WordByte::String ) {
+                task.args.push_back( Cell(b.str_) );
+                i += 1;
+            } else if ( b.type_ == WordByte::HashGet ) {
+                task.args.push_back( hash_.get(b.idx_) );
+                i += 2;
+            } else {
+                natives_[b.idx_]->run( stack_ );
+                task.args.push_back( stack_.pop() );
+                i += 1;
+            }
+        }
+    }
+    run_tasks(tasks);
+    return group.length + 1;
+}
+
+void Enviroment::run_tasks(std::vector<Task>& tasks) {
+    using Ranges = std::vector<std::pair<const char*, const char*>>;
+    std::vector<Ranges> reads( tasks.size() );
+    std::vector<Ranges> writes( tasks.size() );
+    for (size_t u = 0; u < tasks.size(); u++) {
+        auto& task = tasks[u];
+        for (size_t i = 0; i < task.args.size(); i++) {
+            auto& a = task.args[i];
+            if ( !a.is_tensor() || a.as_tensor() == nullptr ) {
+                continue;
+            }
+            auto& t = a.as_tensor();
+            const char* p = (const char *)t->device_data();
+            const char* e = p + (size_t)(t->shape().span() * item_bytes(t->dtype())) + 1;
+            auto& w = *task.writes;
+            if ( std::find(w.begin(), w.end(), i) != w.end() ) {
+                writes[u].push_back({p, e});
+            } else {
+                reads[u].push_back({p, e});
+            }
+        }
+    }
+
+    auto overlap = [](const Ranges& a, const Ranges& b) {
+        for (auto& x : a) {
+            for (auto& y : b) {
+                if ( x.first < y.second && y.first < x.second ) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    // in order waves, a unit joins the wave when it doesn't conflict with any unit of it
+    size_t u = 0;
+    while ( u < tasks.size() ) {
+        size_t end = u + 1;
+        while ( end < tasks.size() && (int)(end - u) < teams_ ) {
+            bool conflict = false;
+            for (size_t k = u; k < end; k++) {
+                if ( overlap(writes[end], writes[k]) || overlap(writes[end], reads[k]) ||
+                     overlap(reads[end], writes[k]) ) {
+                    conflict = true;
+                    break;
+                }
+            }
+            if ( conflict ) {
+                break;
+            }
+            end++;
+        }
+
+        auto launch = [&](size_t i) {
+            auto& task = tasks[u + i];
+            Stack local;
+            for (auto& a : task.args) {
+                local.push(a);
+            }
+            if ( TraceContext::enabled ) {
+                TraceSpan span(task.name->c_str(), "op");
+                task.word->run( local );
+            } else {
+                task.word->run( local );
+            }
+        };
+        if ( end - u == 1 ) {
+            launch(0);
+        } else {
+            pool_->run(end - u, launch);
+        }
+        u = end;
+    }
+}
+
+void Enviroment::concurrency(int teams) {
+    vt_assert(teams >= 1, "Teams must be positive!");
+    if ( pool_ != nullptr ) {
+        delete pool_;
+        pool_ = nullptr;
+    }
+    teams_ = teams > 1 ? ComputingContext::boot_teams(teams) : 1;
+    if ( teams_ > 1 ) {
+        pool_ = new TeamPool(teams_);
+    }
+}
+
+void Enviroment::dump_binary(DaG* dag, std::ostream& os) {
+    auto& binary_ = dag->binary_;
+    for (size_t i = 0; i < binary_.size(); i++) {
+        auto& byte = binary_[i];
+        os << i << " ";
+        switch( byte.type_ ) {
+            case WordByte::Number:
+                os << "N:" << byte.num_;
+                break;
+            case WordByte::String:
+                os << "S:" << *byte.str_;
+                break;
+            case WordByte::BuiltinOperator:
+                os << "B:" << byte.idx_;
+                break;
+            case WordByte::Native:
+                os << "NA:" << dag->native_names_[byte.idx_];
+                break;
+            case WordByte::HashGet:
+                os << "@:" << hash_.name(byte.idx_);
+                break;
+            case WordByte::HashSet:
+                os << "!:" << hash_.name(byte.idx_);
+                break;
+            case WordByte::Parallel:
+                os << "P:" << dag->groups_[byte.idx_].units.size() << " units, " << dag->groups_[byte.idx_].length << " bytes";
+                break;
+        }
+        os << std::endl;
+    }
+}
+
+// perf_event_open counters, counting every cpu when allowed ( all omp / dnnl threads are seen ),
+// otherwise the calling thread in user space ( inherited counts are readable only after threads exit ).
+struct PerfCounters {
+    static const size_t events = 3;         // cycles, instructions, llc misses
+    bool system_wide = false;
+    std::vector<int> fds;                   // [cpu][event] or [event]
+    std::vector<int> imc;                   // uncore memory controllers, cas reads & writes
+    std::vector<double> imc_bytes;          // bytes of one count
+    double begin[events + 1];
+
+    ~PerfCounters() {
+        for (auto fd : fds) {
+            ::close(fd);
+        }
+        for (auto fd : imc) {
+            ::close(fd);
+        }
+    }
+
+    static int open_event(uint32_t type, uint64_t config, int pid, int cpu, bool user_only) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_kernel = user_only;
+        attr.exclude_hv = 1;
+        return syscall(__NR_perf_event_open, &attr, pid, cpu, -1, 0);
+    }
+
+    // scaled by multiplexing
+    static double value(int fd) {
+        uint64_t v[3] = {0, 0, 0};
+        if ( ::read(fd, v, sizeof(v)) != sizeof(v) || v[2] == 0 ) {
+            return 0.0;
+        }
+        return (double)v[0] * v[1] / v[2];
+    }
+
+    bool open() {
+        const uint64_t hw[events] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+        int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        system_wide = true;
+        for (int c = 0; c < cpus && system_wide; c++) {
+            for (size_t e = 0; e < events; e++) {
+                int fd = open_event(PERF_TYPE_HARDWARE, hw[e], -1, c, false);
+                if ( fd < 0 ) {
+                    system_wide = false;
+                    break;
+                }
+                fds.push_back(fd);
+            }
+        }
+        if ( !system_wide ) {
+            for (auto fd : fds) {
+                ::close(fd);
+            }
+            fds.clear();
+            for (size_t e = 0; e < events; e++) {
+                int fd = open_event(PERF_TYPE_HARDWARE, hw[e], 0, -1, true);
+                if ( fd < 0 ) {
+                    return false;
+                }
+                fds.push_back(fd);
+            }
+        }
+        open_imc();
+        return true;
+    }
+
+    // Intel uncore_imc_* PMUs, "event=0x04,umask=0x03" and scale in MiB
+    void open_imc() {
+        glob_t dirs;
+        if ( glob("/sys/bus/event_source/devices/uncore_imc*", 0, nullptr, &dirs) != 0 ) {
+            return;
+        }
+        auto text = [](const std::string& fname) -> std::string {
+            std::ifstream f(fname);
+            std::string line;
+            std::getline(f, line);
+            return line;
+        };
+        for (size_t i = 0; i < dirs.gl_pathc; i++) {
+            std::string dir = dirs.gl_pathv[i];
+            std::string type = text(dir + "/type");
+            std::string cpu = text(dir + "/cpumask");
+            if ( type == "" ) {
+                continue;
+            }
+            for (auto name : {"cas_count_read", "cas_count_write"}) {
+                std::string desc = text(dir + "/events/" + name);
+                std::string scale = text(dir + "/events/" + name + ".scale");
+                if ( desc == "" || scale == "" ) {
+                    continue;
+                }
+                uint64_t config = 0;
+                std::stringstream ss(desc);
+                std::string kv;
+                while ( std::getline(ss, kv, ',') ) {
+                    auto eq = kv.find('=');
+                    if ( eq == std::string::npos ) {
+                        continue;
+                    }
+                    uint64_t v = std::stoull(kv.substr(eq + 1), nullptr, 0);
+                    if ( kv.substr(0, eq) == "event" ) {
+                        config |= v;
+                    } else if ( kv.substr(0, eq) == "umask" ) {
+                        config |= v << 8;
+                    }
+                }
+                int fd = open_event(std::stoi(type), config, -1, cpu == "" ? 0 : std::stoi(cpu), false);
+                if ( fd >= 0 ) {
+                    imc.push_back(fd);
+                    imc_bytes.push_back( std::stod(scale) * 1024.0 * 1024.0 );
+                }
+            }
+        }
+        globfree(&dirs);
+    }
+
+    void snapshot(double* out) {
+        for (size_t i = 0; i <= events; i++) {
+            out[i] = 0.0;
+        }
+        for (size_t i = 0; i < fds.size(); i++) {
+            out[i % events] += value(fds[i]);
+        }
+        for (size_t i = 0; i < imc.size(); i++) {
+            out[events] += value(imc[i]) * imc_bytes[i];
+        }
+    }
+
+    void start() {
+        snapshot(begin);
+    }
+
+    void stop(Profiler::Site& site) {
+        double end[events + 1];
+        snapshot(end);
+        site.cycles += end[0] - begin[0];
+        site.instructions += end[1] - begin[1];
+        site.llc_misses += end[2] - begin[2];
+        site.dram_bytes += end[3] - begin[3];
+    }
+};
+
+Profiler::~Profiler() {
+    delete counters_;
+}
+
+bool Profiler::counters(bool enable) {
+    delete counters_;
+    counters_ = nullptr;
+    if ( !enable ) {
+        return true;
+    }
+    counters_ = new PerfCounters();
+    if ( !counters_->open() ) {
+        delete counters_;
+        counters_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void Enviroment::profile_native(DaG* dag, size_t idx) {
+
+    auto& name = dag->native_names_[idx];
+    auto& site = profiler_.sites_[ {dag->id_, idx} ];
+
+    // arguments are known only for words with registered cost
+    std::vector<Cell> args;
+    Profiler::Cost* cost = nullptr;
+    auto c = profiler_.costs_.find(name);
+    if ( c != profiler_.costs_.end() && stack_.size() >= c->second.args ) {
+        cost = &c->second;
+        for (size_t i = 0; i < cost->args; i++) {
+            args.push_back( stack_.peek(cost->args - 1 - i) );
+        }
+    }
+
+    ComputingContext::sync();
+    if ( profiler_.counters_ != nullptr ) {
+        profiler_.counters_->start();
+    }
+    auto begin = std::chrono::steady_clock::now();
+    dag->natives_[idx]->run( stack_ );
+    ComputingContext::sync();
+    auto end = std::chrono::steady_clock::now();
+    double t = std::chrono::duration<double>(end - begin).count();
+    if ( profiler_.counters_ != nullptr ) {
+        profiler_.counters_->stop(site);
+    }
+
+    if ( site.calls == 0 ) {
+        site.word = name;
+        site.path = dag->native_paths_[idx];
+        std::stringstream ss;
+        for (auto& a : args) {
+            if ( a.is_tensor() && a.as_tensor() != nullptr ) {
+                ss << DataType_name(a.as_tensor()->dtype()) << ":" << a.as_tensor()->shape().to_string() << " ";
+            }
+        }
+        site.shapes = ss.str();
+    }
+    if ( cost != nullptr ) {
+        std::vector<TensorType*> seen;
+        for (auto& a : args) {
+            if ( !a.is_tensor() || a.as_tensor() == nullptr ) {
+                continue;
+            }
+            auto* p = a.as_tensor().get();
+            if ( std::find(seen.begin(), seen.end(), p) != seen.end() ) {
+                continue;
+            }
+            seen.push_back(p);
+            site.bytes += p->items() * item_bytes( p->dtype() );
+        }
+        site.flops += cost->fn(args);
+    }
+
+    const size_t max_samples = 4096;
+    if ( site.samples.size() < max_samples ) {
+        site.samples.push_back(t * 1.0e6);
+    } else {
+        site.samples[ site.calls % max_samples ] = t * 1.0e6;
+    }
+    site.calls++;
+    site.total += t;
+}
+
+// best of a few runs, copying doesn't count write allocation, fma chains are vectorized by compiler
+void Profiler::roofline() {
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    auto parallel = [&](std::function<void(size_t)> fn) -> double {
+        auto begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < threads; i++) {
+            workers.emplace_back(fn, i);
+        }
+        for (auto& w : workers) {
+            w.join();
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    };
+
+    const size_t items = 32 * 1024 * 1024;
+    std::vector<float> va(items, 1.0f);
+    std::vector<float> vb(items, 0.0f);
+    float* a = va.data();
+    float* b = vb.data();
+    double best = 1.0e9;
+    for (int r = 0; r < 4; r++) {
+        best = std::min(best, parallel([&](size_t i) {
+            size_t begin = items / threads * i;
+            size_t end = i == threads - 1 ? items : begin + items / threads;
+            for (size_t k = begin; k < end; k++) {
+                b[k] = a[k] * 0.5f;
+            }
+        }));
+    }
+    peak_gbs_ = items * sizeof(float) * 2.0 / best / 1.0e9;
+
+    const size_t lanes = 64;
+    const size_t loops = 1024 * 1024;
+    std::vector<float> sink(threads, 0.0f);
+    best = 1.0e9;
+    for (int r = 0; r < 4; r++) {
+        best = std::min(best, parallel([&](size_t i) {
+            float acc[lanes];
+            for (size_t j = 0; j < lanes; j++) {
+                acc[j] = (float)j;
+            }
+            for (size_t k = 0; k < loops; k++) {
+                for (size_t j = 0; j < lanes; j++) {
+                    acc[j] = acc[j] * 0.999f + 0.001f;
+                }
+            }
+            for (size_t j = 0; j < lanes; j++) {
+                sink[i] += acc[j];
+            }
+        }));
+    }
+    peak_gflops_ = 2.0 * lanes * loops * threads / best / 1.0e9;
+}
+
+void Profiler::dump(std::ostream& os, size_t top) {
+    std::vector<Site*> order;
+    double all = 0.0;
+    for (auto& i : sites_) {
+        order.push_back(&i.second);
+        all += i.second.total;
+    }
+    std::sort(order.begin(), order.end(), [](Site* a, Site* b) {
+        return a->total > b->total;
+    });
+    if ( top == 0 || top > order.size() ) {
+        top = order.size();
+    }
+
+    auto percentile = [](std::vector<float> v, double p) -> double {
+        if ( v.size() == 0 ) {
+            return 0.0;
+        }
+        size_t k = std::min(v.size() - 1, (size_t)(p * v.size()));
+        std::nth_element(v.begin(), v.begin() + k, v.end());
+        return v[k];
+    };
+
+    os << "==== profile: " << sites_.size() << " sites, " << all * 1000.0 << " ms";
+    if ( peak_gbs_ > 0 ) {
+        os << ", roofline " << peak_gbs_ << " GB/s " << peak_gflops_ << " GFLOP/s";
+    }
+    os << " ====" << std::endl;
+    os << "total(ms)    %  calls  mean(us)   p50(us)   p90(us)   p99(us)  GFLOP/s     GB/s  roof%  word / path / shapes" << std::endl;
+    for (size_t i = 0; i < top; i++) {
+        auto& s = *order[i];
+        double gflops = s.flops / s.total / 1.0e9;
+        double gbs = s.bytes / s.total / 1.0e9;
+
+        // attainable performance of the op's intensity
+        double roof = 0.0;
+        if ( peak_gbs_ > 0 && s.bytes > 0 ) {
+            double attainable = std::min(peak_gflops_, s.flops / s.bytes * peak_gbs_);
+            roof = attainable > 0 ? gflops / attainable : gbs / peak_gbs_;
+        }
+
+        char line[256];
+        snprintf(line, sizeof(line), "%9.3f %5.1f %6zu %9.1f %9.1f %9.1f %9.1f %8.2f %8.2f %6.1f  ",
+                 s.total * 1000.0, all > 0 ? s.total / all * 100.0 : 0.0, s.calls, s.total / s.calls * 1.0e6,
+                 percentile(s.samples, 0.5), percentile(s.samples, 0.9), percentile(s.samples, 0.99),
+                 gflops, gbs, roof * 100.0);
+        os << line << s.word << " " << s.path << " " << s.shapes << std::endl;
+    }
+
+    if ( counters_ == nullptr ) {
+        return;
+    }
+    os << "==== counters: " << (counters_->system_wide ? "all cpus" : "calling thread, user space");
+    if ( counters_->imc.size() == 0 ) {
+        os << ", DRAM not readable";
+    }
+    os << " ====" << std::endl;
+    os << "  Mcycles    Minstr    IPC  LLC miss(K)  miss/Kinstr  DRAM GB/s  word / path" << std::endl;
+    for (size_t i = 0; i < top; i++) {
+        auto& s = *order[i];
+        char line[256];
+        snprintf(line, sizeof(line), "%9.2f %9.2f %6.2f %12.1f %12.2f %10.2f  ",
+                 s.cycles / 1.0e6, s.instructions / 1.0e6, s.cycles > 0 ? s.instructions / s.cycles : 0.0,
+                 s.llc_misses / 1.0e3, s.instructions > 0 ? s.llc_misses / s.instructions * 1.0e3 : 0.0,
+                 counters_->imc.size() > 0 ? s.dram_bytes / s.total / 1.0e9 : 0.0);
+        os << line << s.word << " " << s.path << std::endl;
+    }
+}
+
+// Tensors returned by recorded words are registers, any argument pointing to them reads the register.
+Replay::Arg Enviroment::record_arg(const Cell& cell) {
+    if ( cell.is_tensor() && cell.as_tensor() != nullptr ) {
+        auto i = recording_regs_.find( cell.as_tensor().get() );
+        if ( i != recording_regs_.end() ) {
+            return {Cell(), i->second.first};
+        }
+    }
+    return {cell, -1};
+}
+
+// Tensors the word reads from hash before writing them are loaded again when replaying, the
+// caller can bind a new object ( e.g. views of input ) to the same name between steps.
+void Enviroment::record_hash() {
+    for (auto& in : recording_inputs_) {
+        const Cell& c = in.second;
+        if ( !c.is_tensor() || c.as_tensor() == nullptr ) {
+            continue;
+        }
+        if ( recording_regs_.find( c.as_tensor().get() ) != recording_regs_.end() ) {
+            continue;
+        }
+        int reg = recording_->regs++;
+        recording_->inputs.push_back( {in.first, reg} );
+        recording_regs_[ c.as_tensor().get() ] = {reg, c.as_tensor()};
+    }
+    recording_inputs_.clear();
+
+    for (auto s : recording_slots_) {
+        Replay::Step step;
+        step.word = nullptr;
+        step.name = nullptr;
+        step.slot = s;
+        step.valid = hash_.valid(s);
+        if ( step.valid ) {
+            step.args.push_back( record_arg(hash_.at(s)) );
+        }
+        recording_->steps.push_back( std::move(step) );
+    }
+    recording_slots_.clear();
+}
+
+void Enviroment::record_native(DaG* dag, size_t idx) {
+    record_hash();
+
+    NativeWord* word = dag->natives_[idx];
+    size_t low = stack_.low();
+    size_t before = stack_.size();
+    std::vector<Cell> cells;
+    cells.reserve(before);
+    for (size_t i = 0; i < before; i++) {
+        cells.push_back( stack_.peek(before - 1 - i) );
+    }
+
+    // the word reads hash by itself again when replaying
+    stack_.set_low(before);
+    hash_.inputs_ = nullptr;
+    word->run( stack_ );
+    hash_.inputs_ = &recording_inputs_;
+    size_t used = stack_.low();
+    stack_.set_low( std::min(low, used) );
+
+    // pure words without live arguments are folded, their results become constants of later steps
+    bool fold = pure_words_.find( dag->native_names_[idx] ) != pure_words_.end();
+    std::vector<Replay::Arg> args;
+    for (size_t i = used; i < before; i++) {
+        args.push_back( record_arg(cells[i]) );
+        if ( args.back().reg >= 0 ) {
+            fold = false;
+        }
+    }
+    if ( fold ) {
+        return;
+    }
+
+    Replay::Step step;
+    step.word = word;
+    step.name = &dag->native_names_[idx];
+    step.args = std::move(args);
+    step.slot = 0;
+    step.valid = false;
+    for (size_t i = used; i < stack_.size(); i++) {
+        const Cell& c = stack_.peek(stack_.size() - 1 - i);
+        Replay::Arg out = {c, -1};
+        if ( c.is_tensor() && c.as_tensor() != nullptr ) {
+            out.reg = recording_->regs++;
+            recording_regs_[ c.as_tensor().get() ] = {out.reg, c.as_tensor()};
+        } else if ( !c.is_number() ) {
+            out = {Cell(), -2};
+        }
+        step.outs.push_back(out);
+    }
+    recording_->steps.push_back( std::move(step) );
+
+    // the word writes them again when replaying
+    recording_slots_.clear();
+
+    if ( recording_units_ > 0 && --recording_units_ == 0 ) {
+        recording_->steps[recording_group_].group = recording_->steps.size() - recording_group_;
+    }
+}
+
+// Keyed by the caller, the word must behave the same for the same key: numbers & strings read from
+// hash are taken as constants, numbers returned by non pure words are checked when replaying.
+void Enviroment::replay(const std::string& word, const std::string& key) {
+    DaG*& dag = replay_dags_[word];
+    if ( dag == nullptr ) {
+        dag = build(word);
+    }
+
+    // profiling sees every interpreted word, branches can't be recorded
+    bool branches = false;
+    for (auto op : dag->builtins_) {
+        if ( dynamic_cast<builtin::BuiltinJNZ*>(op) != nullptr || dynamic_cast<builtin::BuiltinJZ*>(op) != nullptr ) {
+            branches = true;
+        }
+    }
+    if ( profiler_.enabled_ || branches ) {
+        run_(dag);
+        return;
+    }
+
+    auto i = replays_.find( {word, key} );
+    if ( i == replays_.end() ) {
+        vt_assert(recording_ == nullptr, "Replay can't be nested!");
+        const size_t max_replays = 256;
+        if ( replays_.size() >= max_replays ) {
+            replays_.clear();
+        }
+
+        Replay& r = replays_[ {word, key} ];
+        size_t n0 = stack_.size();
+        recording_ = &r;
+        hash_.log_ = &recording_slots_;
+        hash_.inputs_ = &recording_inputs_;
+        hash_.written_.clear();
+        stack_.set_low(n0);
+
+        run_(dag);
+
+        record_hash();
+        size_t low = stack_.low();
+        r.consumed = n0 - low;
+        for (size_t k = low; k < stack_.size(); k++) {
+            r.results.push_back( record_arg( stack_.peek(stack_.size() - 1 - k) ) );
+        }
+        hash_.log_ = nullptr;
+        hash_.inputs_ = nullptr;
+        hash_.written_.clear();
+        recording_ = nullptr;
+        recording_regs_.clear();
+        return;
+    }
+
+    Replay& r = i->second;
+    std::vector<Cell> regs(r.regs);
+    for (auto& in : r.inputs) {
+        regs[in.second] = hash_.at(in.first);
+    }
+    auto value = [&](const Replay::Arg& a) -> const Cell& {
+        return a.reg >= 0 ? regs[a.reg] : a.value;
+    };
+    for (size_t n = 0; n < r.steps.size(); n++) {
+        auto& s = r.steps[n];
+        if ( s.group > 1 && teams_ > 1 ) {
+            std::vector<Task> tasks( s.group );
+            for (size_t u = 0; u < s.group; u++) {
+                auto& g = r.steps[n + u];
+                tasks[u].word = g.word;
+                tasks[u].name = g.name;
+                tasks[u].writes = &effects_[ *g.name ].writes;
+                for (auto& a : g.args) {
+                    tasks[u].args.push_back( value(a) );
+                }
+            }
+            run_tasks(tasks);
+            n += s.group - 1;
+            continue;
+        }
+
+        if ( s.word == nullptr ) {
+            if ( s.valid ) {
+                hash_.set_at(s.slot, value(s.args[0]));
+            } else {
+                hash_.drop_at(s.slot);
+            }
+            continue;
+        }
+
+        for (auto& a : s.args) {
+            stack_.push( value(a) );
+        }
+        if ( TraceContext::enabled ) {
+            TraceSpan op(s.name->c_str(), "op");
+            s.word->run( stack_ );
+        } else {
+            s.word->run( stack_ );
+        }
+        for (size_t k = s.outs.size(); k > 0; k--) {
+            Cell c = stack_.pop();
+            auto& out = s.outs[k - 1];
+            if ( out.reg >= 0 ) {
+                regs[ out.reg ] = std::move(c);
+            } else if ( out.reg == -1 && c.as_number() != out.value.as_number() ) {
+                std::cout << "Replay: " << *s.name << " returns " << c.as_number() << ", recorded " << out.value.as_number() << std::endl;
+                vt_panic("Replay key doesn't cover a number returned by word!");
+            }
+        }
+    }
+    for (size_t k = 0; k < r.consumed; k++) {
+        stack_.drop();
+    }
+    for (auto& a : r.results) {
+        stack_.push( value(a) );
+    }
+}
+
+// Uses of a buffer are its "name @" over the whole traced word, calls of user words are inlined
+// and a use is counted at the native word consuming it. An argument written by a word with
+// registered effect, not read by the same word, through the buffer or an alias covering all of
+// it, overwrites the buffer, content from before isn't needed any more.
+void Enviroment::trace_plan(UserWord& word, size_t& pos, PlanRefs& refs) {
+    auto& buffers = plan_.buffers_;
+    auto is_get = [&](size_t i) {
+        return word[i].type_ == WordCode::String && i + 1 < word.size()
+            && word[i+1].type_ == WordCode::Builtin && word[i+1].str_ == "@";
+    };
+    auto is_null = [&](size_t i) {
+        return word[i].type_ == WordCode::Native && word[i].str_ == "op.null";
+    };
+
+    for (size_t i = 0; i < word.size(); i++) {
+        auto& code = word[i];
+        if ( code.type_ == WordCode::User ) {
+            trace_plan( get_user(code.str_), pos, refs);
+            continue;
+        }
+        if ( is_get(i) && buffers.find(code.str_) != buffers.end() ) {
+            refs[ plan_.root(code.str_) ].push_back( {(size_t)-1, false} );
+        }
+        if ( code.type_ == WordCode::Native && !is_null(i) ) {
+            // roots fully written by this word, arguments are plain pushes like scheduling needs
+            std::set<std::string> written, read;
+            auto e = effects_.find(code.str_);
+            if ( e != effects_.end() ) {
+                size_t k = e->second.args;
+                size_t j = i;
+                while ( k > 0 && j > 0 ) {
+                    std::string name;
+                    if ( j >= 2 && is_get(j - 2) ) {
+                        name = word[j - 2].str_;
+                        j -= 2;
+                    } else if ( word[j - 1].type_ == WordCode::Number || word[j - 1].type_ == WordCode::String || is_null(j - 1) ) {
+                        j -= 1;
+                    } else {
+                        break;
+                    }
+                    k--;
+                    if ( buffers.find(name) == buffers.end() ) {
+                        continue;
+                    }
+                    auto& b = buffers[name];
+                    auto& root = plan_.root(name);
+                    bool whole = b.parent_ == "" || ( b.offset_ == 0 && b.size_ >= buffers[root].size_ );
+                    auto& w = e->second.writes;
+                    if ( whole && std::find(w.begin(), w.end(), k) != w.end() ) {
+                        written.insert(root);
+                    } else {
+                        read.insert(root);
+                    }
+                }
+                if ( k > 0 ) {
+                    written.clear();
+                }
+            }
+            for (auto r = refs.begin(); r != refs.end(); r++) {
+                bool def = written.count(r->first) > 0 && read.count(r->first) == 0;
+                for (auto k = r->second.rbegin(); k != r->second.rend() && k->first == (size_t)-1; k++) {
+                    *k = {pos, def};
+                }
+            }
+        }
+        pos++;
+    }
+}
+
+std::string Enviroment::dump_words() {
+    std::stringstream ss;
+    ss << std::setprecision(17);
+    for (auto& w : user_words_) {
+        ss << w.first << " " << w.second.size() << std::endl;
+        for (auto& c : w.second) {
+            ss << c << std::endl;
+        }
+    }
+    return ss.str();
+}
+
+size_t Enviroment::build_plan(const std::string& word, size_t align) {
+    auto& buffers = plan_.buffers_;
+    vt_assert( buffers.size() > 0, "Can't build plan without any buffer!");
+
+    PlanRefs refs;
+    size_t end = 0;
+    trace_plan( get_user(word), end, refs);
+
+    // every overwrite starts a live range till the last use before next overwrite, uses before first
+    // overwrite read content of last run and make a range from the beginning. Content left by the
+    // word could be read after it, so last range goes on to the end. A buffer never used is kept
+    // alive all the time.
+    std::map<std::string, std::vector<std::pair<size_t, size_t>>> lives;
+    for (auto i = buffers.begin(); i != buffers.end(); i++) {
+        if ( i->second.parent_ != "" ) {
+            continue;
+        }
+        auto& name = i->first;
+        auto& ranges = lives[name];
+        if ( refs.find(name) == refs.end() ) {
+            ranges.push_back( {0, (size_t)-1} );
+            continue;
+        }
+        auto& uses = refs[name];
+        for (auto& u : uses) {
+            size_t p = std::min(u.first, end);
+            if ( u.second || ranges.size() == 0 ) {
+                ranges.push_back( {u.second ? p : 0, p} );
+            }
+            ranges.back().second = p;
+        }
+        if ( !uses.front().second || uses.back().second ) {
+            ranges.back().second = (size_t)-1;
+        }
+    }
+
+    auto overlapped = [&](const std::string& a, const std::string& b) -> bool {
+        for (auto& x : lives[a]) {
+            for (auto& y : lives[b]) {
+                if ( x.first <= y.second && y.first <= x.second ) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    // best fit interval coloring, larger buffers placed first
+    std::vector<std::string> order;
+    for (auto i = lives.begin(); i != lives.end(); i++) {
+        auto& b = buffers[i->first];
+        b.size_ = (b.size_ + align - 1) / align * align;
+        order.push_back(i->first);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const std::string& a, const std::string& b) {
+        return buffers[a].size_ > buffers[b].size_;
+    });
+
+    size_t peak = 0;
+    std::vector<std::string> placed;
+    for (auto& name : order) {
+        auto& b = buffers[name];
+        std::vector<std::pair<size_t, size_t>> used;
+        for (auto& other : placed) {
+            if ( overlapped(name, other) ) {
+                auto& o = buffers[other];
+                used.push_back( {o.offset_, o.offset_ + o.size_} );
+            }
+        }
+        std::sort(used.begin(), used.end());
+
+        size_t best = (size_t)-1;
+        size_t best_gap = (size_t)-1;
+        size_t cur = 0;
+        for (auto& u : used) {
+            if ( u.first > cur ) {
+                size_t gap = u.first - cur;
+                if ( gap >= b.size_ && gap < best_gap ) {
+                    best = cur;
+                    best_gap = gap;
+                }
+            }
+            cur = std::max(cur, u.second);
+        }
+        if ( best == (size_t)-1 ) {
+            best = cur;
+        }
+        b.offset_ = best;
+        placed.push_back(name);
+
+        peak = std::max(peak, b.offset_ + b.size_);
+    }
+
+    plan_.peak_ = peak;
+    return peak;
+}
+
+namespace base {
+    struct Exit : public NativeWord {
+        void run(Stack& stack) override {
+            exit(0);
+        }
+        NWORD_CREATOR_DEFINE_LR(Exit)
+    };
+
+    struct Dump : public NativeWord {
+        void run(Stack& stack) override {
+            std::cout << stack << std::endl;
+        }
+        NWORD_CREATOR_DEFINE_LR(Dump)
+    };
+
+    struct Echo : public NativeWord {
+        void run(Stack& stack) override {
+            Cell cell = stack.pop();
+            std::cout << cell << std::endl;
+        }
+        NWORD_CREATOR_DEFINE_LR(Echo)
+    };
+
+    struct Drop : public NativeWord {
+        void run(Stack& stack) override {
+            stack.drop();
+        }
+        NWORD_CREATOR_DEFINE_LR(Drop)
+    };
+
+    struct Dup : public NativeWord {
+        void run(Stack& stack) override {
+            stack.dup();
+        }
+        NWORD_CREATOR_DEFINE_LR(Dup)
+    };
+
+    struct Dup2 : public NativeWord {
+        void run(Stack& stack) override {
+            stack.dup2();
+        }
+        NWORD_CREATOR_DEFINE_LR(Dup2)
+    };
+
+    struct Swap : public NativeWord {
+        void run(Stack& stack) override {
+            stack.swap();
+        }
+        NWORD_CREATOR_DEFINE_LR(Swap)
+    };
+
+    struct Rot : public NativeWord {
+        void run(Stack& stack) override {
+            stack.rot();
+        }
+        NWORD_CREATOR_DEFINE_LR(Rot)
+    };
+
+    struct Rev : public NativeWord {
+        void run(Stack& stack) override {
+            int n = stack.pop_number();
+            stack.rev(n);
+        }
+        NWORD_CREATOR_DEFINE_LR(Rev)
+    };
+
+    struct Add : public NativeWord {
+        void run(Stack& stack) override {
+            double a = stack.pop_number();
+            double b = stack.pop_number();
+            stack.push_number( b + a );
+        }
+        NWORD_CREATOR_DEFINE_LR(Add)
+    };
+
+    struct Sub : public NativeWord {
+        void run(Stack& stack) override {
+            double a = stack.pop_number();
+            double b = stack.pop_number();
+            stack.push_number( b - a );
+        }
+        NWORD_CREATOR_DEFINE_LR(Sub)
+    };
+
+    struct Mul : public NativeWord {
+        void run(Stack& stack) override {
+            double a = stack.pop_number();
+            double b = stack.pop_number();
+            stack.push_number( b * a );
+        }
+        NWORD_CREATOR_DEFINE_LR(Mul)
+    };
+
+    struct Div : public NativeWord {
+        void run(Stack& stack) override {
+            double a = stack.pop_number();
+            double b = stack.pop_number();
+            stack.push_number( b / a );
+        }
+        NWORD_CREATOR_DEFINE_LR(Div)
+    };
+
+    struct IntDiv : public NativeWord {
         void run(Stack& stack) override {
             double a = stack.pop_number();
             double b = stack.pop_number();
@@ -632,10 +2329,171 @@ namespace base {
         NWORD_CREATOR_DEFINE_LR(Equals)
     };
 
+    // affects DAGs built later
+    struct Fusion : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            bool dump = stack.pop_boolean();
+            bool enable = stack.pop_boolean();
+            env_->fusion(enable, dump);
+        }
+        static NativeWord* creator(Enviroment& env) {
+            Fusion* wd = new Fusion();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct Cache : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            auto dir = stack.pop_string();
+            env_->cache(dir);
+        }
+        static NativeWord* creator(Enviroment& env) {
+            Cache* wd = new Cache();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct Teams : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            int teams = stack.pop_number();
+            env_->concurrency(teams);
+        }
+        static NativeWord* creator(Enviroment& env) {
+            Teams* wd = new Teams();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct Profile : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            env_->profiler().enabled_ = stack.pop_boolean();
+        }
+        static NativeWord* creator(Enviroment& env) {
+            Profile* wd = new Profile();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct ProfileReset : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            env_->profiler().reset();
+        }
+        static NativeWord* creator(Enviroment& env) {
+            ProfileReset* wd = new ProfileReset();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct ProfileDump : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            size_t top = stack.pop_number();
+            env_->profiler().dump(std::cout, top);
+        }
+        static NativeWord* creator(Enviroment& env) {
+            ProfileDump* wd = new ProfileDump();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct Counters : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            bool enable = stack.pop_boolean();
+            if ( !env_->profiler().counters(enable) ) {
+                std::cout << "perf_event_open is refused, check /proc/sys/kernel/perf_event_paranoid" << std::endl;
+            }
+        }
+        static NativeWord* creator(Enviroment& env) {
+            Counters* wd = new Counters();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    // key... n word --, the key stays on stack for the word
+    struct RunReplay : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            std::string word = stack.pop_string();
+            size_t n = stack.pop_number();
+            std::stringstream key;
+            for (size_t i = 0; i < n; i++) {
+                key << stack.peek(n - 1 - i).as_number() << ",";
+            }
+            env_->replay(word, key.str());
+        }
+        static NativeWord* creator(Enviroment& env) {
+            RunReplay* wd = new RunReplay();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct ReplayClear : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            env_->replay_clear();
+        }
+        static NativeWord* creator(Enviroment& env) {
+            ReplayClear* wd = new ReplayClear();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    // zero peaks measure the host
+    struct Roofline : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            double gflops = stack.pop_number();
+            double gbs = stack.pop_number();
+            auto& prof = env_->profiler();
+            if ( gbs <= 0 || gflops <= 0 ) {
+                prof.roofline();
+            } else {
+                prof.peak_gbs_ = gbs;
+                prof.peak_gflops_ = gflops;
+            }
+            std::cout << "Roofline: " << prof.peak_gbs_ << " GB/s, " << prof.peak_gflops_ << " GFLOP/s" << std::endl;
+        }
+        static NativeWord* creator(Enviroment& env) {
+            Roofline* wd = new Roofline();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    // spans are recorded only after TraceContext::boot
+    struct Trace : public NativeWord {
+        void run(Stack& stack) override {
+            TraceContext::enabled = stack.pop_boolean();
+        }
+        NWORD_CREATOR_DEFINE_LR(Trace)
+    };
+
+    struct TraceSave : public NativeWord {
+        void run(Stack& stack) override {
+            TraceContext::save();
+        }
+        NWORD_CREATOR_DEFINE_LR(TraceSave)
+    };
+
     struct Combin : public NativeWord {
         void run(Stack& stack) override {
-            auto a = stack.pop_string();
-            auto b = stack.pop_string();
+            const auto& a = stack.pop_string();
+            const auto& b = stack.pop_string();
             std::string c = b + a;
             stack.push_string( c );
         }
@@ -647,10 +2505,20 @@ namespace base {
 
 extern void load_nn_operators(Enviroment& env);
 extern void load_nn_kvcache(Enviroment& env);
+extern void load_nn_weights(Enviroment& env);
 Enviroment::Enviroment() {
     load_base_words();
     load_nn_operators(*this);
     load_nn_kvcache(*this);
+    load_nn_weights(*this);
+}
+Enviroment::~Enviroment() {
+    if ( pool_ != nullptr ) {
+        delete pool_;
+    }
+    for (auto& e : executed_) {
+        delete e.second;
+    }
 }
 void Enviroment::load_base_words() {
     // base words
@@ -672,6 +2540,22 @@ void Enviroment::load_base_words() {
     insert_native_word("==", base::Equals::creator );
 
     insert_native_word("|", base::Combin::creator );
+    insert_native_word("dag.fusion", base::Fusion::creator );
+    insert_native_word("dag.teams", base::Teams::creator );
+    insert_native_word("dag.cache", base::Cache::creator );
+    insert_native_word("dag.profile", base::Profile::creator );
+    insert_native_word("dag.profile_reset", base::ProfileReset::creator );
+    insert_native_word("dag.profile_dump", base::ProfileDump::creator );
+    insert_native_word("dag.roofline", base::Roofline::creator );
+    insert_native_word("dag.counters", base::Counters::creator );
+    insert_native_word("dag.replay", base::RunReplay::creator );
+    insert_native_word("dag.replay_clear", base::ReplayClear::creator );
+
+    for (auto name : {"drop", "dup", "dup2", "swap", "rot", "rev", "+", "-", "*", "/", "//", "==", "|"}) {
+        insert_pure_word(name);
+    }
+    insert_native_word("dag.trace", base::Trace::creator );
+    insert_native_word("dag.trace_save", base::TraceSave::creator );
 }
 
 
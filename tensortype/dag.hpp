@@ -4,43 +4,52 @@
 #define _DAG_MACHINE_H_
 
 #include <map>
+#include <unordered_map>
+#include <set>
 #include <memory>
 #include <string>
 #include <vector>
-#include <list>
 #include <variant>
 #include <optional>
 #include <iostream>
+#include <sstream>
 #include <algorithm>
 #include <cmath>
+#include <atomic>
+
+#include "context.hpp"
 
 namespace vt {
 
 struct TensorType;
 using tensor_t = std::shared_ptr<vt::TensorType>;
 
-// target number type
+// target number type, strings are interned so cells copy a pointer only
 struct Cell {
     enum CellType {
         T_Number,
         T_String,
         T_Tensor,
     };
-    const CellType type_;
-    std::variant<double, const std::string, tensor_t> v_;
+    CellType type_;
+    std::variant<double, const std::string*, tensor_t> v_;
 
     // constructors
     Cell() : type_(T_Number), v_(0.0f) {}
     Cell(double value): type_(T_Number), v_(value) {}
-    Cell(const std::string& value): type_(T_String), v_(value) {}
-    Cell(tensor_t value) : type_(T_Tensor), v_(value) {}
+    Cell(const std::string& value): type_(T_String), v_(intern(value)) {}
+    Cell(const std::string* value): type_(T_String), v_(value) {}
+    Cell(tensor_t value) : type_(T_Tensor), v_(std::move(value)) {}
+
+    // returns the unique copy of a string, which lives until the end of process
+    static const std::string* intern(const std::string& str);
 
     // fast access
-    const std::string& as_string() {
+    const std::string& as_string() const {
         vt_assert(type_ == T_String, "Cell type can't convert to string!");
-        return std::get<1>(v_);
+        return *std::get<1>(v_);
     }
-    bool as_boolean() {
+    bool as_boolean() const {
         vt_assert(type_ == T_Number, "Cell type can't convert to boolean!");
         auto num = std::get<0>(v_);
         if ( num == 0.0) {
@@ -48,27 +57,27 @@ struct Cell {
         }
         return true;
     }
-    double as_number() {
+    double as_number() const {
         vt_assert(type_ == T_Number, "Cell type can't convert to number!");
         return std::get<0>(v_);
     }
-    tensor_t as_tensor() {
+    const tensor_t& as_tensor() const {
         vt_assert(type_ == T_Tensor, "Cell type can't convert to vector!");
         return std::get<2>(v_);
     }
-    bool is_number() {
+    bool is_number() const {
         if ( type_ == T_Number ) {
             return true;
         }
         return false;
     }
-    bool is_string() {
+    bool is_string() const {
         if ( type_ == T_String ) {
             return true;
         }
         return false;
     }
-    bool is_tensor() {
+    bool is_tensor() const {
         if ( type_ == T_Tensor ) {
             return true;
         }
@@ -79,7 +88,9 @@ std::ostream& operator<<(std::ostream& os, Cell& c);
 
 // Stack & Hash
 struct Stack {
-    Stack() {}
+    Stack() {
+        data_.reserve(256);
+    }
     ~Stack() {}
 
     size_t size() {
@@ -93,18 +104,26 @@ struct Stack {
         vt_assert(data_.size() > 0, "Can't access cell from empty stack!");
         return data_.back();
     }
+    // depth 0 is the top
+    Cell& peek(size_t depth) {
+        vt_assert(data_.size() > depth, "Can't access cell from empty stack!");
+        return data_[data_.size() - 1 - depth];
+    }
     Cell pop() {
         vt_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        auto ret =  data_.back();
+        Cell ret = std::move( data_.back() );
         data_.pop_back();
+        lower();
         return ret;
     }
     void drop() {
         vt_assert(data_.size() > 0, "Can't access cell from empty stack!");
         data_.pop_back();
+        lower();
     }
     void dup() {
-        data_.push_back( top() );
+        vt_assert(data_.size() > 0, "Can't access cell from empty stack!");
+        data_.push_back( data_.back() );
     }
     void dup2() {
         auto a = pop();
@@ -115,41 +134,34 @@ struct Stack {
         }
     }
     void swap() {
-        auto a = pop();
-        auto b = pop();
-        data_.push_back(a);
-        data_.push_back(b);
+        vt_assert(data_.size() > 1, "Can't access cell from empty stack!");
+        std::swap( data_[data_.size() - 1], data_[data_.size() - 2] );
+        low_ = std::min(low_, data_.size() - 2);
     }
     void rot() {
-        auto a = pop();
-        auto b = pop();
-        auto c = pop();
-        data_.push_back(b);
-        data_.push_back(a);
-        data_.push_back(c);
+        vt_assert(data_.size() > 2, "Can't access cell from empty stack!");
+        std::rotate( data_.end() - 3, data_.end() - 2, data_.end() );
+        low_ = std::min(low_, data_.size() - 3);
     }
     void rev(int n) {
         if ( n == -1) {
-            data_.reverse();
+            std::reverse(data_.begin(), data_.end());
+            low_ = 0;
             return;
         }
         if ( n < 0 ) {
            vt_panic("reverse can't support negtive number!");
         }
-
-        std::vector<Cell> temp;
-        for(int i = 0; i < n; n++) {
-            temp.push_back( pop() );
-        }
-        for(int i = 0; i < n; n++) {
-            data_.push_back( temp[i] );
-        }
+        vt_assert((size_t)n <= data_.size(), "Can't access cell from empty stack!");
+        std::reverse(data_.end() - n, data_.end());
+        low_ = std::min(low_, data_.size() - n);
     }
     double pop_number() {
         vt_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        auto ret =  data_.back();
+        double ret = data_.back().as_number();
         data_.pop_back();
-        return ret.as_number();
+        lower();
+        return ret;
     }
     std::vector<double> pop_number_list() {
         size_t s = (size_t) pop_number();
@@ -159,29 +171,34 @@ struct Stack {
         }
         return ret;
     }
-    const std::string pop_string() {
+    // the string is interned, reference is valid after popping
+    const std::string& pop_string() {
         vt_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        auto ret =  data_.back();
+        const std::string& ret = data_.back().as_string();
         data_.pop_back();
-        return ret.as_string();
+        lower();
+        return ret;
     }
     tensor_t pop_tensor() {
         vt_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        auto ret =  data_.back();
+        vt_assert(data_.back().is_tensor(), "Cell type can't convert to vector!");
+        tensor_t ret = std::move( std::get<2>(data_.back().v_) );
         data_.pop_back();
-        return ret.as_tensor();
+        lower();
+        return ret;
     }
     bool pop_boolean() {
         vt_assert(data_.size() > 0, "Can't access cell from empty stack!");
-        auto ret =  data_.back();
+        bool ret = data_.back().as_boolean();
         data_.pop_back();
-        return ret.as_boolean();
+        lower();
+        return ret;
     }
     void push(Cell cell) {
-        data_.push_back(cell);
+        data_.push_back( std::move(cell) );
     }
     void push_number(double n) {
-        data_.push_back( Cell(n) );
+        data_.emplace_back( n );
     }
     void push_number_list(std::vector<double>& list) {
         for (size_t i = 0; i < list.size(); i++) {
@@ -190,80 +207,148 @@ struct Stack {
         push_number( list.size() );
     }
     void push_tensor(tensor_t t) {
-        data_.push_back( Cell(t) );
+        data_.emplace_back( std::move(t) );
     }
     void push_string(const std::string& str) {
-        data_.push_back( Cell(str) );
+        data_.emplace_back( str );
+    }
+    void push_string(const std::string* str) {
+        data_.emplace_back( str );
+    }
+
+    // lowest size since set_low(), recording a replay counts cells consumed by each word
+    size_t low() {
+        return low_;
+    }
+    void set_low(size_t n) {
+        low_ = n;
     }
 
 private:
-    std::list< Cell> data_;
+    void lower() {
+        if ( data_.size() < low_ ) {
+            low_ = data_.size();
+        }
+    }
+
+    std::vector<Cell> data_;
+    size_t low_ = 0;
 
     friend std::ostream& operator<<(std::ostream& os, Stack& stack);
     friend struct BuiltinOperator;
 };
 std::ostream& operator<<(std::ostream& os, Stack& stack);
 
+// names are resolved to fixed slots, linked code reads and writes slots directly
 struct Hash {
-    using Item = std::variant<double, std::string, tensor_t>;
+    using Item = Cell;
     Hash() {
     }
     ~Hash() {}
 
-    Item find(const std::string& name) {
-        if ( map_.find(name) == map_.end() ) {
+    size_t slot(const std::string& name) {
+        auto i = slots_.find(name);
+        if ( i != slots_.end() ) {
+            return i->second;
+        }
+        size_t s = items_.size();
+        slots_[name] = s;
+        items_.emplace_back();
+        valid_.push_back(false);
+        names_.push_back( Cell::intern(name) );
+        return s;
+    }
+
+    const Item& at(size_t s) {
+        if ( !valid_[s] ) {
+            std::cout << "Find: " << *names_[s] << std::endl;
+            vt_panic("Can't find value for name!");
+        }
+        return items_[s];
+    }
+    void set_at(size_t s, Item item) {
+        items_[s] = std::move(item);
+        valid_[s] = true;
+        if ( log_ != nullptr ) {
+            log_->push_back(s);
+            written_.insert(s);
+        }
+    }
+    void drop_at(size_t s) {
+        items_[s] = Item();
+        valid_[s] = false;
+        if ( log_ != nullptr ) {
+            log_->push_back(s);
+            written_.insert(s);
+        }
+    }
+    bool valid(size_t s) {
+        return valid_[s];
+    }
+
+    // "name @" of DAG, reads before writing are inputs of a recording replay
+    const Item& get(size_t s) {
+        if ( inputs_ != nullptr && written_.find(s) == written_.end() ) {
+            inputs_->push_back( {s, at(s)} );
+        }
+        return at(s);
+    }
+
+    const Item& find(const std::string& name) {
+        auto i = slots_.find(name);
+        if ( i == slots_.end() ) {
             std::cout << "Find: " << name << std::endl;
             vt_panic("Can't find value for name!");
         }
-        return map_[name];
+        return get(i->second);
     }
 
     double find_number(const std::string& name) {
-        auto item = find(name);
-        return std::get<0>(item);
+        return find(name).as_number();
     }
 
     std::string find_string(const std::string& name) {
-        auto item = find(name);
-        return std::get<1>(item);
+        return find(name).as_string();
     }
 
     tensor_t find_tensor(const std::string& name) {
-        auto item = find(name);
-        return std::get<2>(item);
+        return find(name).as_tensor();
     }
 
     void set(const std::string& name, Item item) {
-        map_[name] = item;
+        set_at( slot(name), std::move(item) );
     }
 
     void drop(const std::string& name) {
-        map_.erase(name);
+        auto i = slots_.find(name);
+        if ( i != slots_.end() ) {
+            drop_at(i->second);
+        }
     }
 
-    static Cell Item2Cell( Item item ) {
-        if ( item.index() == 0 ) {
-            return Cell( std::get<0>(item) );
-        } else if ( item.index() == 1 ) {
-            return Cell( std::get<1>(item) );
-        }
-        return Cell( std::get<2>(item) );
+    const std::string& name(size_t s) {
+        return *names_[s];
     }
 
-    static Item Cell2Item( Cell& cell ) {
-        Item ret;
-        if ( cell.type_ == Cell::T_Number ) {
-            ret = cell.as_number();
-        } else if ( cell.type_ == Cell::T_String ) {
-            ret = cell.as_string();
-        } else {
-            ret = cell.as_tensor();
+    std::vector<std::string> names() {
+        std::vector<std::string> ret;
+        for (auto& i : slots_) {
+            if ( valid_[i.second] ) {
+                ret.push_back(i.first);
+            }
         }
         return ret;
     }
 
+    std::vector<size_t>* log_ = nullptr;    // written slots, while recording a replay
+    std::vector<std::pair<size_t, Item>>* inputs_ = nullptr;    // slots read before written
+    std::set<size_t> written_;
+
 private:
-    std::map<const std::string, Item> map_;
+    std::map<std::string, size_t> slots_;
+    std::vector<Item> items_;
+    std::vector<bool> valid_;
+    std::vector<const std::string*> names_;
 };
 
 struct WordCode {
@@ -316,16 +401,19 @@ struct WordByte {
         String,
         BuiltinOperator,
         Native,
+        HashGet,        // "name @" with slot of name, the following @ is skipped
+        HashSet,        // "name !" with slot of name, the following ! is skipped
+        Parallel,       // group of independent native calls follows, see Enviroment::schedule
     } type_;
 
-    std::string str_;
+    const std::string* str_;
     size_t idx_;
     double num_;
 
     WordByte(double num) : type_(Number) {
         num_ = num;
     }
-    WordByte(const std::string& str) : type_(String) {
+    WordByte(const std::string* str) : type_(String) {
         str_ = str;
     }
     WordByte(_WordByteType_ t, size_t i): type_(t) {
@@ -357,7 +445,10 @@ using UserBinary = std::vector<WordByte>;
 
 struct DaG {
     DaG() = delete;
-    DaG(Enviroment* env) : env_(env) {}
+    DaG(Enviroment* env) : env_(env) {
+        static std::atomic<size_t> count(0);
+        id_ = count++;
+    }
 
     ~DaG() {
         for (size_t i = 0; i < natives_.size(); i++) {
@@ -371,45 +462,155 @@ struct DaG {
 private:
     // borned from
     const Enviroment* env_;
+    size_t id_;
 
-    // linked and resources
+    // linked and resources, each native has its name & path of inlined user words
     UserBinary binary_;
     std::vector<NativeWord*> natives_;
+    std::vector<std::string> native_names_;
+    std::vector<std::string> native_paths_;
     std::vector<BuiltinOperator*> builtins_;
+    std::vector<std::string> builtin_names_;
+
+    // consecutive native calls with plain arguments, bytes of a unit are [begin, native]
+    struct Unit {
+        size_t begin;
+        size_t native;
+        const std::vector<size_t>* writes;
+    };
+    struct Group {
+        size_t length;          // bytes following the Parallel byte
+        std::vector<Unit> units;
+    };
+    std::vector<Group> groups_;
 
     friend struct Enviroment;
 };
 
+// Opt-in timing of every native call site, a site is one native of a DaG ( user words are inlined,
+// so "layer_forward#3" in path is the fourth layer ). Devices are synced around each call, bytes
+// count every distinct tensor argument once, flops come from costs registered by native words.
+struct PerfCounters;
+struct TeamPool;
+struct Profiler {
+    using CostFunc = double (std::vector<Cell>& args);     // flops of one call
+    struct Cost {
+        size_t args;
+        CostFunc* fn;
+    };
+    struct Site {
+        std::string word;
+        std::string path;
+        std::string shapes;         // arguments of the first call
+        size_t calls = 0;
+        double total = 0.0;         // seconds
+        double flops = 0.0;
+        double bytes = 0.0;
+        std::vector<float> samples; // us, ring of last calls for percentiles
+
+        // hardware counters, only with counters( true )
+        double cycles = 0.0;
+        double instructions = 0.0;
+        double llc_misses = 0.0;
+        double dram_bytes = 0.0;    // uncore memory controllers, Intel only
+    };
+
+    ~Profiler();
+
+    bool enabled_ = false;
+    double peak_gbs_ = 0.0;         // roofline, measured on host or given
+    double peak_gflops_ = 0.0;
+    std::map<std::pair<size_t, size_t>, Site> sites_;
+    std::map<std::string, Cost> costs_;
+    PerfCounters* counters_ = nullptr;
+
+    void reset() {
+        sites_.clear();
+    }
+    bool counters(bool enable);     // perf_event_open, false when kernel refuses
+    void roofline();
+    void dump(std::ostream& os, size_t top);
+};
+
+// Native words of one user word with arguments resolved for one key ( e.g. batch, tokens, full_tokens ).
+// Pure words ( views, shapes, arithmetic, stack shuffling ) are folded into constant arguments,
+// tensors returned by other words stay live in registers, numbers they return are taken as constants.
+struct Replay {
+    struct Arg {
+        Cell value;
+        int reg;                    // -1 for constant, -2 for dropped output
+    };
+    struct Step {
+        NativeWord* word;           // nullptr for writing hash slot
+        const std::string* name;
+        std::vector<Arg> args;      // pushed order, for hash it's the value if valid
+        std::vector<Arg> outs;      // register of each returned tensor, numbers are checked
+        size_t slot;
+        bool valid;
+        size_t group = 0;           // steps of the parallel group starting here
+    };
+    size_t consumed = 0;            // cells of caller's stack
+    size_t regs = 0;
+    std::vector<std::pair<size_t, int>> inputs;     // hash slot loaded into register before steps
+    std::vector<Arg> results;       // left on caller's stack
+    std::vector<Step> steps;
+};
+
+// activation buffers packed into one arena, sizes & offsets are counted in arena's items
+struct ActivationPlan {
+    struct Buffer {
+        std::string parent_;        // alias of another buffer, empty for root
+        size_t size_ = 0;           // items, an alias keeps its own and offset in parent
+        size_t offset_ = 0;
+    };
+    std::map<std::string, Buffer> buffers_;
+    tensor_t arena_;                // null while recording
+    size_t peak_ = 0;
+
+    const std::string& root(const std::string& name) {
+        auto& b = buffers_[name];
+        if ( b.parent_ == "" ) {
+            return name;
+        }
+        return root(b.parent_);
+    }
+};
+
 struct Enviroment {
     Enviroment();
-    ~Enviroment() {
-    }
+    ~Enviroment();
 
     void insert_native_word(const std::string& name, NativeCreator* fn) {
         if ( native_words_.find(name) != native_words_.end() ) {
             vt_panic("Can't insert native word with same name!");
         }
         native_words_[name] = fn;
+        words_digest_ = digest(name, words_digest_);
     }
 
-    DaG* build(const std::string& txt) {
-        DaG* dag = new DaG(this);
-
-        UserWord myCode = compile(txt);
-        linking(*dag, myCode);
-        return dag;
-    }
+    DaG* build(const std::string& txt);
     void run(DaG* dag) {
         vt_assert( dag->env_ == this, "Can't be here!");
+        if ( engine_ != nullptr ) {
+            ComputingContext::bind(engine_);
+        }
+        TraceSpan span("dag.run", "dag");
         run_(dag);
     }
 
-    void execute(const std::string& txt) {
-        DaG dag(this);
+    // linked code of texts without definitions is kept, REPL and init commands aren't compiled again
+    void execute(const std::string& txt);
+
+    // linked DAGs of build are saved into dir and loaded when source & registered words are same,
+    // empty dir disables it
+    void cache(const std::string& dir) {
+        cache_dir_ = dir;
+    }
 
-        UserWord myCode = compile(txt);
-        linking(dag, myCode);
-        run_(&dag);
+    // runs on the engine, otherwise on engine of calling thread. Engines of one process run
+    // concurrently, each with its own enviroment, tensors of hash can be shared between them.
+    void engine(const ComputingContext::Engine* engine) {
+        engine_ = engine;
     }
 
     Stack& stack() {
@@ -418,6 +619,47 @@ struct Enviroment {
     Hash& hash() {
         return hash_;
     }
+    ActivationPlan& plan() {
+        return plan_;
+    }
+    Profiler& profiler() {
+        return profiler_;
+    }
+    void insert_native_cost(const std::string& name, size_t args, Profiler::CostFunc* fn) {
+        profiler_.costs_[name] = {args, fn};
+    }
+    // no side effects, results depend only on arguments, replays fold them away
+    void insert_pure_word(const std::string& name) {
+        pure_words_.insert(name);
+    }
+    void replay(const std::string& word, const std::string& key);
+
+    // arguments at positions of writes are written, others are read, results are values pushed back.
+    // Only words pushing nothing are scheduled, the planner uses all of them.
+    void insert_native_effect(const std::string& name, size_t args, const std::vector<size_t>& writes, size_t results = 0) {
+        effects_[name] = {args, writes, results};
+        std::stringstream ss;
+        ss << name << " " << args << " " << results;
+        for (auto w : writes) {
+            ss << " " << w;
+        }
+        words_digest_ = digest(ss.str(), words_digest_);
+    }
+    void concurrency(int teams);
+    void replay_clear() {
+        replays_.clear();
+    }
+    size_t build_plan(const std::string& word, size_t align);
+
+    // compiled user words as text, snapshots use it to check they are made by same DAG
+    std::string dump_words();
+
+    // fusing adjacent native words on same tensors when building, dump prints binary before & after
+    void fusion(bool enable, bool dump) {
+        fusion_ = enable;
+        fusion_dump_ = dump;
+    }
+    void dump_binary(DaG* dag, std::ostream& os);
 
 private:
     void run_(DaG* dag) {
@@ -437,12 +679,36 @@ private:
                     stack_.push_string( byte.str_ );
                     break;
 
+                case WordByte::HashGet:
+                    stack_.push( hash_.get( byte.idx_ ) );
+                    steps = 2;
+                    break;
+
+                case WordByte::HashSet:
+                    hash_.set_at( byte.idx_, stack_.pop() );
+                    steps = 2;
+                    break;
+
                 case WordByte::BuiltinOperator:
                     steps = builtins_[ byte.idx_ ]->run( this );
                     break;
 
                 case WordByte::Native:
-                    natives_[ byte.idx_ ]->run( stack_ );
+                    if ( recording_ != nullptr ) {
+                        record_native(dag, byte.idx_);
+                    } else if ( profiler_.enabled_ ) {
+                        profile_native(dag, byte.idx_);
+                    } else if ( TraceContext::enabled ) {
+                        // without sync, spans of device words are launching time
+                        TraceSpan span(dag->native_names_[byte.idx_].c_str(), "op");
+                        natives_[ byte.idx_ ]->run( stack_ );
+                    } else {
+                        natives_[ byte.idx_ ]->run( stack_ );
+                    }
+                    break;
+
+                case WordByte::Parallel:
+                    steps = run_group(dag, byte.idx_);
                     break;
 
                 default:
@@ -469,17 +735,73 @@ private:
         return user_words_[name];
     }
     UserWord compile(const std::string& txt);
-    void linking(DaG& dag, UserWord& word);
+    void linking(DaG& dag, UserWord& word, const std::string& path = "");
+    void profile_native(DaG* dag, size_t idx);
+    void record_native(DaG* dag, size_t idx);
+    void record_hash();
+    Replay::Arg record_arg(const Cell& cell);
+    void fuse(DaG& dag);
+    void schedule(DaG& dag);
+    bool load_cached(DaG& dag, uint64_t key);
+    void save_cached(DaG& dag, uint64_t key);
+    static uint64_t digest(const std::string& s, uint64_t h = 14695981039346656037ull) {
+        for (auto c : s) {
+            h = (h ^ (uint8_t)c) * 1099511628211ull;
+        }
+        return h;
+    }
+    int run_group(DaG* dag, size_t idx);
+
+    // unit of a parallel group, arguments are evaluated by the caller
+    struct Task {
+        NativeWord* word;
+        const std::string* name;
+        std::vector<Cell> args;
+        const std::vector<size_t>* writes;
+    };
+    void run_tasks(std::vector<Task>& tasks);
+
+    using PlanRefs = std::map<std::string, std::vector<std::pair<size_t, bool>>>;     // uses, true overwrites
+    void trace_plan(UserWord& word, size_t& pos, PlanRefs& refs);
 
     void load_base_words();
 private:
     // compiled
     std::map<std::string, UserWord> user_words_;
     std::map<std::string, NativeCreator*> native_words_;
+    uint64_t words_digest_ = 14695981039346656037ull;      // registered & defined words in order
+    std::vector<std::string> defined_;                      // words defined by last compile
+    std::string cache_dir_;
+    std::unordered_map<std::string, DaG*> executed_;
 
     // runtime
     Stack stack_;
     Hash hash_;
+    ActivationPlan plan_;
+
+    bool fusion_ = true;
+    bool fusion_dump_ = false;
+    Profiler profiler_;
+
+    std::set<std::string> pure_words_;
+    std::map<std::string, DaG*> replay_dags_;
+    std::map<std::pair<std::string, std::string>, Replay> replays_;
+    Replay* recording_ = nullptr;
+    std::vector<size_t> recording_slots_;
+    std::vector<std::pair<size_t, Cell>> recording_inputs_;
+    std::map<const TensorType*, std::pair<int, tensor_t>> recording_regs_;
+    size_t recording_units_ = 0;        // natives left of the recording parallel group
+    size_t recording_group_ = 0;        // its first step
+
+    struct Effect {
+        size_t args;
+        std::vector<size_t> writes;
+        size_t results;
+    };
+    std::map<std::string, Effect> effects_;
+    int teams_ = 1;
+    TeamPool* pool_ = nullptr;
+    const ComputingContext::Engine* engine_ = nullptr;
 };
 
 #define NWORD_CREATOR_DEFINE_LR(CLS)         \
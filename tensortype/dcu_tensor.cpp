@@ -338,6 +338,26 @@ ComputingReturn DCUTensor<DT>::op_causal_mask(tensor_t self, tensor_t out) {
 
 
 
+template <DataType DT>
+ComputingReturn DCUTensor<DT>::op_view_rebind(tensor_t self, tensor_t parent, size_t offset, const std::vector<size_t>& newShape) {
+    if ( owner_ ) {
+        return OP_INPUT_ERROR;
+    }
+    if ( DT == DataType::Float ) {
+        mem_ = (char *)parent->device_data() + offset * sizeof(float);
+        return OP_OK;
+    }
+    if ( DT == DataType::Int ) {
+        mem_ = (char *)parent->device_data() + offset * sizeof(int);
+        return OP_OK;
+    }
+    if ( DT == DataType::FP16 ) {
+        mem_ = (char *)parent->device_data() + offset * sizeof(device_fp16_t);
+        return OP_OK;
+    }
+    return OP_TODO_ERROR;
+}
+
 template<DataType DT>
 std::variant<ComputingReturn, tensor_t> DCUTensor<DT>::op_view(tensor_t self, size_t offset, const std::vector<size_t>& newShape_) {
     ShapeType newShape(newShape_);
@@ -53,6 +53,7 @@ public:
     ComputingReturn op_rotary_cache(tensor_t self, float base) override;
 
     std::variant<ComputingReturn, tensor_t> op_view(tensor_t self, size_t offset, const std::vector<size_t>& newShape) override;
+    ComputingReturn op_view_rebind(tensor_t self, tensor_t parent, size_t offset, const std::vector<size_t>& newShape) override;
     std::variant<ComputingReturn, tensor_t> op_view_as(tensor_t self, size_t offset, const std::vector<size_t>& newShape, const char* dtype) override;
     ComputingReturn op_reshape(tensor_t self, size_t offset, const std::vector<size_t>& newShape) override;
     ComputingReturn op_quantize(tensor_t self, tensor_t out) override;
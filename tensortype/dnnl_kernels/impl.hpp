@@ -6,6 +6,23 @@
 
 namespace vt { namespace dnnl_kernels {
 
+// loops of kernels, oneDNN built with threadpool runtime has no OpenMP team so they run on its pool
+template <typename F>
+void parallel_for(size_t n, F body) {
+#ifdef _DNNL_THREADPOOL_
+    ComputingContext::pool_for(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            body(i);
+        }
+    });
+#else
+#pragma omp parallel for
+    for (size_t i = 0; i < n; i++) {
+        body(i);
+    }
+#endif
+}
+
 template<typename T>
 void fill_causal_mask(int* m, T* o, T minv, int full_tokens, int nt_end) {
     for ( int i = 0; i < full_tokens; i++) {
@@ -19,28 +36,29 @@ void fill_causal_mask(int* m, T* o, T minv, int full_tokens, int nt_end) {
     }
 }
 
-void binary_float(tensor_t a, tensor_t b, tensor_t c, dnnl::algorithm op ) {
-    auto tag = dnnl::memory::format_tag::abcd;
-    if ( a->shape().dim() == 3) {
-        tag = dnnl::memory::format_tag::abc;
-    }
-    if ( a->shape().dim() == 2) {
-        tag = dnnl::memory::format_tag::ab;
-    }
-    if ( a->shape().dim() == 1) {
-        tag = dnnl::memory::format_tag::a;
+// dense shapes get same desc with plain format tags, strided views are read & written in place
+dnnl::memory::desc strided_desc(const ShapeType& shape, dnnl::memory::data_type dt) {
+    auto st = shape.strides();
+    dnnl::memory::dims dims;
+    dnnl::memory::dims strides;
+    for (size_t i = 0; i < shape.dim(); i++) {
+        dims.push_back( shape[i] );
+        strides.push_back( st[i] );
     }
+    return dnnl::memory::desc(dims, dt, strides);
+}
 
-    auto amem_desc = a->dnnl_float()->build_memory_desc( a->shape().vec(),  tag);
-    auto bmem_desc = b->dnnl_float()->build_memory_desc( b->shape().vec(),  tag);
-    auto cmem_desc = c->dnnl_float()->build_memory_desc( c->shape().vec(),  tag);
+void binary_float(tensor_t a, tensor_t b, tensor_t c, dnnl::algorithm op ) {
+    auto amem_desc = strided_desc( a->shape(), dnnl::memory::data_type::f32);
+    auto bmem_desc = strided_desc( b->shape(), dnnl::memory::data_type::f32);
+    auto cmem_desc = strided_desc( c->shape(), dnnl::memory::data_type::f32);
 
     auto amem = a->dnnl_float()->build_memory(amem_desc);
     auto bmem = b->dnnl_float()->build_memory(bmem_desc);
     auto cmem = c->dnnl_float()->build_memory(cmem_desc);
 
     auto eng = *ComputingContext::dnnl_engine;
-    auto stream = *ComputingContext::dnnl_stream;
+    auto stream = ComputingContext::dnnl_current();
 
 #ifdef _DNNL_GPU_
     if ( a->dnnl_float()->is_gpu() ) {
@@ -61,27 +79,16 @@ void binary_float(tensor_t a, tensor_t b, tensor_t c, dnnl::algorithm op ) {
 }
 
 void binary_fp16(tensor_t a, tensor_t b, tensor_t c, dnnl::algorithm op ) {
-    auto tag = dnnl::memory::format_tag::abcd;
-    if ( a->shape().dim() == 3) {
-        tag = dnnl::memory::format_tag::abc;
-    }
-    if ( a->shape().dim() == 2) {
-        tag = dnnl::memory::format_tag::ab;
-    }
-    if ( a->shape().dim() == 1) {
-        tag = dnnl::memory::format_tag::a;
-    }
-
-    auto amem_desc = a->dnnl_fp16()->build_memory_desc( a->shape().vec(),  tag);
-    auto bmem_desc = b->dnnl_fp16()->build_memory_desc( b->shape().vec(),  tag);
-    auto cmem_desc = c->dnnl_fp16()->build_memory_desc( c->shape().vec(),  tag);
+    auto amem_desc = strided_desc( a->shape(), dnnl::memory::data_type::f16);
+    auto bmem_desc = strided_desc( b->shape(), dnnl::memory::data_type::f16);
+    auto cmem_desc = strided_desc( c->shape(), dnnl::memory::data_type::f16);
 
     auto amem = a->dnnl_fp16()->build_memory(amem_desc);
     auto bmem = b->dnnl_fp16()->build_memory(bmem_desc);
     auto cmem = c->dnnl_fp16()->build_memory(cmem_desc);
 
     auto eng = *ComputingContext::dnnl_engine;
-    auto stream = *ComputingContext::dnnl_stream;
+    auto stream = ComputingContext::dnnl_current();
 
 #ifdef _DNNL_GPU_
     if ( a->dnnl_fp16()->is_gpu() ) {
@@ -124,7 +131,7 @@ void eltwise(T* in, T* out,  size_t items, ::dnnl::algorithm op, float alpha, fl
     auto eltwise_pd = dnnl::eltwise_forward::primitive_desc(*ComputingContext::dnnl_engine,
         dnnl::prop_kind::forward_inference, op, src_md, dst_md, alpha, beta);
     auto eltwise_prim = dnnl::eltwise_forward(eltwise_pd);
-    eltwise_prim.execute(*ComputingContext::dnnl_stream, eltwise_args);
+    eltwise_prim.execute(ComputingContext::dnnl_current(), eltwise_args);
 }
 
 template<typename T>
@@ -169,7 +176,49 @@ void linear(T* src, T* weight, T* bias, T* dst, size_t batch, size_t outFeature,
             *ComputingContext::dnnl_engine, src_md, w_md, b_md, dst_md);
     }
     auto matmul_prim = dnnl::matmul(matmul_pd);
-    matmul_prim.execute(*ComputingContext::dnnl_stream, matmul_args);
+    matmul_prim.execute(ComputingContext::dnnl_current(), matmul_args);
+}
+
+// rows of weight are placed on NUMA nodes as shards, every node computes its columns of dst with its
+// own cpus, columns are disjoint so nothing is reduced after the nodes are joined. Node k takes
+// rows [rows[k], rows[k+1])
+template<typename T>
+void linear_sharded(T* src, T* weight, T* bias, T* dst, size_t batch, size_t outFeature, size_t inFeature, const std::vector<size_t>& rows) {
+    const auto src_md = src->build_memory_desc( {1, batch, inFeature},  dnnl::memory::format_tag::abc);
+    const auto dt = src_md.get_data_type();
+    const size_t item = src->build_memory_desc( {1}, dnnl::memory::format_tag::a).get_size();
+
+    // kernels queued before are seen by the nodes
+    ComputingContext::dnnl_current().wait();
+    ComputingContext::numa_run([&](int k) {
+        size_t o0 = rows[k];
+        size_t o1 = rows[k + 1];
+        if ( o1 == o0 ) {
+            return;
+        }
+        dnnl::memory::dim n = o1 - o0;
+        auto eng = *ComputingContext::dnnl_engine;
+
+        auto w_md = weight->build_memory_desc( {1, inFeature, (size_t)n}, dnnl::memory::format_tag::acb);
+        dnnl::memory::desc dst_md({1, (dnnl::memory::dim)batch, n}, dt,
+                                  {(dnnl::memory::dim)(batch * outFeature), (dnnl::memory::dim)outFeature, 1});
+
+        std::unordered_map<int, dnnl::memory> matmul_args;
+        matmul_args[DNNL_ARG_SRC] = dnnl::memory(src_md, eng, src->data());
+        matmul_args[DNNL_ARG_WEIGHTS] = dnnl::memory(w_md, eng, (char *)weight->data() + o0 * inFeature * item);
+        matmul_args[DNNL_ARG_DST] = dnnl::memory(dst_md, eng, (char *)dst->data() + o0 * item);
+
+        dnnl::matmul::primitive_desc matmul_pd;
+        if ( bias == nullptr ) {
+            matmul_pd = dnnl::matmul::primitive_desc(eng, src_md, w_md, dst_md);
+        } else {
+            auto b_md = bias->build_memory_desc( {1, 1, (size_t)n}, dnnl::memory::format_tag::abc);
+            matmul_args[DNNL_ARG_BIAS] = dnnl::memory(b_md, eng, (char *)bias->data() + o0 * item);
+            matmul_pd = dnnl::matmul::primitive_desc(eng, src_md, w_md, b_md, dst_md);
+        }
+        auto matmul_prim = dnnl::matmul(matmul_pd);
+        matmul_prim.execute(ComputingContext::dnnl_current(), matmul_args);
+    });
 }
 
 template<typename T>
@@ -182,7 +231,7 @@ void simple_gemm(T* src, T* w, T* dst, dnnl::memory::desc src_md, dnnl::memory::
     matmul_args[DNNL_ARG_WEIGHTS] = dnnl::memory(w_md, *ComputingContext::dnnl_engine, w);
     matmul_args[DNNL_ARG_DST] = dnnl::memory(dst_md, *ComputingContext::dnnl_engine, dst);
 
-    matmul_prim.execute(*ComputingContext::dnnl_stream, matmul_args);
+    matmul_prim.execute(ComputingContext::dnnl_current(), matmul_args);
 }
 
 #ifdef _DNNL_GPU_
@@ -228,7 +277,7 @@ void layernrom(T* x, T* scale, T* bias, T* y, size_t batch_size, size_t hidden_d
             dnnl::prop_kind::forward_inference, src_md, dst_md, eps,
             dnnl::normalization_flags::use_scale | dnnl::normalization_flags::use_shift);
     auto lnorm_prim = dnnl::layer_normalization_forward(lnorm_pd);
-    lnorm_prim.execute(*ComputingContext::dnnl_stream, lnorm_args);
+    lnorm_prim.execute(ComputingContext::dnnl_current(), lnorm_args);
 }
 
 template <typename T, DataType DT>
@@ -237,8 +286,7 @@ void rmsnorm(T* x, T* scale,  T* y, size_t batch_size, size_t hidden_dim, float
         vt_panic("DNNL rmsnor only support float and fp16!");
     }
 
-#pragma omp parallel for
-    for (size_t i = 0; i < batch_size; i++) {
+    parallel_for(batch_size, [&](size_t i) {
         float rms = 0.0;
         if ( DT == DataType::Float) {
             for(size_t j = 0; j < hidden_dim; j++) {
@@ -268,10 +316,53 @@ void rmsnorm(T* x, T* scale,  T* y, size_t batch_size, size_t hidden_dim, float
                 y[i * hidden_dim + j] = fp32_to_fp16( v * rms * fp16_to_fp32(scale[j]) );
             }
         }
-    }
+    });
 }
 
 
+// sum = a + b and y = rmsnorm(sum) in one pass of rows, sum is rounded as the separated add
+template <typename T, DataType DT>
+void add_rmsnorm(T* a, T* b, T* sum, T* scale, T* y, size_t batch_size, size_t hidden_dim, float eps) {
+    if ( DT != DataType::Float &&  DT != DataType::FP16) {
+        vt_panic("DNNL rmsnor only support float and fp16!");
+    }
+
+    parallel_for(batch_size, [&](size_t i) {
+        T* s = sum + i * hidden_dim;
+        float rms = 0.0;
+        if ( DT == DataType::Float) {
+            for(size_t j = 0; j < hidden_dim; j++) {
+                float v = a[i * hidden_dim + j] + b[i * hidden_dim + j];
+                s[j] = v;
+                rms = rms + v * v;
+            }
+        }
+        if ( DT == DataType::FP16) {
+            for(size_t j = 0; j < hidden_dim; j++) {
+                T h = fp32_to_fp16( fp16_to_fp32(a[i * hidden_dim + j]) + fp16_to_fp32(b[i * hidden_dim + j]) );
+                s[j] = h;
+                float v = fp16_to_fp32(h);
+                rms = rms + v * v;
+            }
+        }
+
+        rms = rms / (float)hidden_dim;
+        rms = 1.0 / sqrt(rms + eps);
+
+        if ( DT == DataType::Float) {
+            for(size_t j = 0; j < hidden_dim; j++) {
+                y[i * hidden_dim + j] = s[j] * rms * scale[j];
+            }
+        }
+        if ( DT == DataType::FP16) {
+            for(size_t j = 0; j < hidden_dim; j++) {
+                float v = fp16_to_fp32(s[j]);
+                y[i * hidden_dim + j] = fp32_to_fp16( v * rms * fp16_to_fp32(scale[j]) );
+            }
+        }
+    });
+}
+
 template <typename T>
 void rotary_embed(T* in, float* cos_sin, int* pos, T* out, size_t batch, size_t  heads, size_t tokens, size_t dims);
 
@@ -279,8 +370,7 @@ template <>
 void rotary_embed<float>(float* in, float* cos_sin, int* pos, float* out, size_t batch, size_t  heads, size_t tokens, size_t dims) {
     for (size_t b = 0; b < batch; b++) {
         int p = pos[b];
-        #pragma omp parallel for
-        for (size_t t = 0; t < tokens; t++) {
+        parallel_for(tokens, [&](size_t t) {
             float* tab = cos_sin + (t + p) * dims * 2;
             for (size_t h = 0; h < heads; h++) {
                 size_t offset = b * heads * tokens * dims + t * heads * dims + h * dims;
@@ -292,7 +382,7 @@ void rotary_embed<float>(float* in, float* cos_sin, int* pos, float* out, size_t
                     out[ii+offset] = (tab[ii*2] * y + tab[ii*2+1] * x);
                 }
             }
-        }
+        });
     }
 }
 
@@ -300,8 +390,7 @@ template <>
 void rotary_embed<local_fp16_t>(local_fp16_t* in, float* cos_sin, int* pos, local_fp16_t* out, size_t batch, size_t  heads, size_t tokens, size_t dims) {
     for (size_t b = 0; b < batch; b++) {
         int p = pos[b];
-        #pragma omp parallel for
-        for (size_t t = 0; t < tokens; t++) {
+        parallel_for(tokens, [&](size_t t) {
             float* tab = cos_sin + (t + p) * dims * 2;
             for (size_t h = 0; h < heads; h++) {
                 size_t offset = b * heads * tokens * dims + t * heads * dims + h * dims;
@@ -313,7 +402,7 @@ void rotary_embed<local_fp16_t>(local_fp16_t* in, float* cos_sin, int* pos, loca
                     out[ii+offset] = fp32_to_fp16(tab[ii*2] * y + tab[ii*2+1] * x);
                 }
             }
-        }
+        });
     }
 }
 
@@ -321,15 +410,14 @@ template <typename T>
 void transpose_0213(T* in, T* out, size_t batch, size_t heads, size_t tokens, size_t dims) {
     size_t items = batch * heads * tokens * dims;
 
-    #pragma omp parallel for
-    for ( size_t i = 0; i < items; i++) {
+    parallel_for(items, [&](size_t i) {
         size_t d = i % dims;
         size_t t = (i / dims) % tokens;
         size_t h = (i / (dims*tokens)) % heads;
         size_t b = i / (dims*tokens*heads);
         size_t target = b * (dims*tokens*heads) + t * heads * dims + h * dims + d;
         out[i] = in[target];
-    }
+    });
 }
 
 template<typename T>
@@ -363,7 +451,33 @@ void query_key(T* query, T* key, T* qk, size_t batch, size_t newTokens, size_t f
     matmul_pd = dnnl::matmul::primitive_desc(*ComputingContext::dnnl_engine, q_md, k_md, qk_md, matmul_attr);
 
     auto matmul_prim = dnnl::matmul(matmul_pd);
-    matmul_prim.execute(*ComputingContext::dnnl_stream, matmul_args);
+    matmul_prim.execute(ComputingContext::dnnl_current(), matmul_args);
+}
+
+// query [B, H, Tn, D] & key [B, H, Tf, D] may be 0213 views of [B, T, H, D], so no transposing copies
+template<typename T>
+void query_key_strided(tensor_t query, tensor_t key, tensor_t qk, T* q, T* k, T* o, dnnl::memory::data_type dt) {
+    auto ks = key->shape();
+    auto kst = ks.strides();
+    size_t hidden = ks[3];
+    auto q_md = strided_desc( query->shape(), dt);
+    auto k_md = dnnl::memory::desc( {(dnnl::memory::dim)ks[0], (dnnl::memory::dim)ks[1], (dnnl::memory::dim)ks[3], (dnnl::memory::dim)ks[2]}, dt, {(dnnl::memory::dim)kst[0], (dnnl::memory::dim)kst[1], (dnnl::memory::dim)kst[3], (dnnl::memory::dim)kst[2]});
+    auto qk_md = strided_desc( qk->shape(), dt);
+
+    std::unordered_map<int, dnnl::memory> matmul_args;
+    matmul_args[DNNL_ARG_SRC] = q->build_memory(q_md);
+    matmul_args[DNNL_ARG_WEIGHTS] = k->build_memory(k_md);
+    matmul_args[DNNL_ARG_DST] = o->build_memory(qk_md);
+
+    dnnl::post_ops matmul_ops;
+    matmul_ops.append_eltwise(dnnl::algorithm::eltwise_linear, 1.0/sqrt(hidden), 0.0);
+    dnnl::primitive_attr matmul_attr;
+    matmul_attr.set_post_ops(matmul_ops);
+
+    dnnl::matmul::primitive_desc matmul_pd;
+    matmul_pd = dnnl::matmul::primitive_desc(*ComputingContext::dnnl_engine, q_md, k_md, qk_md, matmul_attr);
+    auto matmul_prim = dnnl::matmul(matmul_pd);
+    matmul_prim.execute(ComputingContext::dnnl_current(), matmul_args);
 }
 
 template<typename T>
@@ -391,7 +505,7 @@ void softmax(T* src, T* dst, size_t batch, size_t hidden ) {
             dnnl::prop_kind::forward_inference, dnnl::algorithm::softmax_accurate, src_md,
             dst_md, axis);
     auto softmax_prim = dnnl::softmax_forward(softmax_pd);
-    softmax_prim.execute(*ComputingContext::dnnl_stream, softmax_args);
+    softmax_prim.execute(ComputingContext::dnnl_current(), softmax_args);
 }
 
 
@@ -419,7 +533,54 @@ void attn(T* xll, T* value, T* out, size_t batch, size_t newTokens, size_t fullT
     dnnl::matmul::primitive_desc matmul_pd;
     matmul_pd = dnnl::matmul::primitive_desc(*ComputingContext::dnnl_engine, xll_md, v_md, o_md);
     auto matmul_prim = dnnl::matmul(matmul_pd);
-    matmul_prim.execute(*ComputingContext::dnnl_stream, matmul_args);
+    matmul_prim.execute(ComputingContext::dnnl_current(), matmul_args);
+}
+
+// value [B, H, Tf, D] & out [B, H, Tn, D] may be 0213 views, out written back to [B, Tn, H, D] directly
+template<typename T>
+void attn_strided(tensor_t xll, tensor_t value, tensor_t out, T* x, T* v, T* o, dnnl::memory::data_type dt) {
+    auto xll_md = strided_desc( xll->shape(), dt);
+    auto v_md = strided_desc( value->shape(), dt);
+    auto o_md = strided_desc( out->shape(), dt);
+
+    std::unordered_map<int, dnnl::memory> matmul_args;
+    matmul_args[DNNL_ARG_SRC] = x->build_memory(xll_md);
+    matmul_args[DNNL_ARG_WEIGHTS] = v->build_memory(v_md);
+    matmul_args[DNNL_ARG_DST] = o->build_memory(o_md);
+
+    dnnl::matmul::primitive_desc matmul_pd;
+    matmul_pd = dnnl::matmul::primitive_desc(*ComputingContext::dnnl_engine, xll_md, v_md, o_md);
+    auto matmul_prim = dnnl::matmul(matmul_pd);
+    matmul_prim.execute(ComputingContext::dnnl_current(), matmul_args);
+}
+
+template <typename T>
+void attn_score(T* xll, float* score, size_t batch, size_t heads, size_t newTokens, size_t fullTokens);
+
+template <>
+void attn_score<float>(float* xll, float* score, size_t batch, size_t heads, size_t newTokens, size_t fullTokens) {
+    parallel_for(batch * fullTokens, [&](size_t i) {
+        size_t b = i / fullTokens;
+        size_t f = i % fullTokens;
+        float sum = 0.0;
+        for ( size_t r = 0; r < heads * newTokens; r++) {
+            sum += xll[ (b * heads * newTokens + r) * fullTokens + f];
+        }
+        score[i] += sum;
+    });
+}
+
+template <>
+void attn_score<local_fp16_t>(local_fp16_t* xll, float* score, size_t batch, size_t heads, size_t newTokens, size_t fullTokens) {
+    parallel_for(batch * fullTokens, [&](size_t i) {
+        size_t b = i / fullTokens;
+        size_t f = i % fullTokens;
+        float sum = 0.0;
+        for ( size_t r = 0; r < heads * newTokens; r++) {
+            sum += fp16_to_fp32( xll[ (b * heads * newTokens + r) * fullTokens + f] );
+        }
+        score[i] += sum;
+    });
 }
 
 template <typename T>
@@ -427,21 +588,19 @@ void gelu(T* in, T* out, size_t items);
 
 template <>
 void gelu<float>(float* src, float* target, size_t items) {
-    #pragma omp parallel for
-    for ( size_t i = 0; i < items; i++) {
+    parallel_for(items, [&](size_t i) {
         float value = src[i];
         target[i] = value * (0.5F + 0.5F * tanhf(value * (0.79788456F + 0.03567741F * value * value)));
         //target[i] = value * normcdf(value);
-    }
+    });
 }
 
 template <>
 void gelu<local_fp16_t>(local_fp16_t* src, local_fp16_t* target, size_t items) {
-    #pragma omp parallel for
-    for ( size_t i = 0; i < items; i++) {
+    parallel_for(items, [&](size_t i) {
         float value = fp16_to_fp32(src[i]);
         target[i] = fp32_to_fp16(value * (0.5F + 0.5F * tanhf(value * (0.79788456F + 0.03567741F * value * value))));
-    }
+    });
 }
 
 template <typename T>
@@ -449,22 +608,20 @@ void silu_product(T* a, T* b,  T* out, size_t items);
 
 template <>
 void silu_product<float>(float* in_act, float* in,  float* out, size_t items) {
-    #pragma omp parallel for
-    for ( size_t i = 0; i < items; i++) {
+    parallel_for(items, [&](size_t i) {
         float act = in_act[i];
         float in_ = in[i];
         out[i] = act / (1.f + expf(-act)) * in_;
-    }
+    });
 }
 
 template <>
 void silu_product<local_fp16_t>(local_fp16_t* in_act, local_fp16_t* in,  local_fp16_t* out, size_t items) {
-    #pragma omp parallel for
-    for ( size_t i = 0; i < items; i++) {
+    parallel_for(items, [&](size_t i) {
         float act = fp16_to_fp32( in_act[i] );
         float in_ = fp16_to_fp32( in[i] );
         out[i] = fp32_to_fp16( act / (1.f + expf(-act)) * in_ );
-    }
+    });
 }
 
 template <typename T>
@@ -472,8 +629,7 @@ void easy_top1(T* logits, int* out, size_t batch, size_t vocab_size);
 
 template <>
 void easy_top1<float>(float* logits, int* out, size_t batch, size_t vocab_size) {
-    #pragma omp parallel for
-    for (size_t b = 0; b < batch; b++) {
+    parallel_for(batch, [&](size_t b) {
         float* src = logits + b * vocab_size;
 
         float max_v = std::numeric_limits<float>::min();
@@ -485,13 +641,12 @@ void easy_top1<float>(float* logits, int* out, size_t batch, size_t vocab_size)
             }
         }
         out[b] = max_i;
-    }
+    });
 }
 
 template <>
 void easy_top1<local_fp16_t>(local_fp16_t* logits, int* out, size_t batch, size_t vocab_size) {
-    #pragma omp parallel for
-    for (size_t b = 0; b < batch; b++) {
+    parallel_for(batch, [&](size_t b) {
         local_fp16_t* src = logits + b * vocab_size;
 
         float max_v = std::numeric_limits<float>::min();
@@ -504,7 +659,7 @@ void easy_top1<local_fp16_t>(local_fp16_t* logits, int* out, size_t batch, size_
             }
         }
         out[b] = max_i;
-    }
+    });
 }
 
 
@@ -554,8 +709,7 @@ void easy_top3(T* logits, int* out, size_t batch, size_t vocab_size, float temp,
 template <>
 void easy_top3<float>(float* logits, int* out, size_t batch, size_t vocab_size, float temp, float randx) {
 
-    #pragma omp parallel for
-    for (size_t b = 0; b < batch; b++) {
+    parallel_for(batch, [&](size_t b) {
         float* src = logits + b * vocab_size;
 
         std::priority_queue<TopItem, std::vector<TopItem>, Compare> topk;
@@ -572,15 +726,14 @@ void easy_top3<float>(float* logits, int* out, size_t batch, size_t vocab_size,
         }
 
         out[b] = do_sampling(topk, temp, randx);
-    }
+    });
 
 }
 
 template <>
 void easy_top3<local_fp16_t>(local_fp16_t* logits, int* out, size_t batch, size_t vocab_size, float temp, float randx) {
 
-    #pragma omp parallel for
-    for (size_t b = 0; b < batch; b++) {
+    parallel_for(batch, [&](size_t b) {
         local_fp16_t* src = logits + b * vocab_size;
 
         std::priority_queue<TopItem, std::vector<TopItem>, Compare> topk;
@@ -597,9 +750,49 @@ void easy_top3<local_fp16_t>(local_fp16_t* logits, int* out, size_t batch, size_
         }
 
         out[b] = do_sampling(topk, temp, randx);
-    }
+    });
 }
 
+inline float logit_value(float v) {
+    return v;
+}
+
+inline float logit_value(local_fp16_t v) {
+    return fp16_to_fp32(v);
+}
+
+// top k tokens with log-softmax probability, sorted from best
+template <typename T>
+void easy_topk(T* logits, int* out, float* logprob, size_t batch, size_t vocab_size, size_t k, float temp) {
+    parallel_for(batch, [&](size_t b) {
+        T* src = logits + b * vocab_size;
+
+        float max_v = logit_value(src[0]);
+        for (size_t i = 1; i < vocab_size; i++) {
+            max_v = std::max(max_v, logit_value(src[i]));
+        }
+
+        float sum = 0.0;
+        std::priority_queue<TopItem, std::vector<TopItem>, Compare> topk;
+        for (size_t i = 0; i < vocab_size; i++) {
+            float v = logit_value(src[i]);
+            sum += expf( (v - max_v) / temp );
+            if ( topk.size() < k ) {
+                topk.push( {(int)i, v} );
+            } else if ( v > topk.top().v ) {
+                topk.pop();
+                topk.push( {(int)i, v} );
+            }
+        }
+
+        float lsum = logf(sum);
+        for (int i = (int)k - 1; i >= 0; i--) {
+            out[b * k + i] = topk.top().i;
+            logprob[b * k + i] = (topk.top().v - max_v) / temp - lsum;
+            topk.pop();
+        }
+    });
+}
 
 }}
 #endif
@@ -12,8 +12,22 @@ namespace vt {
 using tag = dnnl::memory::format_tag;
 using dt = dnnl::memory::data_type;
 
+// kernels read operands as dense blocks, only binary ops, querykey & attn take strided views
+static bool dense(std::initializer_list<tensor_t> tensors) {
+    for (auto& t : tensors) {
+        if ( t != nullptr && !t->shape().is_contiguous() ) {
+            return false;
+        }
+    }
+    return true;
+}
+
 template <DataType _DTYPE_>
 DNNLTensor<_DTYPE_>::~DNNLTensor() {
+    if ( mapped_ ) {
+        MemoryContext::unmap_file(mem_, size_);
+        return;
+    }
     if ( owner_ ) {
 #ifdef _DNNL_GPU_
         if ( gpu_ == true) {
@@ -30,7 +44,7 @@ DNNLTensor<_DTYPE_>::~DNNLTensor() {
 }
 
 template <DataType _DTYPE_>
-DNNLTensor<_DTYPE_>::DNNLTensor(const ShapeType& shape, bool isGPU) : owner_(true), gpu_(isGPU) {
+DNNLTensor<_DTYPE_>::DNNLTensor(const ShapeType& shape, bool isGPU) : owner_(true), gpu_(isGPU), mapped_(false) {
 
     if ( _DTYPE_ == DataType::Float ) {
         size_ = shape.numel() * sizeof(float);
@@ -71,7 +85,7 @@ DNNLTensor<_DTYPE_>::DNNLTensor(const ShapeType& shape, bool isGPU) : owner_(tru
 }
 
 template <DataType _DTYPE_>
-DNNLTensor<_DTYPE_>::DNNLTensor(const ShapeType& shape,  void *mem, bool isGPU) : owner_(false), gpu_(isGPU) , mem_(mem) {
+DNNLTensor<_DTYPE_>::DNNLTensor(const ShapeType& shape,  void *mem, bool isGPU) : owner_(false), gpu_(isGPU), mapped_(false), mem_(mem) {
     if ( _DTYPE_ == DataType::Float ) {
         size_ = shape.numel() * sizeof(float);
     } else if ( _DTYPE_ == DataType::Int ) {
@@ -395,6 +409,51 @@ ComputingReturn DNNLTensor<_DTYPE_>::io_load(tensor_t self, const char* fileName
     return OP_OK;
 }
 
+// binding storage to the file, TensorType reads into tensors having views instead
+template <DataType _DTYPE_>
+ComputingReturn DNNLTensor<_DTYPE_>::io_mmap(tensor_t self, const char* fileName, bool populate) {
+    // page cache ignores NUMA policy, placed blocks are read into
+    if ( !owner_ || gpu_ || MemoryContext::numa_shards(mem_) > 0 ) {
+        return io_load(self, fileName);
+    }
+    void* m = MemoryContext::map_file(fileName, size_, populate);
+    if ( mapped_ ) {
+        MemoryContext::unmap_file(mem_, size_);
+    } else {
+        MemoryContext::free(mem_, size_);
+    }
+    mem_ = m;
+    mapped_ = true;
+    return OP_OK;
+}
+
+// cpu memory is moved directly between pipeline stages
+template <DataType _DTYPE_>
+ComputingReturn DNNLTensor<_DTYPE_>::io_pipe_send(tensor_t self, int n) {
+    if ( gpu_ ) {
+        return OP_TODO_ERROR;
+    }
+    auto size = std::get<1>( self->op_sizeof(self) );
+    int ret = CollectiveContext::pipe_send(n, data(), size);
+    if ( ret < 0 ) {
+        return OP_OUTPUT_ERROR;
+    }
+    return OP_OK;
+}
+
+template <DataType _DTYPE_>
+ComputingReturn DNNLTensor<_DTYPE_>::io_pipe_recv(tensor_t self, int n) {
+    if ( gpu_ ) {
+        return OP_TODO_ERROR;
+    }
+    auto size = std::get<1>( self->op_sizeof(self) );
+    int ret = CollectiveContext::pipe_recv(n, data(), size);
+    if ( ret < 0 ) {
+        return OP_OUTPUT_ERROR;
+    }
+    return OP_OK;
+}
+
 template<DataType DT>
 ComputingReturn DNNLTensor<DT>::op_fill(tensor_t self, float value) {
     size_t items = self->items();
@@ -689,6 +748,7 @@ ComputingReturn DNNLTensor<DT>::op_dequantize(tensor_t self, tensor_t out) {
 
 template<DataType DT>
 ComputingReturn DNNLTensor<DT>::op_copy(tensor_t self, tensor_t from) {
+    vt_assert( dense({self, from}), "op_copy can't read strided views");
 #ifdef _DNNL_GPU_
     if ( is_gpu() ) {
         auto queue = dnnl::ocl_interop::get_command_queue(*ComputingContext::dnnl_gpu_stream);
@@ -729,6 +789,7 @@ ComputingReturn DNNLTensor<DT>::op_copy(tensor_t self, tensor_t from) {
 
 template<DataType DT>
 ComputingReturn DNNLTensor<DT>::op_convert(tensor_t self, tensor_t from) {
+    vt_assert( dense({self, from}), "op_convert can't read strided views");
     auto tag = dnnl::memory::format_tag::abcd;
     if ( self->shape().dim() == 3) {
         tag = dnnl::memory::format_tag::abc;
@@ -753,7 +814,7 @@ ComputingReturn DNNLTensor<DT>::op_convert(tensor_t self, tensor_t from) {
             return OP_OK;
         }
 #endif
-        prim.execute( *ComputingContext::dnnl_stream , src_mem, dst_mem);
+        prim.execute( ComputingContext::dnnl_current() , src_mem, dst_mem);
         return OP_OK;
     }
     if ( DT == DataType::Float && from->is_fp16() ) {
@@ -769,13 +830,45 @@ ComputingReturn DNNLTensor<DT>::op_convert(tensor_t self, tensor_t from) {
             return OP_OK;
         }
 #endif
-        prim.execute( *ComputingContext::dnnl_stream , src_mem, dst_mem);
+        prim.execute( ComputingContext::dnnl_current() , src_mem, dst_mem);
         return OP_OK;
     }
 
     return OP_TODO_ERROR;
 }
 
+template <DataType _DTYPE_>
+ComputingReturn DNNLTensor<_DTYPE_>::op_view_rebind(tensor_t self, tensor_t parent, size_t offset, const std::vector<size_t>& newShape) {
+#ifdef _DNNL_GPU_
+    if ( is_gpu() ) {
+        return OP_TODO_ERROR;
+    }
+#endif
+    if ( owner_ || mapped_ ) {
+        return OP_INPUT_ERROR;
+    }
+    size_t items = 1;
+    for (size_t i = 0; i < newShape.size(); i++) {
+        items *= newShape[i];
+    }
+    if ( _DTYPE_ == DataType::Float ) {
+        size_ = items * sizeof(float);
+        mem_ = (char *)parent->device_data() + offset * sizeof(float);
+        return OP_OK;
+    }
+    if ( _DTYPE_ == DataType::Int ) {
+        size_ = items * sizeof(int);
+        mem_ = (char *)parent->device_data() + offset * sizeof(int);
+        return OP_OK;
+    }
+    if ( _DTYPE_ == DataType::FP16 ) {
+        size_ = items * sizeof(local_fp16_t);
+        mem_ = (char *)parent->device_data() + offset * sizeof(local_fp16_t);
+        return OP_OK;
+    }
+    return OP_TODO_ERROR;
+}
+
 template <DataType _DTYPE_>
 std::variant<ComputingReturn, tensor_t> DNNLTensor<_DTYPE_>::op_view(tensor_t self, size_t offset, const std::vector<size_t>& newShape_) {
 
@@ -836,6 +929,36 @@ std::variant<ComputingReturn, tensor_t> DNNLTensor<_DTYPE_>::op_view(tensor_t se
     return OP_TODO_ERROR;
 }
 
+// impl covers items between first & last elements, TensorType keeps the strides
+template <DataType _DTYPE_>
+std::variant<ComputingReturn, tensor_t> DNNLTensor<_DTYPE_>::op_view_strided(tensor_t self, size_t offset, const std::vector<size_t>& newShape_, const std::vector<size_t>& newStrides_) {
+#ifdef _DNNL_GPU_
+    if ( is_gpu() ) {
+        return OP_TODO_ERROR;
+    }
+#endif
+    ShapeType newShape(newShape_, newStrides_);
+    std::vector<size_t> span;
+    span.push_back( newShape.span() );
+
+    if ( _DTYPE_ == DataType::Float ) {
+        float *newData = (float *)data() + offset;
+        auto* newCpuTensor = new DNNLTensor<DataType::Float>(ShapeType(span), newData);
+        return std::make_shared<TensorType>(newCpuTensor, newShape);
+    }
+    if ( _DTYPE_ == DataType::Int ) {
+        int *newData = (int *)data() + offset;
+        auto* newCpuTensor = new DNNLTensor<DataType::Int>(ShapeType(span), newData);
+        return std::make_shared<TensorType>(newCpuTensor, newShape);
+    }
+    if ( _DTYPE_ == DataType::FP16 ) {
+        local_fp16_t *newData = (local_fp16_t *)data() + offset;
+        auto* newCpuTensor = new DNNLTensor<DataType::FP16>(ShapeType(span), newData);
+        return std::make_shared<TensorType>(newCpuTensor, newShape);
+    }
+    return OP_TODO_ERROR;
+}
+
 template<DataType _DT_>
 std::variant<ComputingReturn, tensor_t> DNNLTensor<_DT_>::op_view_as(tensor_t self, size_t offset, const std::vector<size_t>& newShape_, const char* dtype) {
     DataType DT = DataType_from(dtype);
@@ -966,6 +1089,7 @@ ComputingReturn DNNLTensor<DT>::op_reshape(tensor_t self, size_t offset, const s
 
 template<DataType DT>
 ComputingReturn DNNLTensor<DT>::op_scale(tensor_t self, float scale) {
+    vt_assert( dense({self}), "op_scale can't read strided views");
     if (   DT == DataType::Float) {
         dnnl_kernels::eltwise<DNNLTensor<DataType::Float>>(self->dnnl_float(), self->dnnl_float(), self->items(),
             dnnl::algorithm::eltwise_linear, scale, 0.0);
@@ -1089,6 +1213,7 @@ void linear_kernel_w8(DNNLTensor<DataType::FP16>* src, DNNLTensor<DataType::Q8>*
 
 template<DataType DT>
 ComputingReturn DNNLTensor<DT>::op_linear(tensor_t self, tensor_t w, tensor_t bias, tensor_t dst) {
+    vt_assert( dense({self, w, bias, dst}), "op_linear can't read strided views");
     size_t batch = self->shape()[0];
     size_t tokens = self->shape()[1];
     size_t inSize = self->shape()[2];
@@ -1110,6 +1235,24 @@ ComputingReturn DNNLTensor<DT>::op_linear(tensor_t self, tensor_t w, tensor_t bi
     }
 #endif
 
+    // weights sharded by op.mem_numa are computed by their nodes, rows are split by pages of the
+    // owning block, so views ( q/k/v of qkv_proj ) go to nodes holding their rows
+    std::vector<size_t> rows;
+    size_t item = DT == DataType::Float ? sizeof(float) : sizeof(local_fp16_t);
+    if ( MemoryContext::numa_rows(w->device_data(), outSize, inSize * item, rows) &&
+         rows.size() == ComputingContext::numa_nodes.size() + 1 ) {
+        if (   DT == DataType::Float) {
+            dnnl_kernels::linear_sharded<DNNLTensor<DataType::Float>>(self->dnnl_float(), w->dnnl_float(),
+                bias == nullptr? nullptr : bias->dnnl_float(), dst->dnnl_float(), num, outSize, inSize, rows);
+            return OP_OK;
+        }
+        if (   DT == DataType::FP16) {
+            dnnl_kernels::linear_sharded<DNNLTensor<DataType::FP16>>(self->dnnl_fp16(), w->dnnl_fp16(),
+                bias == nullptr? nullptr : bias->dnnl_fp16(), dst->dnnl_fp16(), num, outSize, inSize, rows);
+            return OP_OK;
+        }
+    }
+
     if (   DT == DataType::Float) {
         dnnl_kernels::linear<DNNLTensor<DataType::Float>>(self->dnnl_float(), w->dnnl_float(),
             bias == nullptr? nullptr : bias->dnnl_float(), dst->dnnl_float(), num, outSize, inSize);
@@ -1126,6 +1269,7 @@ ComputingReturn DNNLTensor<DT>::op_linear(tensor_t self, tensor_t w, tensor_t bi
 
 template <DataType _DTYPE_>
 ComputingReturn DNNLTensor<_DTYPE_>::op_layernorm(tensor_t self, tensor_t mean, tensor_t var, tensor_t scale, tensor_t bias, tensor_t y, float eps) {
+    vt_assert( dense({self, scale, bias, y}), "op_layernorm can't read strided views");
     size_t batch = self->shape()[0];
     size_t tokens = self->shape()[1];
     size_t feature = self->shape()[2];
@@ -1149,6 +1293,7 @@ ComputingReturn DNNLTensor<_DTYPE_>::op_layernorm(tensor_t self, tensor_t mean,
 
 template <DataType _DTYPE_>
 ComputingReturn DNNLTensor<_DTYPE_>::op_rmsnorm(tensor_t self, tensor_t scale, tensor_t norm2, tensor_t y, float eps) {
+    vt_assert( dense({self, scale, norm2, y}), "op_rmsnorm can't read strided views");
     size_t batch = self->shape()[0];
     size_t tokens = self->shape()[1];
     size_t feature = self->shape()[2];
@@ -1227,8 +1372,41 @@ ComputingReturn DNNLTensor<_DTYPE_>::op_rmsnorm(tensor_t self, tensor_t scale, t
     return OP_TODO_ERROR;
 }
 
+template <DataType _DTYPE_>
+ComputingReturn DNNLTensor<_DTYPE_>::op_add_rmsnorm(tensor_t self, tensor_t b, tensor_t c, tensor_t scale, tensor_t norm2, tensor_t y, float eps) {
+    size_t batch = self->shape()[0];
+    size_t tokens = self->shape()[1];
+    size_t feature = self->shape()[2];
+    size_t num = batch * tokens;
+
+#ifdef _DNNL_GPU_
+    if ( is_gpu() ) {
+        return OP_TODO_ERROR;
+    }
+#endif
+    if ( !self->shape().is_contiguous() || !b->shape().is_contiguous() || !c->shape().is_contiguous() ) {
+        return OP_TODO_ERROR;
+    }
+
+    void* src = data();
+    void* src2 = b->device_data();
+    void* sum = c->device_data();
+    void* dst = y->device_data();
+    void* s = scale->device_data();
+    if (   _DTYPE_ == DataType::Float) {
+        dnnl_kernels::add_rmsnorm<float, DataType::Float>((float *)src, (float *)src2, (float *)sum, (float *)s, (float *)dst, num, feature, eps);
+        return OP_OK;
+    }
+    if (   _DTYPE_ == DataType::FP16) {
+        dnnl_kernels::add_rmsnorm<local_fp16_t, DataType::FP16>((local_fp16_t *)src, (local_fp16_t *)src2, (local_fp16_t *)sum, (local_fp16_t *)s, (local_fp16_t *)dst, num, feature, eps);
+        return OP_OK;
+    }
+    return OP_TODO_ERROR;
+}
+
 template <DataType DT>
 ComputingReturn DNNLTensor<DT>::op_rotary_embed(tensor_t self, tensor_t cached, tensor_t pos_, tensor_t y) {
+    vt_assert( dense({self, y}), "op_rotary_embed can't read strided views");
     size_t batch = self->shape()[0];
     size_t tokens = self->shape()[1];
     size_t heads = self->shape()[2];
@@ -1289,6 +1467,7 @@ ComputingReturn DNNLTensor<DT>::op_rotary_embed(tensor_t self, tensor_t cached,
 
 template <DataType DT>
 ComputingReturn DNNLTensor<DT>::op_transpose_0213(tensor_t self, tensor_t y) {
+    vt_assert( dense({self, y}), "op_transpose_0213 can't read strided views");
     size_t batch = self->shape()[0];
     size_t tokens = self->shape()[1];
     size_t heads = self->shape()[2];
@@ -1340,6 +1519,17 @@ if ( DT != DataType::FP16) {
 
 template <DataType _DTYPE_>
 ComputingReturn DNNLTensor<_DTYPE_>::op_qk(tensor_t self, tensor_t key, tensor_t qk) {
+    if ( !self->shape().is_contiguous() || !key->shape().is_contiguous() || !qk->shape().is_contiguous() ) {
+        if ( _DTYPE_ == DataType::Float) {
+            dnnl_kernels::query_key_strided<DNNLTensor<DataType::Float>>(self, key, qk, self->dnnl_float(), key->dnnl_float(), qk->dnnl_float(), dnnl::memory::data_type::f32);
+            return OP_OK;
+        }
+        if ( _DTYPE_ == DataType::FP16) {
+            dnnl_kernels::query_key_strided<DNNLTensor<DataType::FP16>>(self, key, qk, self->dnnl_fp16(), key->dnnl_fp16(), qk->dnnl_fp16(), dnnl::memory::data_type::f16);
+            return OP_OK;
+        }
+        return OP_TODO_ERROR;
+    }
 #if 1
     auto shape_ = self->shape().vec();
 
@@ -1396,6 +1586,7 @@ ComputingReturn DNNLTensor<_DTYPE_>::op_qk(tensor_t self, tensor_t key, tensor_t
 
 template <DataType _DTYPE_>
 ComputingReturn DNNLTensor<_DTYPE_>::op_softmax(tensor_t self, tensor_t dst) {
+    vt_assert( dense({self, dst}), "op_softmax can't read strided views");
     auto shape_ = self->shape().vec();
 
     int batch = shape_[0];
@@ -1417,6 +1608,17 @@ ComputingReturn DNNLTensor<_DTYPE_>::op_softmax(tensor_t self, tensor_t dst) {
 
 template<DataType _DTYPE_>
 ComputingReturn  DNNLTensor<_DTYPE_>::op_attn(tensor_t self, tensor_t value, tensor_t out) {
+    if ( !self->shape().is_contiguous() || !value->shape().is_contiguous() || !out->shape().is_contiguous() ) {
+        if ( _DTYPE_ == DataType::Float) {
+            dnnl_kernels::attn_strided<DNNLTensor<DataType::Float>>(self, value, out, self->dnnl_float(), value->dnnl_float(), out->dnnl_float(), dnnl::memory::data_type::f32);
+            return OP_OK;
+        }
+        if ( _DTYPE_ == DataType::FP16) {
+            dnnl_kernels::attn_strided<DNNLTensor<DataType::FP16>>(self, value, out, self->dnnl_fp16(), value->dnnl_fp16(), out->dnnl_fp16(), dnnl::memory::data_type::f16);
+            return OP_OK;
+        }
+        return OP_TODO_ERROR;
+    }
     auto shape_ = self->shape().vec();
     int batch = shape_[0];
     int heads = shape_[1];
@@ -1437,8 +1639,39 @@ ComputingReturn  DNNLTensor<_DTYPE_>::op_attn(tensor_t self, tensor_t value, ten
     return OP_TODO_ERROR;
 }
 
+template<DataType _DTYPE_>
+ComputingReturn  DNNLTensor<_DTYPE_>::op_attn_score(tensor_t self, tensor_t score) {
+    vt_assert( dense({self, score}), "op_attn_score can't read strided views");
+    auto shape_ = self->shape().vec();
+    int batch = shape_[0];
+    int heads = shape_[1];
+    int ntokens = shape_[2];
+    int ftokens = shape_[3];
+
+    if ( score->items() != (size_t)(batch * ftokens) ) {
+        return OP_OUTPUT_ERROR;
+    }
+#ifdef _DNNL_GPU_
+    if ( is_gpu() ) {
+        return OP_TODO_ERROR;
+    }
+#endif
+
+    float* s = (float *)score->host_float()->data();
+    if ( _DTYPE_ == DataType::Float) {
+        dnnl_kernels::attn_score<float>((float *)data(), s, batch, heads, ntokens, ftokens);
+        return OP_OK;
+    }
+    if ( _DTYPE_ == DataType::FP16) {
+        dnnl_kernels::attn_score<local_fp16_t>((local_fp16_t *)data(), s, batch, heads, ntokens, ftokens);
+        return OP_OK;
+    }
+    return OP_TODO_ERROR;
+}
+
 template <DataType _DTYPE_>
 ComputingReturn DNNLTensor<_DTYPE_>::op_gelu(tensor_t self, tensor_t dst) {
+    vt_assert( dense({self, dst}), "op_gelu can't read strided views");
     size_t total = self->items();
 
     if ( _DTYPE_ == DataType::Float ) {
@@ -1460,6 +1693,7 @@ ComputingReturn DNNLTensor<_DTYPE_>::op_gelu(tensor_t self, tensor_t dst) {
 
 template <DataType _DTYPE_>
 ComputingReturn DNNLTensor<_DTYPE_>::op_silu_product(tensor_t self, tensor_t in, tensor_t dst) {
+    vt_assert( dense({self, in, dst}), "op_silu_product can't read strided views");
     size_t total = self->items();
 
 #ifdef _DNNL_GPU_
@@ -1517,6 +1751,7 @@ ComputingReturn DNNLTensor<_DTYPE_>::op_silu_product(tensor_t self, tensor_t in,
 
 template<DataType DT>
 std::variant<ComputingReturn,int> DNNLTensor<DT>::op_all_logits(tensor_t self, tensor_t mask_,  tensor_t lm_head, tensor_t output) {
+    vt_assert( dense({self, output}), "op_all_logits can't read strided views");
     int batch = self->shape()[0];
     int new_tokens = self->shape()[1];
     int hidden_size = self->shape()[2];
@@ -1697,6 +1932,47 @@ std::variant<ComputingReturn, tensor_t>  DNNLTensor<DT>::op_sampling_top3(tensor
     return ret;
 }
 
+template<DataType DT>
+ComputingReturn DNNLTensor<DT>::op_logprob_topk(tensor_t self, tensor_t ids, tensor_t logprob, float temp) {
+    if ( DT != DataType::Float && DT != DataType::FP16 ) {
+        return OP_INPUT_ERROR;
+    }
+
+    int batch = self->shape()[0];
+    int vocab_size = self->shape()[1];
+    int k = ids->shape()[1];
+    if ( (int)ids->shape()[0] != batch || k > vocab_size ) {
+        return OP_OUTPUT_ERROR;
+    }
+    int* out = (int *)ids->device_data();
+    float* lp = (float *)logprob->device_data();
+
+#ifdef _DNNL_GPU_
+    if ( is_gpu() ) {
+        auto queue = dnnl::ocl_interop::get_command_queue(*ComputingContext::dnnl_gpu_stream);
+        int check = 0;
+        void* logits_ = clEnqueueMapBuffer(queue, (cl_mem)mem_,  CL_TRUE, CL_MAP_READ , 0, size_, 0, nullptr, nullptr, &check);
+        OPENCL_CHECK(check);
+
+        if ( DT == DataType::FP16 ) {
+            dnnl_kernels::easy_topk<local_fp16_t>((local_fp16_t *)logits_, out, lp, batch, vocab_size, k, temp);
+        } else {
+            dnnl_kernels::easy_topk<float>((float *)logits_, out, lp, batch, vocab_size, k, temp);
+        }
+
+        clEnqueueUnmapMemObject(queue, (cl_mem)mem_, logits_, 0, nullptr,  nullptr);
+        return OP_OK;
+    }
+#endif
+
+    if ( DT == DataType::FP16 ) {
+        dnnl_kernels::easy_topk<local_fp16_t>((local_fp16_t *)self->device_data(), out, lp, batch, vocab_size, k, temp);
+    } else {
+        dnnl_kernels::easy_topk<float>((float *)self->device_data(), out, lp, batch, vocab_size, k, temp);
+    }
+    return OP_OK;
+}
+
 template <DataType _DTYPE_>
 ComputingReturn DNNLTensor<_DTYPE_>::op_conv2d(tensor_t self, tensor_t weight, tensor_t bias, tensor_t dst, int _stride, int _padding) {
     dnnl::memory::dims strides{_stride, _stride};
@@ -1741,7 +2017,7 @@ ComputingReturn DNNLTensor<_DTYPE_>::op_conv2d(tensor_t self, tensor_t weight, t
         if ( bias != nullptr) {
             args[DNNL_ARG_BIAS] = bmem;
         }
-        conv_prim.execute(*ComputingContext::dnnl_stream, args);
+        conv_prim.execute(ComputingContext::dnnl_current(), args);
         return OP_OK;
     }
     return OP_TODO_ERROR;
@@ -1791,5 +2067,21 @@ tensor_t create_dnnl_q8(std::vector<size_t>& shape_, bool gpu) {
     return std::make_shared<TensorType>(tensor, shape);
 }
 
+// CPU only, memory is owned by caller ( shared weights, mappings ... )
+tensor_t create_dnnl_view(DataType dtype, std::vector<size_t>& shape_, void* mem) {
+    ShapeType shape(shape_);
+    if ( dtype == DataType::Float ) {
+        return std::make_shared<TensorType>(new DNNLTensor<DataType::Float>(shape, mem), shape);
+    }
+    if ( dtype == DataType::FP16 ) {
+        return std::make_shared<TensorType>(new DNNLTensor<DataType::FP16>(shape, mem), shape);
+    }
+    if ( dtype == DataType::Int ) {
+        return std::make_shared<TensorType>(new DNNLTensor<DataType::Int>(shape, mem), shape);
+    }
+    vt_panic("Can't create dnnl view for this dtype");
+    return nullptr;
+}
+
 
 }
@@ -39,6 +39,9 @@ public:
     ComputingReturn io_dump(tensor_t self) override;
     ComputingReturn io_load(tensor_t self, const char* fileName) override;
     ComputingReturn io_save(tensor_t self, const char* fileName) override;
+    ComputingReturn io_mmap(tensor_t self, const char* fileName, bool populate) override;
+    ComputingReturn io_pipe_send(tensor_t self, int n) override;
+    ComputingReturn io_pipe_recv(tensor_t self, int n) override;
 
     std::variant<ComputingReturn, size_t> op_sizeof(tensor_t self) override;
     ComputingReturn op_zero(tensor_t self) override;
@@ -53,7 +56,9 @@ public:
     ComputingReturn op_copy(tensor_t self, tensor_t from) override;
     ComputingReturn op_convert(tensor_t self, tensor_t from) override;
     std::variant<ComputingReturn, tensor_t> op_view(tensor_t self, size_t offset, const std::vector<size_t>& newShape_) override;
+    ComputingReturn op_view_rebind(tensor_t self, tensor_t parent, size_t offset, const std::vector<size_t>& newShape) override;
     std::variant<ComputingReturn, tensor_t> op_view_as(tensor_t self, size_t offset, const std::vector<size_t>& newShape, const char* dtype) override;
+    std::variant<ComputingReturn, tensor_t> op_view_strided(tensor_t self, size_t offset, const std::vector<size_t>& newShape, const std::vector<size_t>& newStrides) override;
     ComputingReturn op_reshape(tensor_t self, size_t offset, const std::vector<size_t>& newShape) override;
 
     ComputingReturn op_scale(tensor_t self, float scale) override;
@@ -63,24 +68,28 @@ public:
     ComputingReturn op_linear(tensor_t self, tensor_t w, tensor_t b, tensor_t y) override;
     ComputingReturn op_layernorm(tensor_t self, tensor_t mean, tensor_t var, tensor_t scale, tensor_t bias, tensor_t y, float eps) override;
     ComputingReturn op_rmsnorm(tensor_t self, tensor_t scale, tensor_t norm2, tensor_t y, float eps) override;
+    ComputingReturn op_add_rmsnorm(tensor_t self, tensor_t b, tensor_t c, tensor_t scale, tensor_t norm2, tensor_t y, float eps) override;
     ComputingReturn op_rotary_embed(tensor_t self, tensor_t cached, tensor_t pos, tensor_t y) override;
 
     ComputingReturn op_transpose_0213(tensor_t self, tensor_t y) override;
     ComputingReturn op_qk(tensor_t self, tensor_t k, tensor_t qk) override;
     ComputingReturn op_softmax(tensor_t self, tensor_t out) override;
     ComputingReturn op_attn(tensor_t self, tensor_t value, tensor_t out) override;
+    ComputingReturn op_attn_score(tensor_t self, tensor_t score) override;
     ComputingReturn op_gelu(tensor_t self, tensor_t dst) override;
     ComputingReturn op_silu_product(tensor_t self, tensor_t in, tensor_t dst) override;
 
     std::variant<ComputingReturn, int> op_all_logits(tensor_t self, tensor_t mask,  tensor_t lm_head, tensor_t output) override;
     std::variant<ComputingReturn, tensor_t> op_sampling_top1(tensor_t self) override;
     std::variant<ComputingReturn, tensor_t> op_sampling_top3(tensor_t self, float temp) override;
+    ComputingReturn op_logprob_topk(tensor_t self, tensor_t ids, tensor_t logprob, float temp) override;
     
     ComputingReturn op_conv2d(tensor_t self, tensor_t weight, tensor_t bias, tensor_t dst, int stride, int padding) override;
 
 protected:
     const bool owner_;
     const bool gpu_;
+    bool mapped_;           // mem_ is a read only file mapping
     void* mem_;
     size_t size_;
 
@@ -145,6 +145,33 @@ ComputingReturn HostTensor<_DTYPE_>::op_embed(tensor_t self, tensor_t table, ten
     return OP_TODO_ERROR;
 }
 
+template <DataType _DTYPE_>
+ComputingReturn HostTensor<_DTYPE_>::op_view_rebind(tensor_t self, tensor_t parent, size_t offset, const std::vector<size_t>& newShape) {
+    if ( owner_ || mapped_ ) {
+        return OP_INPUT_ERROR;
+    }
+    size_t items = 1;
+    for (size_t i = 0; i < newShape.size(); i++) {
+        items *= newShape[i];
+    }
+    if ( _DTYPE_ == DataType::Float ) {
+        size_ = items * sizeof(float);
+        mem_ = (char *)parent->device_data() + offset * sizeof(float);
+        return OP_OK;
+    }
+    if ( _DTYPE_ == DataType::Int ) {
+        size_ = items * sizeof(int);
+        mem_ = (char *)parent->device_data() + offset * sizeof(int);
+        return OP_OK;
+    }
+    if ( _DTYPE_ == DataType::FP16 ) {
+        size_ = items * sizeof(local_fp16_t);
+        mem_ = (char *)parent->device_data() + offset * sizeof(local_fp16_t);
+        return OP_OK;
+    }
+    return OP_TODO_ERROR;
+}
+
 template <DataType _DTYPE_>
 std::variant<ComputingReturn, tensor_t> HostTensor<_DTYPE_>::op_view(tensor_t self, size_t offset, const std::vector<size_t>& newShape_) {
     if ( _DTYPE_ == DataType::Float ) {
@@ -374,6 +401,26 @@ ComputingReturn HostTensor<_DTYPE_>::io_load(tensor_t self, const char* fileName
     return OP_OK;
 }
 
+// binding storage to the file, TensorType reads into tensors having views instead
+template <DataType _DTYPE_>
+ComputingReturn HostTensor<_DTYPE_>::io_mmap(tensor_t self, const char* fileName, bool populate) {
+    // page cache ignores NUMA policy, placed blocks are read into
+    if ( !owner_ || MemoryContext::numa_shards(mem_) > 0 ) {
+        return io_load(self, fileName);
+    }
+    size_t s = std::get<1>(self->op_sizeof(self));
+    void* m = MemoryContext::map_file(fileName, s, populate);
+    if ( mapped_ ) {
+        MemoryContext::unmap_file(mem_, size_);
+    } else {
+        MemoryContext::free(mem_, size_);
+    }
+    mem_ = m;
+    size_ = s;
+    mapped_ = true;
+    return OP_OK;
+}
+
 #ifdef _USING_HPC_MPI_
 template <DataType _DTYPE_>
 ComputingReturn HostTensor<_DTYPE_>::io_mpi_recv(tensor_t self, int source) {
@@ -447,6 +494,26 @@ ComputingReturn HostTensor<_DTYPE_>::io_pipe_write(tensor_t self, int n) {
     return OP_OK;
 }
 
+template <DataType _DTYPE_>
+ComputingReturn HostTensor<_DTYPE_>::io_pipe_send(tensor_t self, int n) {
+    auto size = std::get<1>( self->op_sizeof(self) );
+    int ret = CollectiveContext::pipe_send(n, data(), size);
+    if ( ret < 0 ) {
+        return OP_OUTPUT_ERROR;
+    }
+    return OP_OK;
+}
+
+template <DataType _DTYPE_>
+ComputingReturn HostTensor<_DTYPE_>::io_pipe_recv(tensor_t self, int n) {
+    auto size = std::get<1>( self->op_sizeof(self) );
+    int ret = CollectiveContext::pipe_recv(n, data(), size);
+    if ( ret < 0 ) {
+        return OP_OUTPUT_ERROR;
+    }
+    return OP_OK;
+}
+
 tensor_t create_host_float(std::vector<size_t>& shape_) {
     ShapeType shape(shape_);
     HostTensor<DataType::Float>* tensor = new HostTensor<DataType::Float>(shape);
@@ -483,4 +550,25 @@ tensor_t create_host_pq(std::vector<size_t>& shape_, const int S) {
     return std::make_shared<TensorType>(tensor, shape);
 }
 
+tensor_t create_host_view(DataType dtype, std::vector<size_t>& shape_, void* mem) {
+    ShapeType shape(shape_);
+    if ( dtype == DataType::Float ) {
+        return std::make_shared<TensorType>(new HostTensor<DataType::Float>(shape, mem), shape);
+    }
+    if ( dtype == DataType::FP16 ) {
+        return std::make_shared<TensorType>(new HostTensor<DataType::FP16>(shape, mem), shape);
+    }
+    if ( dtype == DataType::Int ) {
+        return std::make_shared<TensorType>(new HostTensor<DataType::Int>(shape, mem), shape);
+    }
+    if ( dtype == DataType::Q8 ) {
+        return std::make_shared<TensorType>(new HostTensor<DataType::Q8>(shape, mem), shape);
+    }
+    if ( dtype == DataType::Q4 ) {
+        return std::make_shared<TensorType>(new HostTensor<DataType::Q4>(shape, mem), shape);
+    }
+    vt_panic("Can't create host view for this dtype");
+    return nullptr;
+}
+
 }
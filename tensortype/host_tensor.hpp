@@ -10,7 +10,7 @@ namespace vt {
 
 template <DataType _DTYPE_>
 struct HostTensor : public TransformerComputing {
-    HostTensor(const ShapeType& shape) : owner_(true), PQ_S_(0) {
+    HostTensor(const ShapeType& shape) : owner_(true), PQ_S_(0), mapped_(false) {
         if ( _DTYPE_ == DataType::Float ) {
             size_ = shape.numel() * sizeof(float);
         } else if ( _DTYPE_ == DataType::Int ) {
@@ -36,7 +36,7 @@ struct HostTensor : public TransformerComputing {
 
         mem_ = MemoryContext::alloc(size_);
     }
-    HostTensor(const ShapeType& shape, const int S) : owner_(true) , PQ_S_(S) {
+    HostTensor(const ShapeType& shape, const int S) : owner_(true) , PQ_S_(S), mapped_(false) {
         if ( _DTYPE_ != DataType::PQ ) {
             vt_panic("Can't be here!");
         }
@@ -47,7 +47,7 @@ struct HostTensor : public TransformerComputing {
         mem_ = MemoryContext::alloc(size_);
     }
 
-    HostTensor(const ShapeType& shape,  void *mem) : owner_(false), PQ_S_(0), mem_(mem) {
+    HostTensor(const ShapeType& shape,  void *mem) : owner_(false), PQ_S_(0), mapped_(false), mem_(mem) {
         if ( _DTYPE_ == DataType::PQ ) {
             vt_panic("Can't be here!");
         }
@@ -59,10 +59,20 @@ struct HostTensor : public TransformerComputing {
             size_t last_dim = shape.vec().back();
             vt_assert( last_dim > 128, "Q8 tensor last dim must > 128k");
         }
+        // bytes seen by a view, kept along with the shape when it's rebound
         size_ = 0;
+        if ( _DTYPE_ == DataType::Float ) {
+            size_ = shape.numel() * sizeof(float);
+        } else if ( _DTYPE_ == DataType::Int ) {
+            size_ = shape.numel() * sizeof(int);
+        } else if ( _DTYPE_ == DataType::FP16 ) {
+            size_ = shape.numel() * sizeof(local_fp16_t);
+        }
     }
     virtual ~HostTensor() {
-        if ( owner_ ) {
+        if ( mapped_ ) {
+            MemoryContext::unmap_file(mem_, size_);
+        } else if ( owner_ ) {
             MemoryContext::free(mem_, size_);
         }
     }
@@ -75,6 +85,7 @@ public:
     ComputingReturn io_dump(tensor_t self) override;
     ComputingReturn io_load(tensor_t self, const char* fileName) override;
     ComputingReturn io_save(tensor_t self, const char* fileName) override;
+    ComputingReturn io_mmap(tensor_t self, const char* fileName, bool populate) override;
 #ifdef _USING_HPC_OPENMPI_
     ComputingReturn io_mpi_bcast(tensor_t self, int root) override;
     ComputingReturn io_mpi_recv(tensor_t self, int source) override;
@@ -82,16 +93,20 @@ public:
 #endif
     ComputingReturn io_pipe_read(tensor_t self) override;
     ComputingReturn io_pipe_write(tensor_t self, int n) override;
+    ComputingReturn io_pipe_send(tensor_t self, int n) override;
+    ComputingReturn io_pipe_recv(tensor_t self, int n) override;
 
     std::variant<ComputingReturn, size_t> op_sizeof(tensor_t self) override;
     ComputingReturn op_zero(tensor_t self) override;
     ComputingReturn op_copy(tensor_t self, tensor_t dst) override;
     ComputingReturn op_embed(tensor_t self, tensor_t table, tensor_t output) override;
     std::variant<ComputingReturn, tensor_t> op_view(tensor_t self, size_t offset, const std::vector<size_t>& newShape_) override;
+    ComputingReturn op_view_rebind(tensor_t self, tensor_t parent, size_t offset, const std::vector<size_t>& newShape) override;
 
 protected:
     const bool owner_;
     const int PQ_S_;
+    bool mapped_;           // mem_ is a read only file mapping
 
     void* mem_;
     size_t size_;
@@ -1,4 +1,5 @@
 #include <chrono>
+#include <list>
 #include "tensortype.hpp"
 #include "context.hpp"
 #include "dag.hpp"
@@ -14,6 +15,20 @@ namespace nn {
             int end_;              // last one valid
             int invalid_;          // first one should be filled
 
+            // heavy hitter (H2O) mode, slots are kept compacted from zero
+            std::vector<int> history_;     // whole sequence, including evicted tokens
+            std::vector<int> pos_;         // logical position of each slot
+            std::vector<float> score_;     // accumulated attention mass of each slot
+
+            // forked entry shares the first shared_ tokens of parent_, refs_ counts children
+            int parent_;
+            int shared_;
+            int refs_;
+
+            // entry bound to a session handle is out of ordered_caches_, window_ is its most tokens
+            int session_;
+            int window_;
+
             int get_cached() {
                 vt_assert( (begin_ >= 0) && (end_ >= 0) && (invalid_ >= 0), "Finding a invalid KVCacheEntry ");
                 if ( invalid_ >= begin_ ) {
@@ -31,36 +46,42 @@ namespace nn {
                 return (int)id_.size() + end_ - invalid_ + 1;
             }
 
+            int get_stored() {
+                if ( begin_ == -1 ) {
+                    return 0;
+                }
+                if ( end_ >= begin_ ) {
+                    return end_ - begin_ + 1;
+                }
+                return (int)id_.size() + end_ - begin_ + 1;
+            }
+
             void copy_cached(tensor_t cache_, tensor_t left_) {
                 vt_assert( invalid_ != begin_ , "Can't copy zero cached");
+                copy_prefix(cache_, left_, get_cached());
+            }
+
+            // copy first n stored tokens to a linear buffer
+            void copy_prefix(tensor_t cache_, tensor_t dst_, int n) {
                 int hidden_size = cache_->shape()[1];
 
-                if ( invalid_ > begin_ ) {
-                    int cached_len = get_cached();
-                    std::vector<size_t> blk_shape{(size_t)cached_len, (size_t)hidden_size};
-                    size_t offset = begin_ * hidden_size;
+                // once
+                int len1 = std::min(n, (int)id_.size() - begin_);
+                std::vector<size_t> blk_shape{(size_t)len1, (size_t)hidden_size};
+                size_t offset = begin_ * hidden_size;
+                if ( blk_shape[0] > 0) {
                     tensor_t src = std::get<1>(cache_->op_view(cache_, offset, blk_shape));
+                    tensor_t dst = std::get<1>(dst_->op_view(dst_, 0, blk_shape));
+                    dst->op_copy(dst, src);
+                }
 
-                    left_->op_copy(left_, src);
-                } else {
-                    // once
-                    int len1 = id_.size() - begin_;
-                    std::vector<size_t> blk_shape{(size_t)len1, (size_t)hidden_size};
-                    size_t offset = begin_ * hidden_size;
-                    if ( blk_shape[0] > 0) {
-                        tensor_t src = std::get<1>(cache_->op_view(cache_, offset, blk_shape));
-                        tensor_t dst = std::get<1>(left_->op_view(left_, 0, blk_shape));
-                        dst->op_copy(dst, src);
-                    }
-
-                    // twice
-                    offset = blk_shape[0] * blk_shape[1];
-                    blk_shape[0] = invalid_;
-                    if ( blk_shape[0] > 0) {
-                        tensor_t src = std::get<1>(cache_->op_view(cache_, 0, blk_shape));
-                        tensor_t dst = std::get<1>(left_->op_view(left_, offset, blk_shape));
-                        dst->op_copy(dst, src);
-                    }
+                // twice
+                offset = blk_shape[0] * blk_shape[1];
+                blk_shape[0] = n - len1;
+                if ( blk_shape[0] > 0) {
+                    tensor_t src = std::get<1>(cache_->op_view(cache_, 0, blk_shape));
+                    tensor_t dst = std::get<1>(dst_->op_view(dst_, offset, blk_shape));
+                    dst->op_copy(dst, src);
                 }
             }
 
@@ -153,6 +174,134 @@ namespace nn {
                 return matched_len;
             }
 
+            std::tuple<int, int> match_h2o(const int tokens, const int* id, const int* mask) {  // return {length, begin}
+                if ( begin_ == -1 ) {
+                    return {0, -1};
+                }
+                int len = 0;
+                for (int i = 0; i < tokens && i < (int)history_.size(); i++) {
+                    if ( mask[i] == 0 || history_[i] != id[i] ) {
+                        break;
+                    }
+                    len++;
+                }
+                return {len, 0};
+            }
+
+            // a prompt longer than slots has its head evicted before computing, returns dropped tokens
+            int replace_h2o(const int tokens, const int* id, const int* mask) {
+                history_.clear();
+                for (int i = 0; i < tokens; i++) {
+                    if ( i > 0 && mask[i] == 0 ) {
+                        break;
+                    }
+                    history_.push_back(id[i]);
+                }
+                int dropped = std::max(0, (int)history_.size() - (int)id_.size());
+                for (int i = dropped; i < (int)history_.size(); i++) {
+                    id_[i - dropped] = history_[i];
+                    pos_[i - dropped] = i;
+                    score_[i - dropped] = 0.0;
+                }
+                begin_ = 0;
+                invalid_ = 0;
+                seq_ = dropped;
+                end_ = (int)history_.size() - dropped - 1;
+                return dropped;
+            }
+
+            // keep slots which are matched and not evicted, return moved blocks as {from, to, length}
+            std::vector<std::tuple<int, int, int>> evict_h2o(const int matched_len, const int target, const int recent) {
+                int filled = end_ + 1;
+                std::vector<bool> keep(filled, false);
+                std::vector<int> candidates;
+                for (int i = 0; i < filled; i++) {
+                    if ( pos_[i] < matched_len ) {
+                        keep[i] = true;
+                        candidates.push_back(i);
+                    }
+                }
+
+                int evicted = (int)candidates.size() - target;
+                if ( evicted > 0 ) {
+                    // the most recent tokens are always kept
+                    std::sort(candidates.begin(), candidates.end(), [&](int a, int b) {
+                        return pos_[a] < pos_[b];
+                    });
+                    int window = std::min( recent, (int)candidates.size() - evicted );
+                    candidates.resize( candidates.size() - window );
+                    std::sort(candidates.begin(), candidates.end(), [&](int a, int b) {
+                        return score_[a] < score_[b];
+                    });
+                    for (int i = 0; i < evicted; i++) {
+                        keep[ candidates[i] ] = false;
+                    }
+                }
+
+                // filling holes with kept slots behind them in same order, the order of cached tokens is
+                // meaningless for attention, so runs of holes & sources are moved as blocks
+                std::vector<std::tuple<int, int, int>> moves;
+                int kept = std::count(keep.begin(), keep.end(), true);
+                int from = kept;
+                for (int i = 0; i < kept; i++) {
+                    if ( keep[i] ) {
+                        continue;
+                    }
+                    while ( !keep[from] ) {
+                        from++;
+                    }
+                    id_[i] = id_[from];
+                    pos_[i] = pos_[from];
+                    score_[i] = score_[from];
+                    if ( moves.size() > 0 ) {
+                        auto& last = moves.back();
+                        if ( std::get<0>(last) + std::get<2>(last) == from && std::get<1>(last) + std::get<2>(last) == i ) {
+                            std::get<2>(last)++;
+                            from++;
+                            continue;
+                        }
+                    }
+                    moves.push_back({from, i, 1});
+                    from++;
+                }
+                end_ = kept - 1;
+                return moves;
+            }
+
+            // the first dropped uncached tokens are evicted before computing
+            int append_h2o(const int tokens, const int* id, const int* mask, int matched_len, int dropped) {
+                int valid = tokens;
+                for (int i = 0; i < tokens; i++) {
+                    if ( mask[i] == 0 ) {
+                        valid = i;
+                        break;
+                    }
+                }
+                // at least uncache one
+                if ( matched_len >= valid ) {
+                    matched_len = valid - 1;
+                }
+
+                int kept = end_ + 1;
+                vt_assert( valid - matched_len - dropped + kept <= (int)id_.size(), "Input tokens is too long!");
+
+                history_.resize(matched_len);
+                invalid_ = kept;
+                end_ = kept - 1;
+                for (int i = matched_len; i < valid; i++) {
+                    history_.push_back(id[i]);
+                    if ( i < matched_len + dropped ) {
+                        continue;
+                    }
+                    end_++;
+                    id_[end_] = id[i];
+                    pos_[end_] = i;
+                    score_[end_] = 0.0;
+                }
+                seq_ = matched_len + dropped - kept;
+                return matched_len + dropped;
+            }
+
             std::tuple<int, int> match(const int tokens, const int* id, const int* mask) {      // return {length, begin}
                 if ( begin_ == -1 ) {
                     return {0, -1};
@@ -204,16 +353,33 @@ namespace nn {
         std::vector<KVCacheEntry> all_caches_;
         std::vector<int> batched_caches_;
         std::list<int> ordered_caches_;
+        std::map<int, int> sessions_;       // handle -> entry
         int left_max;
         int right_max;
 
+        // heavy hitter eviction, disabled when budget_ is zero
+        int budget_;
+        int recent_;
+        tensor_t kcache_;
+        tensor_t vcache_;
+
         EasyKVCache(int hs, int ct, int cn, int cl) : hidden_size(hs), cached_tokens(ct), cached_number(cn), cached_layer(cl) {
+            budget_ = 0;
+            recent_ = 0;
             for (int i = 0; i < cn; i++) {
                 KVCacheEntry kvc;
                 kvc.id_.resize(cached_tokens);
+                kvc.pos_.resize(cached_tokens);
+                kvc.score_.resize(cached_tokens);
                 kvc.begin_ = -1;
                 kvc.end_ = -1;
                 kvc.invalid_ = -1;
+                kvc.seq_ = 0;
+                kvc.parent_ = -1;
+                kvc.shared_ = 0;
+                kvc.refs_ = 0;
+                kvc.session_ = -1;
+                kvc.window_ = 0;
 
                 all_caches_.push_back( kvc );
                 ordered_caches_.push_back(i);
@@ -222,27 +388,273 @@ namespace nn {
 
         void reset(bool erased = false) {
             for (size_t i = 0; i < batched_caches_.size(); i++) {
-                ordered_caches_.push_back( batched_caches_[i] );
+                // entries shared by forked ones or bound to sessions are pinned
+                const KVCacheEntry& entry = all_caches_[ batched_caches_[i] ];
+                if ( entry.refs_ == 0 && entry.session_ == -1 ) {
+                    ordered_caches_.push_back( batched_caches_[i] );
+                }
             }
             batched_caches_.clear();
             right_max = -1;
             left_max = -1;
 
             if ( erased ) {
+                ordered_caches_.clear();
                 for ( int i = 0; i < (int)all_caches_.size(); i++) {
                     all_caches_[i].begin_ = -1;
                     all_caches_[i].end_ = -1;
                     all_caches_[i].invalid_ = -1;
+                    all_caches_[i].seq_ = 0;
+                    all_caches_[i].history_.clear();
+                    all_caches_[i].parent_ = -1;
+                    all_caches_[i].shared_ = 0;
+                    all_caches_[i].refs_ = 0;
+                    all_caches_[i].session_ = -1;
+                    ordered_caches_.push_back(i);
                 }
+                sessions_.clear();
             }
         }
 
-        int do_match(const int tokens, const int* id, const int* mask) {
+        // least recently used entry is bound to the handle, opening a bound handle again empties it
+        void open_session(int handle, int window) {
+            vt_assert( budget_ == 0, "Can't open session in H2O mode");
+            vt_assert( window > 0 && window <= cached_tokens, "Session window must be in cached tokens");
+            int ci = -1;
+            auto it = sessions_.find(handle);
+            if ( it != sessions_.end() ) {
+                ci = it->second;
+            } else {
+                vt_assert( ordered_caches_.size() > 0, "No free KV cache entry for session");
+                ci = ordered_caches_.front();
+                ordered_caches_.pop_front();
+                sessions_[handle] = ci;
+            }
+            release(ci);
+
+            KVCacheEntry& entry = all_caches_[ci];
+            entry.begin_ = -1;
+            entry.end_ = -1;
+            entry.invalid_ = -1;
+            entry.seq_ = 0;
+            entry.history_.clear();
+            entry.session_ = handle;
+            entry.window_ = window;
+        }
+
+        // the entry is kept as a recently used one, later prompts can still match its tokens
+        void close_session(int handle) {
+            auto it = sessions_.find(handle);
+            vt_assert( it != sessions_.end(), "Closing a session not opened");
+            int ci = it->second;
+            sessions_.erase(it);
+            all_caches_[ci].session_ = -1;
+            if ( std::find(batched_caches_.begin(), batched_caches_.end(), ci) == batched_caches_.end() ) {
+                ordered_caches_.push_back(ci);
+            }
+        }
+
+        // all stored tokens of a session are cached after its last step, new ones follow them and
+        // the oldest are dropped out of the window ( positions keep going ), returns cached tokens
+        int session_append(int handle, const int n, const int* id) {
+            auto it = sessions_.find(handle);
+            vt_assert( it != sessions_.end(), "Session is not opened");
+            int ci = it->second;
+            batched_caches_.push_back(ci);
+
+            KVCacheEntry& entry = all_caches_[ci];
+            vt_assert( n > 0 && n < entry.window_, "Session step is too long!");
+            if ( entry.begin_ == -1 ) {
+                for (int i = 0; i < n; i++) {
+                    entry.id_[i] = id[i];
+                }
+                entry.begin_ = 0;
+                entry.invalid_ = 0;
+                entry.end_ = n - 1;
+                entry.seq_ = 0;
+                return 0;
+            }
+
+            int over = entry.get_stored() + n - entry.window_;
+            if ( over > 0 ) {
+                entry.begin_ = (entry.begin_ + over) % cached_tokens;
+                entry.seq_ += over;
+            }
+            entry.invalid_ = (entry.end_ + 1) % cached_tokens;
+            for (int i = 0; i < n; i++) {
+                entry.end_ = (entry.end_ + 1) % cached_tokens;
+                entry.id_[entry.end_] = id[i];
+            }
+            return entry.get_cached();
+        }
+
+        void release(int ci) {
+            KVCacheEntry& entry = all_caches_[ci];
+            if ( entry.parent_ == -1 ) {
+                return;
+            }
+            int pi = entry.parent_;
+            entry.parent_ = -1;
+            entry.shared_ = 0;
+
+            all_caches_[pi].refs_--;
+            if ( all_caches_[pi].refs_ == 0 ) {
+                if ( std::find(batched_caches_.begin(), batched_caches_.end(), pi) == batched_caches_.end() ) {
+                    ordered_caches_.push_back(pi);
+                }
+            }
+        }
+
+        int logical_id(int ci, int i) {
+            KVCacheEntry& entry = all_caches_[ci];
+            if ( entry.parent_ >= 0 ) {
+                if ( i < entry.shared_ ) {
+                    KVCacheEntry& parent = all_caches_[entry.parent_];
+                    return parent.id_[ (parent.begin_ + i) % cached_tokens ];
+                }
+                return entry.id_[ i - entry.shared_ ];
+            }
+            return entry.id_[ (entry.begin_ + i) % cached_tokens ];
+        }
+
+        int match_forked(int ci, const int tokens, const int* id, const int* mask) {
+            KVCacheEntry& entry = all_caches_[ci];
+            int stored = entry.shared_ + entry.get_stored();
+            int len = 0;
+            for (int i = 0; i < tokens && i < stored; i++) {
+                if ( mask[i] == 0 || logical_id(ci, i) != id[i] ) {
+                    break;
+                }
+                len++;
+            }
+            return len;
+        }
+
+        int append_forked(int ci, const int tokens, const int* id, const int* mask, int matched_len) {
+            KVCacheEntry& entry = all_caches_[ci];
+            int valid = tokens;
+            for (int i = 0; i < tokens; i++) {
+                if ( mask[i] == 0 ) {
+                    valid = i;
+                    break;
+                }
+            }
+            // at least uncache one
+            matched_len = std::min(matched_len, valid - 1);
+
+            // diverged inside shared part, parent is read only so nothing to copy
+            int own_matched = matched_len - entry.shared_;
+            if ( own_matched < 0 ) {
+                entry.shared_ = matched_len;
+                own_matched = 0;
+            }
+            int shared = entry.shared_;
+            if ( shared == 0 ) {
+                release(ci);
+            }
+
+            int own = valid - shared;
+            if ( own > cached_tokens ) {
+                vt_panic("Input tokens is too long!");
+            }
+            for (int i = own_matched; i < own; i++) {
+                entry.id_[i] = id[shared + i];
+            }
+            entry.begin_ = 0;
+            entry.invalid_ = own_matched;
+            entry.end_ = own - 1;
+            return matched_len;
+        }
+
+        // new entry shares parent's prefix, only tokens after the prefix are copied
+        void fork(int ci, int ck) {
+            release(ck);
+            KVCacheEntry& entry = all_caches_[ci];
+            KVCacheEntry& child = all_caches_[ck];
+
+            int root = ci;
+            int shared = entry.get_stored();
+            int own = 0;
+            if ( entry.parent_ >= 0 ) {
+                root = entry.parent_;
+                shared = entry.shared_;
+                own = entry.get_stored();
+            }
+
+            if ( own > 0 ) {
+                std::vector<size_t> blk_shape{(size_t)own, (size_t)hidden_size};
+                for (int l = 0; l < cached_layer; l++) {
+                    for (tensor_t c : {kcache_, vcache_}) {
+                        tensor_t src = std::get<1>(c->op_view(c, offset_of(ci, l), blk_shape));
+                        tensor_t dst = std::get<1>(c->op_view(c, offset_of(ck, l), blk_shape));
+                        dst->op_copy(dst, src);
+                    }
+                }
+                for (int i = 0; i < own; i++) {
+                    child.id_[i] = entry.id_[i];
+                }
+                child.begin_ = 0;
+                child.end_ = own - 1;
+                child.invalid_ = own;
+            } else {
+                child.begin_ = -1;
+                child.end_ = -1;
+                child.invalid_ = -1;
+            }
+            child.seq_ = entry.seq_;
+            child.parent_ = root;
+            child.shared_ = shared;
+            all_caches_[root].refs_++;
+        }
+
+        // rows[i] is the batched row which the i-th new sequence continues
+        void do_fork(const std::vector<int>& rows) {
+            vt_assert( budget_ == 0, "Can't fork KV cache in H2O mode");
+            std::vector<bool> reused(batched_caches_.size(), false);
+            std::vector<int> forked;
+            for (size_t i = 0; i < rows.size(); i++) {
+                int r = rows[i];
+                vt_assert( r >= 0 && r < (int)batched_caches_.size(), "Fork from a invalid row");
+                int ci = batched_caches_[r];
+
+                // a forked entry can continue by itself, a root entry must be kept unchanged
+                if ( all_caches_[ci].parent_ >= 0 && reused[r] == false ) {
+                    reused[r] = true;
+                    continue;
+                }
+
+                vt_assert( ordered_caches_.size() > 0, "No free KV cache entry for forking");
+                int ck = ordered_caches_.front();
+                ordered_caches_.pop_front();
+                fork(ci, ck);
+                forked.push_back(ck);
+            }
+            for (size_t i = 0; i < forked.size(); i++) {
+                ordered_caches_.push_back( forked[i] );
+            }
+        }
+
+        int get_position(int ci) {
+            KVCacheEntry& entry = all_caches_[ci];
+            int shared = entry.parent_ >= 0 ? entry.shared_ : 0;
+            int own = entry.begin_ == -1 ? 0 : entry.get_cached();
+            return entry.seq_ + shared + own;
+        }
+
+        std::tuple<int, int> do_match(const int tokens, const int* id, const int* mask) {     // return {skipped, cached}
+            vt_assert( ordered_caches_.size() > 0, "No free KV cache entry for matching");
             std::tuple<int, int> match_result{0, -1};
             auto best_matched = ordered_caches_.end();
             for (auto ii = ordered_caches_.begin(); ii != ordered_caches_.end(); ii++) {
                 int i = *ii;
-                auto ret = all_caches_[i].match(tokens, id, mask);
+                std::tuple<int, int> ret;
+                if ( budget_ > 0 ) {
+                    ret = all_caches_[i].match_h2o(tokens, id, mask);
+                } else if ( all_caches_[i].parent_ >= 0 ) {
+                    ret = {match_forked(i, tokens, id, mask), 0};
+                } else {
+                    ret = all_caches_[i].match(tokens, id, mask);
+                }
                 if ( std::get<0>(ret) > std::get<0>(match_result) ) {
                     match_result = ret;
                     best_matched = ii;
@@ -253,39 +665,120 @@ namespace nn {
                 int i = ordered_caches_.front();
                 ordered_caches_.pop_front();
                 batched_caches_.push_back(i);
+                release(i);
+                if ( budget_ > 0 ) {
+                    int dropped = all_caches_[i].replace_h2o(tokens, id, mask);
+                    return {dropped, 0};
+                }
                 all_caches_[i].replace(tokens, id, mask);
-                return 0;
-            } else {
-                int i  = *best_matched;
-                ordered_caches_.erase(best_matched);
-                batched_caches_.push_back(i);
-                int len = all_caches_[i].append(tokens, id, mask, std::get<0>(match_result), std::get<1>(match_result) );
-                return len;
+                return {0, 0};
+            }
+
+            int i  = *best_matched;
+            ordered_caches_.erase(best_matched);
+            batched_caches_.push_back(i);
+            if ( budget_ > 0 ) {
+                return do_append_h2o(i, tokens, id, mask, std::get<0>(match_result));
             }
+            if ( all_caches_[i].parent_ >= 0 ) {
+                int len = append_forked(i, tokens, id, mask, std::get<0>(match_result));
+                return {len, len};
+            }
+            int len = all_caches_[i].append(tokens, id, mask, std::get<0>(match_result), std::get<1>(match_result) );
+            return {len, len};
         }
 
-        tensor_t get_sub_cache(tensor_t kv_cache, int b, int l ) {
-            int ci = batched_caches_[b];
-            size_t offset = (size_t)l * cached_number * cached_tokens * hidden_size + ci * cached_tokens * hidden_size;
-            std::vector<size_t> sub_shape{(size_t)cached_tokens, (size_t)hidden_size};
+        std::tuple<int, int> do_append_h2o(int ci, const int tokens, const int* id, const int* mask, int matched_len) {
+            KVCacheEntry& entry = all_caches_[ci];
 
-            auto ret = kv_cache->op_view(kv_cache, offset, sub_shape);
-            return std::get<1>(ret);
+            int valid = tokens;
+            for (int i = 0; i < tokens; i++) {
+                if ( mask[i] == 0 ) {
+                    valid = i;
+                    break;
+                }
+            }
+            matched_len = std::min(matched_len, valid - 1);
+
+            // uncached tokens over all slots are the head of a too long prompt, evicted with all cached ones
+            int dropped = std::max(0, valid - matched_len - cached_tokens);
+            int target = std::min(budget_, cached_tokens - (valid - matched_len - dropped));
+
+            auto moves = entry.evict_h2o(matched_len, target, recent_);
+            for (int l = 0; l < cached_layer && moves.size() > 0; l++) {
+                tensor_t kc = get_entry_cache(kcache_, ci, l);
+                tensor_t vc = get_entry_cache(vcache_, ci, l);
+                for (size_t m = 0; m < moves.size(); m++) {
+                    std::vector<size_t> block_shape{(size_t)std::get<2>(moves[m]), (size_t)hidden_size};
+                    for (tensor_t c : {kc, vc}) {
+                        tensor_t src = std::get<1>(c->op_view(c, std::get<0>(moves[m]) * hidden_size, block_shape));
+                        tensor_t dst = std::get<1>(c->op_view(c, std::get<1>(moves[m]) * hidden_size, block_shape));
+                        dst->op_copy(dst, src);
+                    }
+                }
+            }
+
+            int skipped = entry.append_h2o(tokens, id, mask, matched_len, dropped);
+            return {skipped, entry.get_cached()};
         }
 
-        void do_update(int b, tensor_t full_, tensor_t new_, tensor_t cache_) {
-            int ci = batched_caches_[b];
-            all_caches_[ci].add_uncached(cache_, new_);
+        void do_score(tensor_t xll) {
+            const int batch = batched_caches_.size();
+            const int full_tokens = xll->shape()[3];
+            vt_assert( (int)xll->shape()[0] == batch, "attention score must has same batch with cache");
+            vt_assert( full_tokens == left_max + right_max, "attention score must has same tokens with cache");
+
+            std::vector<size_t> score_shape{(size_t)batch, (size_t)full_tokens};
+            tensor_t score = vt::create_host_float(score_shape);
+            score->op_zero(score);
+            xll->op_attn_score(xll, score);
+
+            for (int b = 0; b < batch; b++) {
+                KVCacheEntry& entry = all_caches_[ batched_caches_[b] ];
+                const float* s = (float *)score->device_data() + b * full_tokens;
+                int cached = entry.get_cached();
+                int uncached = entry.get_uncached();
+                for (int i = 0; i < cached; i++) {
+                    entry.score_[i] += s[left_max - cached + i];
+                }
+                for (int i = 0; i < uncached; i++) {
+                    entry.score_[cached + i] += s[left_max + i];
+                }
+            }
+        }
+
+        size_t offset_of(int ci, int l) {
+            return (size_t)l * cached_number * cached_tokens * hidden_size + (size_t)ci * cached_tokens * hidden_size;
+        }
 
-            int cached_len = all_caches_[ci].get_cached();
-            //int uncached_len = all_caches_[ci].get_uncached();
-            if ( cached_len > 0 ) {
-                int left_begin = left_max - cached_len;
+        tensor_t get_entry_cache(tensor_t kv_cache, int ci, int l) {
+            std::vector<size_t> sub_shape{(size_t)cached_tokens, (size_t)hidden_size};
+            return std::get<1>(kv_cache->op_view(kv_cache, offset_of(ci, l), sub_shape));
+        }
+
+        void do_update(int b, tensor_t full_, tensor_t new_, tensor_t kv_cache, int l) {
+            int ci = batched_caches_[b];
+            KVCacheEntry& entry = all_caches_[ci];
+            tensor_t cache_ = get_entry_cache(kv_cache, ci, l);
+            entry.add_uncached(cache_, new_);
+
+            int shared_len = entry.parent_ >= 0 ? entry.shared_ : 0;
+            int cached_len = entry.get_cached();
+            //int uncached_len = entry.get_uncached();
+            if ( shared_len + cached_len > 0 ) {
+                int left_begin = left_max - cached_len - shared_len;
                 vt_assert(left_begin >= 0, "Can't bhere!");
-                std::vector<size_t> left_shape{(size_t)cached_len, (size_t)hidden_size};
-                tensor_t left_ = std::get<1>(full_->op_view(full_, left_begin * hidden_size, left_shape));
 
-                all_caches_[ci].copy_cached(cache_, left_);
+                if ( shared_len > 0 ) {
+                    std::vector<size_t> shared_shape{(size_t)shared_len, (size_t)hidden_size};
+                    tensor_t shared_ = std::get<1>(full_->op_view(full_, left_begin * hidden_size, shared_shape));
+                    all_caches_[entry.parent_].copy_prefix( get_entry_cache(kv_cache, entry.parent_, l), shared_, shared_len);
+                }
+                if ( cached_len > 0 ) {
+                    std::vector<size_t> left_shape{(size_t)cached_len, (size_t)hidden_size};
+                    tensor_t left_ = std::get<1>(full_->op_view(full_, (left_begin + shared_len) * hidden_size, left_shape));
+                    entry.copy_cached(cache_, left_);
+                }
             }
 
             {
@@ -306,6 +799,8 @@ namespace nn {
             int cached_tokens = vcache->shape()[2];
             int hidden_size = vcache->shape()[3];
             EasyKVCache* cache = new EasyKVCache( hidden_size, cached_tokens, cached_number, cached_layer);
+            cache->kcache_ = kcache;
+            cache->vcache_ = vcache;
 
             // pass object's address to tensor
             std::vector<size_t> obj_shape;
@@ -328,6 +823,164 @@ namespace nn {
         NWORD_CREATOR_DEFINE_LR(EasyKVCacheReset)
     };
 
+    struct EasyKVCacheH2O : public NativeWord {
+        void run(Stack& stack) override {
+            int recent = stack.pop_number();
+            int budget = stack.pop_number();
+            tensor_t obj_t = stack.pop_tensor();
+
+            EasyKVCache* cache_man;
+            memcpy( (char *)&cache_man, (char *)obj_t->device_data(), sizeof(EasyKVCache *));
+            vt_assert( budget >= 0 && budget < cache_man->cached_tokens, "H2O budget must be less than cached tokens");
+            vt_assert( recent >= 0 && (budget == 0 || recent <= budget), "H2O recent window must be in budget");
+
+            cache_man->reset(true);
+            cache_man->budget_ = budget;
+            cache_man->recent_ = recent;
+        }
+        NWORD_CREATOR_DEFINE_LR(EasyKVCacheH2O)
+    };
+
+    struct EasyKVCacheScore : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t xll = stack.pop_tensor();
+            tensor_t obj_t = stack.pop_tensor();
+
+            EasyKVCache* cache_man;
+            memcpy( (char *)&cache_man, (char *)obj_t->device_data(), sizeof(EasyKVCache *));
+            if ( cache_man->budget_ > 0 ) {
+                cache_man->do_score(xll);
+            }
+        }
+        NWORD_CREATOR_DEFINE_LR(EasyKVCacheScore)
+    };
+
+    struct EasyKVCacheFork : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t src = stack.pop_tensor();
+            tensor_t obj_t = stack.pop_tensor();
+
+            EasyKVCache* cache_man;
+            memcpy( (char *)&cache_man, (char *)obj_t->device_data(), sizeof(EasyKVCache *));
+
+            vt_assert( src->is_host() && src->dtype() == DataType::Int, "nn.ezkv_fork need host int rows");
+            const int* r = (int *)src->device_data();
+            std::vector<int> rows(r, r + src->items());
+            cache_man->do_fork(rows);
+        }
+        NWORD_CREATOR_DEFINE_LR(EasyKVCacheFork)
+    };
+
+    // sampling n sequences from one prompt, the prompt's KV cache is shared by all of them
+    struct EasyKVCacheNBest : public NativeWord {
+        const int top_k = 32;
+
+        void run(Stack& stack) override {
+            bool first = stack.pop_number() != 0;
+            float temp = stack.pop_number();
+            int n = stack.pop_number();
+            tensor_t logits = stack.pop_tensor();
+            tensor_t obj_t = stack.pop_tensor();
+
+            EasyKVCache* cache_man;
+            memcpy( (char *)&cache_man, (char *)obj_t->device_data(), sizeof(EasyKVCache *));
+
+            const int rows = logits->shape()[0];
+            const int vocab = logits->shape()[1];
+            vt_assert( !first || rows == 1, "First n-best step must be one prompt row");
+            const int k = std::min(top_k, vocab);
+            std::vector<size_t> topk_shape{(size_t)rows, (size_t)k};
+            tensor_t ids = vt::create_host_int(topk_shape);
+            tensor_t lp = vt::create_host_float(topk_shape);
+            logits->op_logprob_topk(logits, ids, lp, temp);
+
+            // the prompt is forked at first step, else every row continues itself
+            const int samples = first ? n : 1;
+            std::vector<size_t> next_shape{(size_t)(rows * samples)};
+            tensor_t next = vt::create_host_int(next_shape);
+            std::vector<int> fork_rows;
+
+            std::uniform_real_distribution<> dist(0.0, 1.0);
+            for (int r = 0; r < rows; r++) {
+                const int* id = (int *)ids->device_data() + r * k;
+                const float* p = (float *)lp->device_data() + r * k;
+                float sum = 0.0;
+                for (int i = 0; i < k; i++) {
+                    sum += expf(p[i]);
+                }
+                for (int j = 0; j < samples; j++) {
+                    float randx = dist( *ComputingContext::rng ) * sum;
+                    int sel = k - 1;
+                    for (int i = 0; i < k; i++) {
+                        randx -= expf(p[i]);
+                        if ( randx <= 0 ) {
+                            sel = i;
+                            break;
+                        }
+                    }
+                    ((int *)next->device_data())[r * samples + j] = id[sel];
+                    fork_rows.push_back(r);
+                }
+            }
+            if ( samples > 1 ) {
+                cache_man->do_fork(fork_rows);
+            }
+            stack.push_tensor(next);
+        }
+        NWORD_CREATOR_DEFINE_LR(EasyKVCacheNBest)
+    };
+
+    // beam search step, output is {source row, token} for every beam
+    struct EasyKVCacheBeam : public NativeWord {
+        void run(Stack& stack) override {
+            int width = stack.pop_number();
+            tensor_t scores = stack.pop_tensor();
+            tensor_t logits = stack.pop_tensor();
+            tensor_t obj_t = stack.pop_tensor();
+
+            EasyKVCache* cache_man;
+            memcpy( (char *)&cache_man, (char *)obj_t->device_data(), sizeof(EasyKVCache *));
+
+            const int rows = logits->shape()[0];
+            vt_assert( scores->is_host() && scores->is_float() && (int)scores->items() >= width, "beam scores must be host float with width items");
+            vt_assert( rows == 1 || rows == width, "beam search input must be one prompt or all beams");
+
+            std::vector<size_t> topk_shape{(size_t)rows, (size_t)width};
+            tensor_t ids = vt::create_host_int(topk_shape);
+            tensor_t lp = vt::create_host_float(topk_shape);
+            logits->op_logprob_topk(logits, ids, lp, 1.0);
+
+            // one row means a new prompt, beam scores start from zero
+            float* beam = (float *)scores->device_data();
+            std::vector<std::tuple<float, int, int>> candidates;
+            for (int r = 0; r < rows; r++) {
+                float base = rows == 1 ? 0.0 : beam[r];
+                for (int i = 0; i < width; i++) {
+                    int ii = r * width + i;
+                    candidates.push_back({base + ((float *)lp->device_data())[ii], r, ((int *)ids->device_data())[ii]});
+                }
+            }
+            std::partial_sort(candidates.begin(), candidates.begin() + width, candidates.end(),
+                [](const std::tuple<float, int, int>& a, const std::tuple<float, int, int>& b) {
+                    return std::get<0>(a) > std::get<0>(b);
+                });
+
+            std::vector<size_t> next_shape{(size_t)width, 2};
+            tensor_t next = vt::create_host_int(next_shape);
+            int* out = (int *)next->device_data();
+            std::vector<int> fork_rows;
+            for (int i = 0; i < width; i++) {
+                beam[i] = std::get<0>(candidates[i]);
+                out[i * 2] = std::get<1>(candidates[i]);
+                out[i * 2 + 1] = std::get<2>(candidates[i]);
+                fork_rows.push_back( std::get<1>(candidates[i]) );
+            }
+            cache_man->do_fork(fork_rows);
+            stack.push_tensor(next);
+        }
+        NWORD_CREATOR_DEFINE_LR(EasyKVCacheBeam)
+    };
+
     struct EasyKVCacheMatch : public NativeWord {
         void run(Stack& stack) override {
             tensor_t _mask = stack.pop_tensor();
@@ -343,14 +996,17 @@ namespace nn {
             const int batch = mask_->shape()[0];
             const int tokens = mask_->shape()[1];
 
+            std::vector<int> left_skipped;
             std::vector<int> left_cached;
             std::vector<int> right_uncached;
             for (int b = 0; b < batch; b++) {
                 int* id = (int *)ids_->device_data() + b * tokens;
                 int* mask = (int *)mask_->device_data() + b * tokens;
 
-                int cached = cache_man->do_match(tokens, id, mask);
-                int uncached = tokens - cached;
+                auto matched = cache_man->do_match(tokens, id, mask);
+                int skipped = std::get<0>(matched);
+                int cached = std::get<1>(matched);
+                int uncached = tokens - skipped;
                 for ( int i = tokens - 1; i >= 0; i--) {
                     if ( mask[i] == 0 ) {
                         uncached = uncached - 1;
@@ -358,6 +1014,7 @@ namespace nn {
                         break;
                     }
                 }
+                left_skipped.push_back( skipped);
                 left_cached.push_back( cached);
                 right_uncached.push_back( uncached);
             }
@@ -382,10 +1039,10 @@ namespace nn {
                 int* id = (int *)ids_->device_data() + b * tokens;
                 int* nid = (int *)right_->device_data() + b * right_max;
 
-                int left_length = left_cached[b];
+                int left_skipped_ = left_skipped[b];
                 int right_length = right_uncached[b];
                 for (int i = 0; i < right_length; i++) {
-                    nid[i] = id[left_length + i];
+                    nid[i] = id[left_skipped_ + i];
                 }
                 for (int i = right_length; i < right_max; i++) {
                     nid[i] = id[tokens-1];
@@ -403,13 +1060,18 @@ namespace nn {
                 int* nm = (int *)left_->device_data() + b * (right_max + left_max);
 
                 int left_length = left_cached[b];
+                int left_skipped_ = left_skipped[b];
                 int right_length = right_uncached[b];
                 for (int i = 0; i < left_max - left_length; i++) {
                     nm[i] = 0;
                 }
-                for (int i = left_max - left_length;  i < left_max + right_length; i++) {
+                for (int i = left_max - left_length;  i < left_max; i++) {
                     int ii = i - (left_max - left_length);
-                    nm[i] = m[ii];
+                    // evicted tokens are gone, all kept tokens are visible
+                    nm[i] = (left_skipped_ == left_length) ? m[ii] : 1;
+                }
+                for (int i = left_max;  i < left_max + right_length; i++) {
+                    nm[i] = m[left_skipped_ + i - left_max];
                 }
                 for (int i = left_max + right_length; i < left_max + right_max;  i++) {
                     nm[i] = 0;
@@ -426,6 +1088,102 @@ namespace nn {
         NWORD_CREATOR_DEFINE_LR(EasyKVCacheMatch)
     };
 
+    // session handles bind KV cache entries, so a step of them sends only new tokens
+    struct EasyKVCacheOpen : public NativeWord {
+        void run(Stack& stack) override {
+            int window = stack.pop_number();
+            int handle = stack.pop_number();
+            tensor_t obj_t = stack.pop_tensor();
+
+            EasyKVCache* cache_man;
+            memcpy( (char *)&cache_man, (char *)obj_t->device_data(), sizeof(EasyKVCache *));
+            cache_man->open_session(handle, window);
+        }
+        NWORD_CREATOR_DEFINE_LR(EasyKVCacheOpen)
+    };
+
+    struct EasyKVCacheClose : public NativeWord {
+        void run(Stack& stack) override {
+            int handle = stack.pop_number();
+            tensor_t obj_t = stack.pop_tensor();
+
+            EasyKVCache* cache_man;
+            memcpy( (char *)&cache_man, (char *)obj_t->device_data(), sizeof(EasyKVCache *));
+            cache_man->close_session(handle);
+        }
+        NWORD_CREATOR_DEFINE_LR(EasyKVCacheClose)
+    };
+
+    // same layout with nn.ezkv_match, rows are sessions with lens_[b] new ids, the last one is sampled
+    struct EasyKVCacheSession : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t _mask = stack.pop_tensor();
+            tensor_t _ids = stack.pop_tensor();
+            tensor_t lens_ = stack.pop_tensor();
+            tensor_t ids_ = stack.pop_tensor();
+            tensor_t handles_ = stack.pop_tensor();
+            tensor_t obj_t = stack.pop_tensor();
+
+            EasyKVCache* cache_man;
+            memcpy( (char *)&cache_man, (char *)obj_t->device_data(), sizeof(EasyKVCache *));
+            cache_man->reset();
+
+            const int batch = ids_->shape()[0];
+            const int tokens = ids_->shape()[1];
+            const int* handles = (int *)handles_->device_data();
+            const int* lens = (int *)lens_->device_data();
+
+            std::vector<int> left_cached;
+            for (int b = 0; b < batch; b++) {
+                vt_assert( lens[b] > 0 && lens[b] <= tokens, "Session step must have new tokens");
+                int* id = (int *)ids_->device_data() + b * tokens;
+                left_cached.push_back( cache_man->session_append(handles[b], lens[b], id) );
+            }
+
+            int right_max = *std::max_element(lens, lens + batch);
+            int left_max = *std::max_element(left_cached.begin(), left_cached.end());
+
+            // force matrix shape has even token number
+            if ( right_max % 4 != 0) {
+                int padding = 4 - (right_max % 4);
+                right_max = right_max + padding;
+            }
+            cache_man->right_max = right_max;
+            cache_man->left_max = left_max;
+
+            std::vector<size_t> right_shape{(size_t)batch, (size_t)right_max};
+            std::vector<size_t> left_shape{(size_t)batch, (size_t)(left_max + right_max)};
+            tensor_t right_ = vt::create_host_int(right_shape);
+            tensor_t left_ = vt::create_host_int(left_shape);
+            for (int b = 0; b < batch; b++) {
+                int* id = (int *)ids_->device_data() + b * tokens;
+                int* nid = (int *)right_->device_data() + b * right_max;
+                int* nm = (int *)left_->device_data() + b * (left_max + right_max);
+                for (int i = 0; i < right_max; i++) {
+                    nid[i] = id[ std::min(i, lens[b] - 1) ];
+                }
+                for (int i = 0; i < left_max + right_max; i++) {
+                    int ii = i - left_max;
+                    if ( i < left_max ) {
+                        nm[i] = i >= left_max - left_cached[b] ? 1 : 0;
+                    } else {
+                        nm[i] = ii < lens[b] ? 1 : 0;
+                    }
+                }
+                nm[ left_max + lens[b] - 1 ] = 2;
+            }
+
+            tensor_t ids = std::get<1>(_ids->op_view(_ids, 0, right_shape));
+            ids->op_copy(ids, right_);
+            tensor_t mask = std::get<1>(_mask->op_view(_mask, 0, left_shape));
+            mask->op_copy(mask, left_);
+
+            stack.push_tensor(ids);
+            stack.push_tensor(mask);
+        }
+        NWORD_CREATOR_DEFINE_LR(EasyKVCacheSession)
+    };
+
     struct EasyKVCachePosition : public NativeWord {
         void run(Stack& stack) override {
             tensor_t _pos = stack.pop_tensor();
@@ -442,8 +1200,7 @@ namespace nn {
             int* p = (int *)pos_->device_data();
             for (int b = 0; b < batch; b++) {
                 int ci = cache_man->batched_caches_[b];
-                int seq = cache_man->all_caches_[ci].seq_ + cache_man->all_caches_[ci].get_cached();
-                p[b] = seq;
+                p[b] = cache_man->get_position(ci);
             }
             pos->op_copy(pos, pos_);
 
@@ -479,9 +1236,8 @@ namespace nn {
             for (int b = 0; b < batches; b++ ) {
                 tensor_t full_ = std::get<1>(kv_full->op_view(kv_full, b * full_tokens * hidden_size, full_shape));
                 tensor_t new_ = std::get<1>(kv_new->op_view(kv_new, b * new_tokens * hidden_size, new_shape));
-                tensor_t cache_ = cache_man->get_sub_cache(kv_cache, b, kv_layer);
                 //full_->op_zero(full_);
-                cache_man->do_update(b, full_, new_, cache_);
+                cache_man->do_update(b, full_, new_, kv_cache, kv_layer);
             }
         }
 
@@ -495,6 +1251,14 @@ void load_nn_kvcache(Enviroment& env) {
     env.insert_native_word("nn.ezkv_position", nn::EasyKVCachePosition::creator);
     env.insert_native_word("nn.ezkv_update", nn::EasyKVCacheUpdate::creator);
     env.insert_native_word("nn.ezkv_reset", nn::EasyKVCacheReset::creator);
+    env.insert_native_word("nn.ezkv_h2o", nn::EasyKVCacheH2O::creator);
+    env.insert_native_word("nn.ezkv_score", nn::EasyKVCacheScore::creator);
+    env.insert_native_word("nn.ezkv_fork", nn::EasyKVCacheFork::creator);
+    env.insert_native_word("nn.ezkv_nbest", nn::EasyKVCacheNBest::creator);
+    env.insert_native_word("nn.ezkv_beam", nn::EasyKVCacheBeam::creator);
+    env.insert_native_word("nn.ezkv_open", nn::EasyKVCacheOpen::creator);
+    env.insert_native_word("nn.ezkv_close", nn::EasyKVCacheClose::creator);
+    env.insert_native_word("nn.ezkv_session", nn::EasyKVCacheSession::creator);
 }
 
 }// end of namespace br
@@ -14,27 +14,45 @@ namespace op {
         }
         return shape;
     }
+    // fills caller's buffer, no allocation after the first time
+    void fetch_shape(Stack& stack, std::vector<size_t>& shape) {
+        size_t n = stack.pop_number();
+        shape.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            shape[n - 1 - i] = stack.pop_number();
+        }
+    }
+
+    // views made by one word are kept by name and rebound in place when it runs again,
+    // so rebuilding dynamic views every decoding step doesn't allocate.
+    struct ViewCache {
+        tensor_t view(const std::string& name, tensor_t parent, size_t offset, const std::vector<size_t>& shape) {
+            auto i = views_.find(name);
+            if ( i != views_.end() ) {
+                tensor_t v = i->second;
+                if ( v->dtype() == parent->dtype() && v->device_name() == parent->device_name() ) {
+                    if ( v->op_view_rebind(v, parent, offset, shape) == OP_OK ) {
+                        return v;
+                    }
+                }
+            }
+            auto ret = parent->op_view(parent, offset, shape);
+            tensor_t v = std::get<1>(ret);
+            views_[name] = v;
+            return v;
+        }
+    private:
+        std::map<std::string, tensor_t> views_;
+    };
     struct Sync : public NativeWord {
         void run(Stack& stack) override {
-#ifdef _USING_DEVICE_CUDA_
-            auto stream = vt::ComputingContext::cuda_stream;
-            CUDA_CHECK(cudaStreamSynchronize(stream));
-#endif
-#ifdef _USING_DEVICE_DCU_
-            auto stream = vt::ComputingContext::dcu_stream;
-            HIP_CHECK(hipStreamSynchronize(stream));
-#endif
-#ifdef _USING_DEVICE_COREX_
-            auto stream = vt::ComputingContext::corex_stream;
-            COREX_CHECK(cudaStreamSynchronize(stream));
-#endif
-
+            vt::ComputingContext::sync();
         }
         NWORD_CREATOR_DEFINE_LR(Sync)
     };
 
     struct CheckPoint : public NativeWord {
-        static std::chrono::time_point<std::chrono::high_resolution_clock> ck;
+        static thread_local std::chrono::time_point<std::chrono::high_resolution_clock> ck;
 
         void run(Stack& stack) override {
             int flag = stack.pop_number();
@@ -48,7 +66,177 @@ namespace op {
         }
         NWORD_CREATOR_DEFINE_LR(CheckPoint)
     };
-    std::chrono::time_point<std::chrono::high_resolution_clock> CheckPoint::ck;
+    thread_local std::chrono::time_point<std::chrono::high_resolution_clock> CheckPoint::ck;
+
+    struct MemTag : public NativeWord {
+        void run(Stack& stack) override {
+            const auto& name = stack.pop_string();
+            MemoryContext::use_tag(name.c_str());
+        }
+        NWORD_CREATOR_DEFINE_LR(MemTag)
+    };
+
+    struct MemArena : public NativeWord {
+        void run(Stack& stack) override {
+            bool huge_page = stack.pop_number() != 0;
+            size_t chunk_size = stack.pop_number();
+            const auto& name = stack.pop_string();
+            MemoryContext::set_allocator(name.c_str(), new ArenaAllocator(chunk_size, huge_page));
+        }
+        NWORD_CREATOR_DEFINE_LR(MemArena)
+    };
+
+    struct MemPool : public NativeWord {
+        void run(Stack& stack) override {
+            size_t max_cached = stack.pop_number();
+            const auto& name = stack.pop_string();
+            MemoryContext::set_allocator(name.c_str(), new PoolAllocator(max_cached));
+        }
+        NWORD_CREATOR_DEFINE_LR(MemPool)
+    };
+
+    // "interleave" or "shard" places the tag's blocks over NUMA nodes of the engine, "none" keeps its allocator
+    struct MemNuma : public NativeWord {
+        void run(Stack& stack) override {
+            const auto& policy = stack.pop_string();
+            const auto& name = stack.pop_string();
+            if ( policy == "none" ) {
+                return;
+            }
+            vt_assert(policy == "interleave" || policy == "shard", "NUMA policy must be none, interleave or shard");
+            ComputingContext::boot_numa();
+            MemoryContext::set_allocator(name.c_str(), new NumaAllocator(policy == "shard", ComputingContext::numa_nodes));
+        }
+        NWORD_CREATOR_DEFINE_LR(MemNuma)
+    };
+
+    struct MemStat : public NativeWord {
+        void run(Stack& stack) override {
+            const auto& name = stack.pop_string();
+            auto& tag = MemoryContext::query_tag(name.c_str());
+            stack.push_number(tag.current);
+            stack.push_number(tag.peak);
+        }
+        NWORD_CREATOR_DEFINE_LR(MemStat)
+    };
+
+    struct MemDump : public NativeWord {
+        void run(Stack& stack) override {
+            MemoryContext::dump();
+        }
+        NWORD_CREATOR_DEFINE_LR(MemDump)
+    };
+
+    // activation buffers are recorded until op.plan_arena, then created as views of the arena
+    struct PlanView : public NativeWord {
+        Enviroment* env_;
+        ViewCache views_;
+        std::vector<size_t> shape;
+        void run(Stack& stack) override {
+            fetch_shape(stack, shape);
+            const auto& name = stack.pop_string();
+            size_t items = 1;
+            for (size_t i = 0; i < shape.size(); i++) {
+                items *= shape[i];
+            }
+
+            auto& plan = env_->plan();
+            if ( plan.arena_ == nullptr ) {
+                auto& b = plan.buffers_[name];
+                vt_assert(b.parent_ == "", "Buffer is declared as alias already!");
+                b.size_ = std::max(b.size_, items);
+                return;
+            }
+
+            vt_assert(plan.buffers_.find(name) != plan.buffers_.end(), "Buffer isn't in the plan!");
+            auto& b = plan.buffers_[name];
+            vt_assert(items <= b.size_, "Buffer exceeds planned bounds!");
+            env_->hash().set(name, views_.view(name, plan.arena_, b.offset_, shape));
+        }
+        static NativeWord* creator(Enviroment& env) {
+            PlanView* wd = new PlanView();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct PlanAlias : public NativeWord {
+        Enviroment* env_;
+        ViewCache views_;
+        std::vector<size_t> shape;
+        void run(Stack& stack) override {
+            fetch_shape(stack, shape);
+            size_t offset = stack.pop_number();
+            const auto& parent = stack.pop_string();
+            const auto& name = stack.pop_string();
+
+            auto& plan = env_->plan();
+            if ( plan.arena_ == nullptr ) {
+                vt_assert(plan.buffers_.find(parent) != plan.buffers_.end(), "Alias of an unknown buffer!");
+                size_t items = 1;
+                for (size_t i = 0; i < shape.size(); i++) {
+                    items *= shape[i];
+                }
+                auto& b = plan.buffers_[name];
+                b.parent_ = parent;
+                b.size_ = std::max(b.size_, items);
+                b.offset_ = offset;
+                return;
+            }
+
+            tensor_t t = env_->hash().find_tensor(parent);
+            env_->hash().set(name, views_.view(name, t, offset, shape));
+        }
+        static NativeWord* creator(Enviroment& env) {
+            PlanAlias* wd = new PlanAlias();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct PlanBuild : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            auto dtype = DataType_from( stack.pop_string().c_str() );
+            const auto& word = stack.pop_string();
+
+            size_t peak = env_->build_plan(word, 64);
+            size_t total = 0;
+            auto& buffers = env_->plan().buffers_;
+            for (auto i = buffers.begin(); i != buffers.end(); i++) {
+                if ( i->second.parent_ == "" ) {
+                    total += i->second.size_;
+                }
+            }
+
+            size_t bytes = (dtype == DataType::FP16 || dtype == DataType::BF16) ? 2 : 4;
+            const double oneM = 1024.0 * 1024.0;
+            std::cout << "Planned activation memory: " << peak * bytes / oneM << " MB, "
+                      << total * bytes / oneM << " MB without reusing." << std::endl;
+            stack.push_number(peak);
+        }
+        static NativeWord* creator(Enviroment& env) {
+            PlanBuild* wd = new PlanBuild();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct PlanArena : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            tensor_t arena = stack.pop_tensor();
+            auto& plan = env_->plan();
+            vt_assert(plan.peak_ > 0, "Build plan before giving arena!");
+            vt_assert(arena->items() >= plan.peak_, "Arena is smaller than planned!");
+            plan.arena_ = arena;
+        }
+        static NativeWord* creator(Enviroment& env) {
+            PlanArena* wd = new PlanArena();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
 
 #ifdef _USING_DEVICE_CUDA_
     struct CudaEvent: public NativeWord {
@@ -92,7 +280,7 @@ namespace op {
     struct Create : public NativeWord {
         void run(Stack& stack) override {
             vt::DataType dtype = DataType_from( stack.pop_string().c_str() );
-            auto device = stack.pop_string();
+            const auto& device = stack.pop_string();
             std::vector<size_t> shape;
             int pq_s = 0;
             if ( dtype != vt::PQ ) {
@@ -291,7 +479,7 @@ namespace op {
 
     struct ViewAs : public NativeWord {
         void run(Stack& stack) override {
-            auto dtype = stack.pop_string();
+            const auto& dtype = stack.pop_string();
             auto shape = fetch_shape(stack);
             size_t offset = stack.pop_number();
             tensor_t t = stack.pop_tensor();
@@ -301,6 +489,20 @@ namespace op {
         NWORD_CREATOR_DEFINE_LR(ViewAs)
     };
 
+    // like op.view with strides list following shape, e.g. 0213 view of [B, T, H, D]
+    //   0 B H T D 4 T*H*D D H*D 1 4 op.view_strided
+    struct ViewStrided : public NativeWord {
+        void run(Stack& stack) override {
+            auto strides = fetch_shape(stack);
+            auto shape = fetch_shape(stack);
+            size_t offset = stack.pop_number();
+            tensor_t t = stack.pop_tensor();
+            auto ret = t->op_view_strided(t, offset, shape, strides);
+            stack.push_tensor( std::get<1>(ret) );
+        }
+        NWORD_CREATOR_DEFINE_LR(ViewStrided)
+    };
+
     struct Reshape : public NativeWord {
         void run(Stack& stack) override {
             auto shape = fetch_shape(stack);
@@ -534,6 +736,72 @@ namespace op {
         NWORD_CREATOR_DEFINE_LR(SiluProduct)
     };
 
+    // fused words are made by DAG's fusion pass, arguments are the two words' arguments in order
+    struct LinearAdd : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t out = stack.pop_tensor();
+            tensor_t c = stack.pop_tensor();
+            tensor_t a = stack.pop_tensor();
+            tensor_t y = stack.pop_tensor();
+            tensor_t b = stack.pop_tensor();
+            tensor_t w = stack.pop_tensor();
+            tensor_t x = stack.pop_tensor();
+
+            if ( a == y || c == y ) {
+                tensor_t r = a == y ? c : a;
+                if ( x->op_linear_add(x, w, b, y, r, out) == OP_OK ) {
+                    return;
+                }
+            }
+            x->op_linear(x, w, b, y);
+            a->op_add(a, c, out);
+        }
+        NWORD_CREATOR_DEFINE_LR(LinearAdd)
+    };
+
+    struct AddRMSnorm : public NativeWord {
+        void run(Stack& stack) override {
+            auto eps = stack.pop_number();
+            tensor_t y = stack.pop_tensor();
+            tensor_t norm2 = stack.pop_tensor();
+            tensor_t scale = stack.pop_tensor();
+            tensor_t x = stack.pop_tensor();
+            tensor_t c = stack.pop_tensor();
+            tensor_t b = stack.pop_tensor();
+            tensor_t a = stack.pop_tensor();
+
+            if ( x == c ) {
+                if ( a->op_add_rmsnorm(a, b, c, scale, norm2, y, eps) == OP_OK ) {
+                    return;
+                }
+            }
+            a->op_add(a, b, c);
+            x->op_rmsnorm(x, scale, norm2, y, eps);
+        }
+        NWORD_CREATOR_DEFINE_LR(AddRMSnorm)
+    };
+
+    struct LinearSiluProduct : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t out = stack.pop_tensor();
+            tensor_t in = stack.pop_tensor();
+            tensor_t act = stack.pop_tensor();
+            tensor_t y = stack.pop_tensor();
+            tensor_t b = stack.pop_tensor();
+            tensor_t w = stack.pop_tensor();
+            tensor_t x = stack.pop_tensor();
+
+            if ( act == y ) {
+                if ( x->op_linear_silu_product(x, w, b, y, in, out) == OP_OK ) {
+                    return;
+                }
+            }
+            x->op_linear(x, w, b, y);
+            act->op_silu_product(act, in, out);
+        }
+        NWORD_CREATOR_DEFINE_LR(LinearSiluProduct)
+    };
+
     struct AllLogits : public NativeWord {
         void run(Stack& stack) override {
             tensor_t out = stack.pop_tensor();
@@ -704,6 +972,16 @@ namespace io {
         NWORD_CREATOR_DEFINE_LR(Load)
     };
 
+    struct MMap : public NativeWord {
+        void run(Stack& stack) override {
+            bool populate = stack.pop_boolean();
+            std::string fileName = stack.pop_string();
+            tensor_t x = stack.pop_tensor();
+            x->io_mmap(x, fileName.c_str(), populate);
+        }
+        NWORD_CREATOR_DEFINE_LR(MMap)
+    };
+
     struct Save : public NativeWord {
         void run(Stack& stack) override {
             std::string fileName = stack.pop_string();
@@ -805,11 +1083,71 @@ namespace io {
         NWORD_CREATOR_DEFINE_LR(PipeWrite)
     };
 
+    // tensors between pipeline stages, through shared memory rings ( or pipes ) of forked workers
+    struct PipeSend : public NativeWord {
+        void run(Stack& stack) override {
+            int dst = stack.pop_number();
+            tensor_t x = stack.pop_tensor();
+            x->io_pipe_send(x, dst);
+        }
+        NWORD_CREATOR_DEFINE_LR(PipeSend)
+    };
+
+    struct PipeRecv : public NativeWord {
+        void run(Stack& stack) override {
+            int source = stack.pop_number();
+            tensor_t x = stack.pop_tensor();
+            x->io_pipe_recv(x, source);
+        }
+        NWORD_CREATOR_DEFINE_LR(PipeRecv)
+    };
+
+}
+
+// flops of one call for profiler, arguments are in pushed order
+namespace cost {
+    double items(std::vector<Cell>& args, size_t i) {
+        return args[i].as_tensor()->items();
+    }
+    double linear(std::vector<Cell>& args) {
+        return 2.0 * items(args, 0) * args[1].as_tensor()->shape()[0];
+    }
+    double elementwise(std::vector<Cell>& args) {
+        return items(args, 0);
+    }
+    double rmsnorm(std::vector<Cell>& args) {
+        return 4.0 * items(args, 0);
+    }
+    double softmax(std::vector<Cell>& args) {
+        return 5.0 * items(args, 0);
+    }
+    double silu_product(std::vector<Cell>& args) {
+        return 5.0 * items(args, 0);
+    }
+    double querykey(std::vector<Cell>& args) {
+        return 2.0 * items(args, 2) * args[0].as_tensor()->shape()[-1];
+    }
+    double attn(std::vector<Cell>& args) {
+        return 2.0 * items(args, 0) * args[2].as_tensor()->shape()[-1];
+    }
+    double none(std::vector<Cell>& args) {
+        return 0.0;
+    }
+    double linear_add(std::vector<Cell>& args) {
+        return linear(args) + items(args, 3);
+    }
+    double add_rmsnorm(std::vector<Cell>& args) {
+        return 5.0 * items(args, 0);
+    }
+    double linear_silu_product(std::vector<Cell>& args) {
+        return linear(args) + 5.0 * items(args, 3);
+    }
 }
 
 void load_nn_operators(Enviroment& env) {
     env.insert_native_word("io.dump", io::Dump::creator );
     env.insert_native_word("io.load", io::Load::creator );
+    env.insert_native_word("io.mmap", io::MMap::creator );
     env.insert_native_word("io.save", io::Save::creator );
 
     env.insert_native_word("io.mpi_rank", io::MPIRank::creator );
@@ -822,9 +1160,21 @@ void load_nn_operators(Enviroment& env) {
     env.insert_native_word("io.nccl.recv", io::NcclRecv::creator );
     env.insert_native_word("io.pipe.read", io::PipeRead::creator );
     env.insert_native_word("io.pipe.write", io::PipeWrite::creator );
+    env.insert_native_word("io.pipe.send", io::PipeSend::creator );
+    env.insert_native_word("io.pipe.recv", io::PipeRecv::creator );
 
     env.insert_native_word("op.sync", op::Sync::creator );
     env.insert_native_word("op.check", op::CheckPoint::creator );
+    env.insert_native_word("op.mem_tag", op::MemTag::creator );
+    env.insert_native_word("op.mem_arena", op::MemArena::creator );
+    env.insert_native_word("op.mem_pool", op::MemPool::creator );
+    env.insert_native_word("op.mem_numa", op::MemNuma::creator );
+    env.insert_native_word("op.mem_stat", op::MemStat::creator );
+    env.insert_native_word("op.mem_dump", op::MemDump::creator );
+    env.insert_native_word("op.plan_view", op::PlanView::creator );
+    env.insert_native_word("op.plan_alias", op::PlanAlias::creator );
+    env.insert_native_word("op.plan_build", op::PlanBuild::creator );
+    env.insert_native_word("op.plan_arena", op::PlanArena::creator );
 #if _USING_DEVICE_CUDA_
     env.insert_native_word("op.cuda_event", op::CudaEvent::creator );
 #endif
@@ -840,6 +1190,7 @@ void load_nn_operators(Enviroment& env) {
     env.insert_native_word("op.causal_mask", op::CausalMask::creator );
     env.insert_native_word("op.scale", op::Scale::creator );
     env.insert_native_word("op.view", op::View::creator );
+    env.insert_native_word("op.view_strided", op::ViewStrided::creator );
     env.insert_native_word("op.view_as", op::ViewAs::creator );
     env.insert_native_word("op.reshape", op::Reshape::creator );
     env.insert_native_word("op.quantize", op::Quantize::creator );
@@ -862,6 +1213,52 @@ void load_nn_operators(Enviroment& env) {
     env.insert_native_word("op.xattn", op::XAttn::creator);
     env.insert_native_word("op.gelu", op::Gelu::creator);
     env.insert_native_word("op.silu_product", op::SiluProduct::creator);
+    env.insert_native_word("op.linear_add", op::LinearAdd::creator);
+    env.insert_native_word("op.add_rmsnorm", op::AddRMSnorm::creator);
+    env.insert_native_word("op.linear_silu_product", op::LinearSiluProduct::creator);
+
+    env.insert_native_cost("op.copy", 2, cost::none);
+    env.insert_native_cost("op.convert", 2, cost::none);
+    env.insert_native_cost("op.linear", 4, cost::linear);
+    env.insert_native_cost("op.rmsnorm", 5, cost::rmsnorm);
+    env.insert_native_cost("op.rotary_embed", 4, cost::elementwise);
+    env.insert_native_cost("op.transpose_0213", 2, cost::none);
+    env.insert_native_cost("op.add", 3, cost::elementwise);
+    env.insert_native_cost("op.mul", 3, cost::elementwise);
+    env.insert_native_cost("op.querykey", 3, cost::querykey);
+    env.insert_native_cost("op.softmax", 2, cost::softmax);
+    env.insert_native_cost("op.attn", 3, cost::attn);
+    env.insert_native_cost("op.gelu", 2, cost::softmax);
+    env.insert_native_cost("op.silu_product", 3, cost::silu_product);
+    env.insert_native_cost("op.linear_add", 7, cost::linear_add);
+    env.insert_native_cost("op.add_rmsnorm", 8, cost::add_rmsnorm);
+    env.insert_native_cost("op.linear_silu_product", 7, cost::linear_silu_product);
+
+    env.insert_pure_word("op.get_shape");
+    env.insert_pure_word("op.view");
+    env.insert_pure_word("op.view_strided");
+    env.insert_pure_word("op.view_as");
+    env.insert_pure_word("op.null");
+
+    env.insert_native_effect("op.embed", 3, {2});
+    env.insert_native_effect("op.copy", 2, {0});
+    env.insert_native_effect("op.convert", 2, {0});
+    env.insert_native_effect("op.linear", 4, {3});
+    env.insert_native_effect("op.rmsnorm", 5, {2, 3});
+    env.insert_native_effect("op.rotary_embed", 4, {3});
+    env.insert_native_effect("op.transpose_0213", 2, {1});
+    env.insert_native_effect("op.add", 3, {2});
+    env.insert_native_effect("op.mul", 3, {2});
+    env.insert_native_effect("op.querykey", 3, {2});
+    env.insert_native_effect("op.softmax", 2, {1});
+    env.insert_native_effect("op.attn", 3, {2});
+    env.insert_native_effect("op.gelu", 2, {1});
+    env.insert_native_effect("op.silu_product", 3, {2});
+    env.insert_native_effect("op.all_logits", 4, {3}, 1);
+    env.insert_native_effect("op.linear_add", 7, {3, 6});
+    env.insert_native_effect("op.add_rmsnorm", 8, {2, 5, 6});
+    env.insert_native_effect("op.linear_silu_product", 7, {3, 6});
+
     env.insert_native_word("op.all_logits", op::AllLogits::creator);
     env.insert_native_word("op.sampling_top1", op::SamplingTop1::creator);
     env.insert_native_word("op.sampling_top3", op::SamplingTop3::creator);
@@ -0,0 +1,1225 @@
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include <deque>
+#include <thread>
+#include <functional>
+#include <atomic>
+#include <condition_variable>
+
+#include "tensortype.hpp"
+#include "context.hpp"
+#include "dag.hpp"
+
+namespace vt {
+
+namespace io {
+    // Packed weight container, all numbers are little endian u64 except string & dim lengths (u32)
+    //   "VTPACK01" count payload_begin
+    //   count x { name dtype dim dims[dim] offset size checksum }
+    //   payloads, every one begins at a page boundary
+    struct WeightPack {
+        static constexpr const char* magic = "VTPACK01";
+        static const size_t page = 4096;
+
+        struct Entry {
+            std::string name;
+            std::string dtype;          // "raw" when file suffix isn't a dtype
+            std::vector<size_t> shape;
+            size_t offset;
+            size_t size;
+            uint64_t checksum;
+            int state;                  // 0 pending, 1 verified, -1 checksum failed
+        };
+
+        static uint64_t checksum(const char* d, size_t n, uint64_t h = 14695981039346656037ull) {
+            const uint64_t prime = 1099511628211ull;
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                uint64_t w;
+                memcpy(&w, d + i, 8);
+                h = (h ^ w) * prime;
+            }
+            for (; i < n; i++) {
+                h = (h ^ (uint8_t)d[i]) * prime;
+            }
+            return h;
+        }
+
+        static size_t round_page(size_t s) {
+            return (s + page - 1) / page * page;
+        }
+
+        // payload writes entry's bytes into stream and returns its checksum
+        using PayloadWriter = std::function<uint64_t(Entry& e, std::ostream& os)>;
+        static void write(const std::string& fileName, std::vector<Entry>& entries, PayloadWriter payload);
+        static void pack_dir(const std::string& dir, const std::string& fileName);
+
+        // threads == 0 disables prefetching, entries are read and verified when loading
+        WeightPack(const std::string& fileName, int threads);
+        ~WeightPack();
+
+        void start(int threads);
+        bool has(const std::string& name) {
+            return index_.find(name) != index_.end();
+        }
+        std::vector<Entry>& entries() {
+            return entries_;
+        }
+
+        Entry& find(const std::string& name);
+        Entry& wait(const std::string& name);
+        void read(Entry& e, char* dst, bool drop_cache);
+        void load(tensor_t t, const std::string& name);
+
+    private:
+        void prefetch(int i, int threads);
+
+        int fd_;
+        char* base_;
+        size_t size_;
+        std::vector<Entry> entries_;
+        std::map<std::string, size_t> index_;
+
+        std::mutex mt_;
+        std::condition_variable cv_;
+        std::vector<std::thread> workers_;
+        ComputingContext::Engine* engine_;
+    };
+
+    namespace _ {
+        void write_u32(std::ostream& os, uint32_t v) {
+            os.write((const char *)&v, sizeof(v));
+        }
+        void write_u64(std::ostream& os, uint64_t v) {
+            os.write((const char *)&v, sizeof(v));
+        }
+        void write_str(std::ostream& os, const std::string& s) {
+            write_u32(os, s.size());
+            os.write(s.c_str(), s.size());
+        }
+        uint32_t read_u32(const char*& p) {
+            uint32_t v;
+            memcpy(&v, p, sizeof(v));
+            p += sizeof(v);
+            return v;
+        }
+        uint64_t read_u64(const char*& p) {
+            uint64_t v;
+            memcpy(&v, p, sizeof(v));
+            p += sizeof(v);
+            return v;
+        }
+        std::string read_str(const char*& p) {
+            uint32_t n = read_u32(p);
+            std::string s(p, n);
+            p += n;
+            return s;
+        }
+        std::string basename(const std::string& name) {
+            auto pos = name.rfind('/');
+            if ( pos == std::string::npos ) {
+                return name;
+            }
+            return name.substr(pos + 1);
+        }
+    }
+
+    void WeightPack::write(const std::string& fileName, std::vector<Entry>& entries, PayloadWriter payload) {
+        size_t header = 8 + 8 + 8;
+        for (auto& e : entries) {
+            header += 4 + e.name.size() + 4 + e.dtype.size() + 4 + 8 * e.shape.size() + 8 * 3;
+        }
+        size_t offset = round_page(header);
+        for (auto& e : entries) {
+            e.offset = offset;
+            offset = round_page(offset + e.size);
+        }
+
+        std::ofstream wf(fileName, std::ios::out | std::ios::binary);
+        vt_assert(wf.is_open(), "Can't create pack file");
+
+        // payloads first, checksums are known after writing
+        for (auto& e : entries) {
+            wf.seekp(e.offset);
+            e.checksum = payload(e, wf);
+        }
+        if ( offset > (size_t)wf.tellp() ) {
+            wf.seekp(offset - 1);
+            wf.put(0);
+        }
+
+        wf.seekp(0);
+        wf.write(magic, 8);
+        _::write_u64(wf, entries.size());
+        _::write_u64(wf, round_page(header));
+        for (auto& e : entries) {
+            _::write_str(wf, e.name);
+            _::write_str(wf, e.dtype);
+            _::write_u32(wf, e.shape.size());
+            for (auto s : e.shape) {
+                _::write_u64(wf, s);
+            }
+            _::write_u64(wf, e.offset);
+            _::write_u64(wf, e.size);
+            _::write_u64(wf, e.checksum);
+        }
+        wf.close();
+        vt_assert(!wf.fail(), "Write pack file failed");
+    }
+
+    void WeightPack::pack_dir(const std::string& dir, const std::string& fileName) {
+        std::vector<Entry> entries;
+        DIR* d = opendir(dir.c_str());
+        if ( d == nullptr ) {
+            std::cout << "Can't open " << dir << std::endl;
+            vt_panic("Can't open weights directory");
+        }
+        for (struct dirent* e = readdir(d); e != nullptr; e = readdir(d)) {
+            std::string path = dir + "/" + e->d_name;
+            struct stat st;
+            if ( stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ) {
+                continue;
+            }
+            Entry entry;
+            entry.name = e->d_name;
+            entry.size = st.st_size;
+
+            // existing layout is raw bytes, dtype comes from suffix like attn.query.weight.fp16
+            entry.dtype = "raw";
+            auto pos = entry.name.rfind('.');
+            std::string suffix = pos == std::string::npos ? "" : entry.name.substr(pos + 1);
+            for ( auto dt : {"float", "fp16", "bf16", "int", "q8", "q4", "pq"} ) {
+                if ( suffix == dt ) {
+                    entry.dtype = dt;
+                }
+            }
+            size_t item = 1;
+            if ( entry.dtype == "float" || entry.dtype == "int" ) {
+                item = 4;
+            } else if ( entry.dtype == "fp16" || entry.dtype == "bf16" ) {
+                item = 2;
+            }
+            entry.shape.push_back( entry.size / item );
+            entries.push_back(entry);
+        }
+        closedir(d);
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+            return a.name < b.name;
+        });
+
+        std::vector<char> buf(16 * 1024 * 1024);
+        write(fileName, entries, [&](Entry& e, std::ostream& wf) {
+            std::ifstream inf(dir + "/" + e.name, std::ios::binary);
+            uint64_t h = 14695981039346656037ull;
+            for (size_t done = 0; done < e.size; ) {
+                size_t n = std::min(buf.size(), e.size - done);
+                size_t ret = inf.read(buf.data(), n).gcount();
+                vt_assert(ret == n, "Read weight file failed");
+                h = checksum(buf.data(), n, h);
+                wf.write(buf.data(), n);
+                done += n;
+            }
+            return h;
+        });
+
+        std::cout << "Packed " << entries.size() << " tensors into " << fileName << std::endl;
+    }
+
+    WeightPack::WeightPack(const std::string& fileName, int threads) {
+        fd_ = open(fileName.c_str(), O_RDONLY);
+        if ( fd_ < 0 ) {
+            std::cout << "Can't open " << fileName << std::endl;
+            vt_panic("Can't open pack file");
+        }
+        struct stat st;
+        vt_assert( fstat(fd_, &st) == 0, "fstat pack file failed");
+        size_ = st.st_size;
+        vt_assert( size_ >= 24, "Pack file is truncated");
+
+        base_ = (char *)mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+        vt_assert( base_ != MAP_FAILED, "mmap pack file failed");
+        vt_assert( memcmp(base_, magic, 8) == 0, "Not a weight pack file");
+
+        const char* p = base_ + 8;
+        size_t count = _::read_u64(p);
+        size_t payload = _::read_u64(p);
+        vt_assert( payload <= size_, "Pack file is truncated");
+        for (size_t i = 0; i < count; i++) {
+            Entry e;
+            e.name = _::read_str(p);
+            e.dtype = _::read_str(p);
+            uint32_t dim = _::read_u32(p);
+            for (uint32_t j = 0; j < dim; j++) {
+                e.shape.push_back( _::read_u64(p) );
+            }
+            e.offset = _::read_u64(p);
+            e.size = _::read_u64(p);
+            e.checksum = _::read_u64(p);
+            e.state = 0;
+            vt_assert( p <= base_ + payload, "Pack header is broken");
+            vt_assert( e.offset % page == 0 && e.offset + e.size <= size_, "Pack entry is out of file");
+            index_[e.name] = entries_.size();
+            entries_.push_back(e);
+        }
+
+        // workers run with the engine of opening thread
+        engine_ = ComputingContext::capture();
+        start(threads);
+    }
+
+    void WeightPack::start(int threads) {
+        vt_assert(workers_.size() == 0, "Pack prefetching is started already");
+        for (int i = 0; i < threads; i++) {
+            workers_.push_back( std::thread(&WeightPack::prefetch, this, i, threads) );
+        }
+    }
+
+    WeightPack::~WeightPack() {
+        for (auto& w : workers_) {
+            w.join();
+        }
+        delete engine_;
+        munmap(base_, size_);
+        close(fd_);
+    }
+
+    // entries are read in file order by interleaved workers, so the disk sees parallel sequential streams
+    void WeightPack::prefetch(int i, int threads) {
+        ComputingContext::bind(engine_);
+
+        std::vector<char> buf(8 * 1024 * 1024);
+        for (size_t k = i; k < entries_.size(); k += threads) {
+            auto& e = entries_[k];
+            uint64_t h = 14695981039346656037ull;
+            for (size_t done = 0; done < e.size; ) {
+                size_t n = std::min(buf.size(), e.size - done);
+                ssize_t ret = pread(fd_, buf.data(), n, e.offset + done);
+                if ( ret <= 0 ) {
+                    break;
+                }
+                h = checksum(buf.data(), ret, h);
+                done += ret;
+            }
+
+            std::lock_guard<std::mutex> lk(mt_);
+            e.state = (h == e.checksum) ? 1 : -1;
+            cv_.notify_all();
+        }
+    }
+
+    WeightPack::Entry& WeightPack::find(const std::string& name) {
+        auto key = _::basename(name);
+        if ( index_.find(key) == index_.end() ) {
+            std::cout << "Can't find " << key << " in pack" << std::endl;
+            vt_panic("Can't find tensor in pack");
+        }
+        return entries_[ index_[key] ];
+    }
+
+    WeightPack::Entry& WeightPack::wait(const std::string& name) {
+        auto& e = find(name);
+
+        std::unique_lock<std::mutex> lk(mt_);
+        cv_.wait(lk, [&e]{ return e.state != 0; });
+        if ( e.state != 1 ) {
+            std::cout << "Checksum of " << e.name << " doesn't match" << std::endl;
+            vt_panic("Pack entry is broken");
+        }
+        return e;
+    }
+
+    void WeightPack::read(Entry& e, char* dst, bool drop_cache) {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t done = 0; done < e.size; ) {
+            ssize_t ret = pread(fd_, dst + done, e.size - done, e.offset + done);
+            vt_assert(ret > 0, "Read pack file failed");
+            h = checksum(dst + done, ret, h);
+            done += ret;
+        }
+        if ( h != e.checksum ) {
+            std::cout << "Checksum of " << e.name << " doesn't match" << std::endl;
+            vt_panic("Pack entry is broken");
+        }
+        if ( drop_cache ) {
+            posix_fadvise(fd_, e.offset, e.size, POSIX_FADV_DONTNEED);
+        }
+    }
+
+    void WeightPack::load(tensor_t t, const std::string& name) {
+        auto& e = workers_.size() > 0 ? wait(name) : find(name);
+        if ( e.dtype != "raw" ) {
+            vt_assert( e.dtype == DataType_name(t->dtype()), "dtype of pack entry dont't match tensor");
+        }
+        size_t s = std::get<1>(t->op_sizeof(t));
+        vt_assert( s == e.size, "size of pack entry dont't match tensor");
+
+        if ( workers_.size() == 0 && t->is_host() ) {
+            read(e, (char *)t->device_data(), false);
+            return;
+        }
+        if ( workers_.size() == 0 ) {
+            std::vector<char> staging(e.size);
+            read(e, staging.data(), false);
+            std::vector<size_t> shape = t->shape().vec();
+            tensor_t src = create_host_view(t->dtype(), shape, staging.data());
+            t->op_copy(t, src);
+            return;
+        }
+
+        // page cache is filled by prefetch, copy from the mapping through a host view
+        std::vector<size_t> shape = t->shape().vec();
+        tensor_t src = create_host_view(t->dtype(), shape, base_ + e.offset);
+        t->op_copy(t, src);
+    }
+
+    struct PackDir : public NativeWord {
+        void run(Stack& stack) override {
+            const auto& fileName = stack.pop_string();
+            const auto& dir = stack.pop_string();
+            WeightPack::pack_dir(dir, fileName);
+        }
+        NWORD_CREATOR_DEFINE_LR(PackDir)
+    };
+
+    struct PackOpen : public NativeWord {
+        void run(Stack& stack) override {
+            int threads = stack.pop_number();
+            const auto& fileName = stack.pop_string();
+            WeightPack* pack = new WeightPack(fileName, threads);
+
+            // pass object's address to tensor
+            std::vector<size_t> obj_shape;
+            obj_shape.push_back( sizeof(WeightPack *) );
+            tensor_t obj_t = vt::create_host_int(obj_shape);
+            memcpy((char *)obj_t->device_data(), (char *)&pack, sizeof(WeightPack *));
+            stack.push_tensor(obj_t);
+        }
+        NWORD_CREATOR_DEFINE_LR(PackOpen)
+    };
+
+    // same order with io.load, so "pack" @ io.pack_load can replace it
+    struct PackLoad : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t obj_t = stack.pop_tensor();
+            const auto& name = stack.pop_string();
+            tensor_t x = stack.pop_tensor();
+
+            WeightPack* pack;
+            memcpy( (char *)&pack, (char *)obj_t->device_data(), sizeof(WeightPack *));
+            pack->load(x, name);
+        }
+        NWORD_CREATOR_DEFINE_LR(PackLoad)
+    };
+
+    struct PackClose : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t obj_t = stack.pop_tensor();
+
+            WeightPack* pack;
+            memcpy( (char *)&pack, (char *)obj_t->device_data(), sizeof(WeightPack *));
+            delete pack;
+        }
+        NWORD_CREATOR_DEFINE_LR(PackClose)
+    };
+
+    // Layers are bound in order 0, 1, ... layers-1, 0, 1 ... as steps of one endless sequence, step K
+    // holds layer K % layers in slot K % depth, slots are weight sets created by DAG as "S0.", "S1." ...
+    // while step K computes, the other slots are filled by workers with following steps, so depth
+    // needn't divide layers.
+    struct LayerStream {
+        LayerStream(Enviroment* env, WeightPack* pack, const std::string& prefix, int layers, int depth) :
+            env_(env), pack_(pack), prefix_(prefix), layers_(layers), depth_(depth), step_(0), stop_(false) {
+            vt_assert(depth_ >= 1 && depth_ <= layers_, "Stream depth must be in [1, layers]");
+            slots_.resize(depth_, -1);
+            pending_.resize(depth_, 0);
+
+            // workers copy to device with the engine of opening thread
+            engine_ = ComputingContext::capture();
+            for (int i = 0; i < depth_; i++) {
+                workers_.push_back( std::thread(&LayerStream::work, this) );
+            }
+        }
+        ~LayerStream() {
+            {
+                std::lock_guard<std::mutex> lk(mt_);
+                stop_ = true;
+                cv_.notify_all();
+            }
+            for (auto& w : workers_) {
+                w.join();
+            }
+            delete engine_;
+        }
+
+        void add_weight(const std::string& name, const std::string& file) {
+            weights_.push_back( {name, file} );
+        }
+
+        // waiting current step's slot, then binding slot tensors to plain names like sync_layer_clone
+        void bind(int layer) {
+            int s = step_ % depth_;
+            {
+                std::unique_lock<std::mutex> lk(mt_);
+                vt_assert(step_ % layers_ == layer, "Stream layers must be bound in order");
+                if ( slots_[s] != step_ ) {
+                    vt_assert(slots_[s] == -1, "Stream slot is still used by other layer");
+                    schedule(step_);
+                }
+                for (int i = 1; i < depth_; i++) {
+                    if ( slots_[(step_ + i) % depth_] == -1 ) {
+                        schedule(step_ + i);
+                    }
+                }
+                cv_.wait(lk, [this, s]{ return pending_[s] == 0; });
+            }
+
+            auto& hash = env_->hash();
+            std::string slot = "S" + std::to_string(s) + ".";
+            for (auto& w : weights_) {
+                hash.set(w.first, hash.find_tensor(slot + w.first));
+            }
+        }
+
+        // layer is computed, its slot is refilled with step + depth ( next forward wraps around )
+        void next(int layer) {
+            std::lock_guard<std::mutex> lk(mt_);
+            int s = step_ % depth_;
+            vt_assert(step_ % layers_ == layer && slots_[s] == step_ && pending_[s] == 0, "Stream next without bind");
+            slots_[s] = -1;
+            schedule(step_ + depth_);
+            step_++;
+        }
+
+    private:
+        struct Job {
+            int slot;
+            tensor_t target;
+            std::string file;
+        };
+
+        // mt_ is held
+        void schedule(int64_t step) {
+            int s = step % depth_;
+            slots_[s] = step;
+            std::string slot = "S" + std::to_string(s) + ".";
+            std::string file = prefix_ + std::to_string(step % layers_) + ".";
+            for (auto& w : weights_) {
+                jobs_.push_back( {s, env_->hash().find_tensor(slot + w.first), file + w.second} );
+                pending_[s]++;
+            }
+            cv_.notify_all();
+        }
+
+        void work() {
+            ComputingContext::bind(engine_);
+
+            std::vector<char> staging;
+            for (;;) {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lk(mt_);
+                    cv_.wait(lk, [this]{ return stop_ || jobs_.size() > 0; });
+                    if ( stop_ ) {
+                        return;
+                    }
+                    job = jobs_.front();
+                    jobs_.pop_front();
+                }
+
+                // weights are read once per pass, so they are dropped from page cache after reading
+                auto& e = pack_->find(job.file);
+                tensor_t t = job.target;
+                vt_assert( std::get<1>(t->op_sizeof(t)) == e.size, "size of pack entry dont't match tensor");
+                if ( t->is_host() ) {
+                    pack_->read(e, (char *)t->device_data(), true);
+                } else {
+                    staging.resize(e.size);
+                    pack_->read(e, staging.data(), true);
+                    std::vector<size_t> shape = t->shape().vec();
+                    tensor_t src = create_host_view(t->dtype(), shape, staging.data());
+                    t->op_copy(t, src);
+                }
+
+                std::lock_guard<std::mutex> lk(mt_);
+                pending_[job.slot]--;
+                cv_.notify_all();
+            }
+        }
+
+        Enviroment* env_;
+        WeightPack* pack_;
+        const std::string prefix_;
+        const int layers_;
+        const int depth_;
+        ComputingContext::Engine* engine_;
+
+        std::vector<std::pair<std::string, std::string>> weights_;
+        int64_t step_;                  // step being bound or computed
+        std::vector<int64_t> slots_;    // step held by each slot, -1 is free
+        std::vector<int> pending_;      // jobs not finished of each slot
+
+        bool stop_;
+        std::deque<Job> jobs_;
+        std::mutex mt_;
+        std::condition_variable cv_;
+        std::vector<std::thread> workers_;
+    };
+
+    struct StreamOpen : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            int depth = stack.pop_number();
+            int layers = stack.pop_number();
+            const auto& prefix = stack.pop_string();
+            tensor_t pack_t = stack.pop_tensor();
+
+            WeightPack* pack;
+            memcpy( (char *)&pack, (char *)pack_t->device_data(), sizeof(WeightPack *));
+            LayerStream* stream = new LayerStream(env_, pack, prefix, layers, depth);
+
+            // pass object's address to tensor
+            std::vector<size_t> obj_shape;
+            obj_shape.push_back( sizeof(LayerStream *) );
+            tensor_t obj_t = vt::create_host_int(obj_shape);
+            memcpy((char *)obj_t->device_data(), (char *)&stream, sizeof(LayerStream *));
+            stack.push_tensor(obj_t);
+        }
+        static NativeWord* creator(Enviroment& env) {
+            StreamOpen* wd = new StreamOpen();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct StreamWeight : public NativeWord {
+        void run(Stack& stack) override {
+            const auto& file = stack.pop_string();
+            const auto& name = stack.pop_string();
+            tensor_t obj_t = stack.pop_tensor();
+
+            LayerStream* stream;
+            memcpy( (char *)&stream, (char *)obj_t->device_data(), sizeof(LayerStream *));
+            stream->add_weight(name, file);
+        }
+        NWORD_CREATOR_DEFINE_LR(StreamWeight)
+    };
+
+    struct StreamBind : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t obj_t = stack.pop_tensor();
+            int layer = stack.pop_number();
+
+            LayerStream* stream;
+            memcpy( (char *)&stream, (char *)obj_t->device_data(), sizeof(LayerStream *));
+            stream->bind(layer);
+        }
+        NWORD_CREATOR_DEFINE_LR(StreamBind)
+    };
+
+    struct StreamNext : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t obj_t = stack.pop_tensor();
+            int layer = stack.pop_number();
+
+            LayerStream* stream;
+            memcpy( (char *)&stream, (char *)obj_t->device_data(), sizeof(LayerStream *));
+            stream->next(layer);
+        }
+        NWORD_CREATOR_DEFINE_LR(StreamNext)
+    };
+
+    struct StreamClose : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t obj_t = stack.pop_tensor();
+
+            LayerStream* stream;
+            memcpy( (char *)&stream, (char *)obj_t->device_data(), sizeof(LayerStream *));
+            delete stream;
+        }
+        NWORD_CREATOR_DEFINE_LR(StreamClose)
+    };
+    namespace _ {
+        // device to host copies are async, waiting them before bytes are used
+        void copy_to_host(tensor_t t, char* dst) {
+            std::vector<size_t> shape = t->shape().vec();
+            tensor_t h = create_host_view(t->dtype(), shape, dst);
+            h->op_copy(h, t);
+#ifdef _USING_DEVICE_CUDA_
+            if ( t->is_cuda() ) {
+                CUDA_CHECK(cudaStreamSynchronize(ComputingContext::cuda_stream));
+            }
+#endif
+#ifdef _USING_DEVICE_DCU_
+            if ( t->is_dcu() ) {
+                HIP_CHECK(hipStreamSynchronize(ComputingContext::dcu_stream));
+            }
+#endif
+#ifdef _USING_DEVICE_COREX_
+            if ( t->is_corex() ) {
+                COREX_CHECK(cudaStreamSynchronize(ComputingContext::corex_stream));
+            }
+#endif
+        }
+    }
+
+    // Engine snapshot is a weight pack holding resident tensors in their final layout ( after
+    // conversion, pre-packing, rotary tables ... ), with "__key__" and "__words__" entries to validate it.
+    // Key is stamped with size & mtime of the source file or every file of the source directory.
+    struct Snapshot {
+        using Entry = WeightPack::Entry;
+        static std::string stamp(const std::string& key) {
+            std::vector<std::string> files;
+            struct stat st;
+            if ( stat(key.c_str(), &st) != 0 ) {
+                return key;
+            }
+            if ( S_ISDIR(st.st_mode) ) {
+                DIR* d = opendir(key.c_str());
+                vt_assert(d != nullptr, "Can't open snapshot source directory");
+                for (struct dirent* e = readdir(d); e != nullptr; e = readdir(d)) {
+                    files.push_back(e->d_name);
+                }
+                closedir(d);
+                std::sort(files.begin(), files.end());
+            } else {
+                files.push_back("");
+            }
+
+            std::stringstream ss;
+            ss << key;
+            for (auto& f : files) {
+                std::string path = f == "" ? key : key + "/" + f;
+                if ( stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode) ) {
+                    continue;
+                }
+                ss << "\n" << f << " " << st.st_size << " " << st.st_mtim.tv_sec << "." << st.st_mtim.tv_nsec;
+            }
+            return ss.str();
+        }
+
+        static void save(Enviroment& env, const std::string& fileName, const std::string& source, const std::vector<std::string>& prefixes) {
+            const std::string key = stamp(source);
+            auto& hash = env.hash();
+            std::vector<std::pair<std::string, tensor_t>> tensors;
+            for (auto& name : hash.names()) {
+                auto& item = hash.find(name);
+                if ( !item.is_tensor() ) {
+                    continue;
+                }
+                for (auto& p : prefixes) {
+                    if ( name.compare(0, p.size(), p) == 0 ) {
+                        tensors.push_back( {name, item.as_tensor()} );
+                        break;
+                    }
+                }
+            }
+
+            // views ( like query/key/value of qkv_proj ) are restored with their owner
+            std::sort(tensors.begin(), tensors.end(), [](const std::pair<std::string, tensor_t>& a, const std::pair<std::string, tensor_t>& b) {
+                return std::get<1>(a.second->op_sizeof(a.second)) > std::get<1>(b.second->op_sizeof(b.second));
+            });
+            std::vector<Entry> entries;
+            std::map<std::string, tensor_t> saved;
+            for (auto& i : tensors) {
+                tensor_t t = i.second;
+                char* begin = (char *)t->device_data();
+                size_t size = std::get<1>(t->op_sizeof(t));
+                bool inside = false;
+                for (auto& s : saved) {
+                    char* sbegin = (char *)s.second->device_data();
+                    size_t ssize = std::get<1>(s.second->op_sizeof(s.second));
+                    if ( begin >= sbegin && begin + size <= sbegin + ssize ) {
+                        inside = true;
+                        break;
+                    }
+                }
+                if ( inside ) {
+                    continue;
+                }
+                saved[i.first] = t;
+
+                Entry e;
+                e.name = i.first;
+                e.dtype = DataType_name(t->dtype());
+                e.shape = t->shape().vec();
+                e.size = size;
+                entries.push_back(e);
+            }
+            std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+                return a.name < b.name;
+            });
+
+            std::string words = env.dump_words();
+            for (auto& meta : { std::make_pair("__key__", key), std::make_pair("__words__", words) } ) {
+                Entry e;
+                e.name = meta.first;
+                e.dtype = "raw";
+                e.size = meta.second.size();
+                e.shape.push_back(e.size);
+                entries.push_back(e);
+            }
+
+            size_t total = 0;
+            std::vector<char> staging;
+            WeightPack::write(fileName, entries, [&](Entry& e, std::ostream& os) {
+                const char* d = nullptr;
+                if ( e.name == "__key__" ) {
+                    d = key.c_str();
+                } else if ( e.name == "__words__" ) {
+                    d = words.c_str();
+                } else {
+                    tensor_t t = saved[e.name];
+                    if ( t->is_host() ) {
+                        d = (const char *)t->device_data();
+                    } else {
+                        staging.resize(e.size);
+                        _::copy_to_host(t, staging.data());
+                        d = staging.data();
+                    }
+                    total += e.size;
+                }
+                os.write(d, e.size);
+                return WeightPack::checksum(d, e.size);
+            });
+
+            std::cout << "Snapshot " << saved.size() << " tensors ( " << total / 1024.0 / 1024.0 << " MB ) into " << fileName << std::endl;
+        }
+
+        // false when snapshot is missing or made by other key/DAG, existed tensors are untouched
+        static bool load(Enviroment& env, const std::string& fileName, const std::string& source, int threads) {
+            if ( access(fileName.c_str(), R_OK) != 0 ) {
+                return false;
+            }
+            const std::string key = stamp(source);
+
+            WeightPack pack(fileName, 0);
+            auto meta = [&pack](const char* name) {
+                std::string v;
+                if ( pack.has(name) ) {
+                    auto& e = pack.find(name);
+                    v.resize(e.size);
+                    pack.read(e, (char *)v.data(), false);
+                }
+                return v;
+            };
+            if ( meta("__key__") != key ) {
+                std::cout << "Snapshot " << fileName << " is made with other key or changed weights, skipped." << std::endl;
+                return false;
+            }
+            if ( meta("__words__") != env.dump_words() ) {
+                std::cout << "Snapshot " << fileName << " is made by other DAG, skipped." << std::endl;
+                return false;
+            }
+
+            auto& hash = env.hash();
+            auto names = hash.names();
+            std::vector<std::pair<std::string, tensor_t>> targets;
+            for (auto& e : pack.entries()) {
+                if ( e.dtype == "raw" ) {
+                    continue;
+                }
+                tensor_t t = nullptr;
+                if ( std::binary_search(names.begin(), names.end(), e.name) && hash.find(e.name).is_tensor() ) {
+                    t = hash.find_tensor(e.name);
+                }
+                if ( t == nullptr || e.dtype != DataType_name(t->dtype()) || e.shape != t->shape().vec() ) {
+                    std::cout << "Snapshot " << fileName << " doesn't match tensor " << e.name << ", skipped." << std::endl;
+                    return false;
+                }
+                targets.push_back( {e.name, t} );
+            }
+
+            pack.start(threads);
+            for (auto& i : targets) {
+                pack.load(i.second, i.first);
+            }
+            std::cout << "Restored " << targets.size() << " tensors from snapshot " << fileName << std::endl;
+            return true;
+        }
+    };
+
+    struct SnapshotSave : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            int n = stack.pop_number();
+            std::vector<std::string> prefixes;
+            for (int i = 0; i < n; i++) {
+                prefixes.push_back( stack.pop_string() );
+            }
+            const auto& key = stack.pop_string();
+            const auto& fileName = stack.pop_string();
+            Snapshot::save(*env_, fileName, key, prefixes);
+        }
+        static NativeWord* creator(Enviroment& env) {
+            SnapshotSave* wd = new SnapshotSave();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+
+    struct SnapshotLoad : public NativeWord {
+        Enviroment* env_;
+        void run(Stack& stack) override {
+            int threads = stack.pop_number();
+            const auto& key = stack.pop_string();
+            const auto& fileName = stack.pop_string();
+            bool ret = Snapshot::load(*env_, fileName, key, threads);
+            stack.push_number(ret);
+        }
+        static NativeWord* creator(Enviroment& env) {
+            SnapshotLoad* wd = new SnapshotLoad();
+            wd->env_ = &env;
+            return wd;
+        }
+    };
+    // Named shared memory segment holding read only weights of all replicas on one host, the first
+    // process creates & populates it, others attach after it is ready. All replicas run same DAG, so
+    // tensors are allocated in same order, every slot records dtype & shape to check it.
+    struct SharedWeights {
+        static constexpr const char* magic = "VTSHARE3";
+        static const size_t max_slots = 4096;
+        static const size_t max_dims = 8;
+        static const size_t max_replicas = 256;
+
+        struct Header {
+            char magic[8];
+            std::atomic<int> state;         // 0 populating, 1 ready
+            pid_t owner;                    // process populating it
+            uint64_t size;
+            uint64_t count;
+            std::atomic<pid_t> replicas[max_replicas];      // attached processes, 0 is free
+        };
+        struct Slot {
+            char dtype[8];
+            uint64_t dim;
+            uint64_t shape[max_dims];
+            uint64_t offset;
+            uint64_t size;
+            uint64_t checksum;
+        };
+
+        SharedWeights(const std::string& name, size_t size) : name_(name), used_(0) {
+            data_ = WeightPack::round_page(sizeof(Header) + sizeof(Slot) * max_slots);
+            size_ = data_ + size;
+
+            // a segment left by a dead owner is removed, then created again
+            for (int i = 0; !open(); i++) {
+                vt_assert(i < 3, "Can't open shared weights");
+            }
+        }
+
+        // tensors created from the segment must not be used after closing, the last replica alive
+        // removes it, slots of crashed replicas are skipped
+        ~SharedWeights() {
+            header_->replicas[replica_] = 0;
+            if ( attached() == 0 ) {
+                unlink_segment(fd_);
+            }
+            munmap(base_, size_);
+            close(fd_);
+        }
+
+        tensor_t create(const std::string& device, DataType dtype, std::vector<size_t>& shape) {
+            size_t i = used_++;
+            vt_assert(i < max_slots, "Too many shared tensors");
+            vt_assert(shape.size() <= max_dims, "Too many dims of shared tensor");
+            Slot& slot = slots_[i];
+
+            size_t offset = data_;
+            if ( i > 0 ) {
+                offset = (slots_[i-1].offset + slots_[i-1].size + 63) / 64 * 64;
+            }
+            tensor_t t = view(device, dtype, shape, base_ + offset);
+            size_t size = std::get<1>(t->op_sizeof(t));
+
+            if ( owner_ ) {
+                vt_assert(offset + size <= size_, "Shared weights is out of memory");
+                memset(slot.dtype, 0, 8);
+                strncpy(slot.dtype, DataType_name(dtype), 7);
+                slot.dim = shape.size();
+                for (size_t j = 0; j < shape.size(); j++) {
+                    slot.shape[j] = shape[j];
+                }
+                slot.offset = offset;
+                slot.size = size;
+                slot.checksum = 0;
+                header_->count = used_;
+                return t;
+            }
+
+            bool same = i < header_->count && std::string(slot.dtype) == DataType_name(dtype) && slot.dim == shape.size()
+                        && slot.offset == offset && slot.size == size;
+            for (size_t j = 0; same && j < shape.size(); j++) {
+                same = slot.shape[j] == shape[j];
+            }
+            vt_assert(same, "Shared tensor doesn't match, shared weights is made by other DAG");
+            return t;
+        }
+
+        // only owner writes
+        void load(tensor_t t, const std::string& fileName) {
+            if ( owner_ ) {
+                t->io_load(t, fileName.c_str());
+            }
+        }
+
+        // owner records checksums and publishes, others check integrity when verify is set
+        void ready(bool verify) {
+            vt_assert(used_ == header_->count, "Shared tensors are less than owner's");
+            if ( owner_ ) {
+#pragma omp parallel for
+                for (size_t i = 0; i < used_; i++) {
+                    slots_[i].checksum = WeightPack::checksum(base_ + slots_[i].offset, slots_[i].size);
+                }
+                mprotect(base_ + data_, size_ - data_, PROT_READ);
+                header_->state.store(1, std::memory_order_release);
+                std::cout << "Shared weights " << name_ << " is ready." << std::endl;
+                return;
+            }
+            if ( verify ) {
+                int broken = 0;
+#pragma omp parallel for reduction(+:broken)
+                for (size_t i = 0; i < used_; i++) {
+                    if ( WeightPack::checksum(base_ + slots_[i].offset, slots_[i].size) != slots_[i].checksum ) {
+                        broken++;
+                    }
+                }
+                vt_assert(broken == 0, "Shared weights is broken");
+            }
+        }
+
+    private:
+        static bool alive(pid_t pid) {
+            return kill(pid, 0) == 0 || errno == EPERM;
+        }
+
+        // replicas alive, slots of dead ones are freed
+        size_t attached() {
+            size_t n = 0;
+            for (size_t i = 0; i < max_replicas; i++) {
+                pid_t pid = header_->replicas[i].load();
+                if ( pid == 0 ) {
+                    continue;
+                }
+                if ( alive(pid) ) {
+                    n++;
+                } else {
+                    header_->replicas[i].compare_exchange_strong(pid, 0);
+                }
+            }
+            return n;
+        }
+
+        void attach() {
+            attached();
+            for (size_t i = 0; i < max_replicas; i++) {
+                pid_t free = 0;
+                if ( header_->replicas[i].compare_exchange_strong(free, getpid()) ) {
+                    replica_ = i;
+                    return;
+                }
+            }
+            vt_panic("Too many replicas of shared weights");
+        }
+
+        // removes the name only when it still refers to segment of fd, replicas recovering from a dead
+        // owner hold the lock of old segment in turn, so a segment created again isn't removed
+        void unlink_segment(int fd) {
+            flock(fd, LOCK_EX);
+            struct stat mine, now;
+            int cur = shm_open(name_.c_str(), O_RDWR, 0600);
+            if ( cur >= 0 ) {
+                if ( fstat(fd, &mine) == 0 && fstat(cur, &now) == 0 && mine.st_ino == now.st_ino ) {
+                    shm_unlink(name_.c_str());
+                }
+                close(cur);
+            }
+            flock(fd, LOCK_UN);
+        }
+
+        // false when owner died before segment is ready
+        bool open() {
+            int fd = shm_open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+            owner_ = fd >= 0;
+            if ( owner_ ) {
+                vt_assert( ftruncate(fd, size_) == 0, "Can't resize shared weights");
+            } else {
+                fd = shm_open(name_.c_str(), O_RDWR, 0600);
+                if ( fd < 0 ) {
+                    std::cout << "Can't open shared weights " << name_ << std::endl;
+                    vt_panic("Can't open shared weights");
+                }
+                // owner may not have resized it yet
+                struct stat st;
+                for (int i = 0; fstat(fd, &st) == 0 && (size_t)st.st_size < size_; i++) {
+                    vt_assert(i < 1000, "Shared weights has wrong size");
+                    usleep(10 * 1000);
+                }
+            }
+            base_ = (char *)mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            vt_assert( base_ != MAP_FAILED, "mmap shared weights failed");
+            header_ = (Header *)base_;
+            slots_ = (Slot *)(base_ + sizeof(Header));
+
+            if ( owner_ ) {
+                new (header_) Header();
+                header_->owner = getpid();
+                header_->size = size_;
+                header_->count = 0;
+                header_->state = 0;
+                fd_ = fd;
+                attach();
+                // magic is written last, replicas read owner after seeing it
+                memcpy(header_->magic, magic, 8);
+                std::cout << "Created shared weights " << name_ << ", populating it." << std::endl;
+                return true;
+            }
+
+            // waiting owner finishing loading, checking owner is alive
+            const int timeout = 10 * 60 * 10;
+            for (int i = 0; header_->state.load(std::memory_order_acquire) != 1; i++) {
+                bool started = memcmp(header_->magic, magic, 8) == 0;
+                if ( (started && !alive(header_->owner)) || (!started && i == 10 * 10) ) {
+                    std::cout << "Owner of shared weights " << name_ << " died before it's ready, recreating it." << std::endl;
+                    munmap(base_, size_);
+                    unlink_segment(fd);
+                    close(fd);
+                    return false;
+                }
+                if ( i == timeout ) {
+                    std::cout << "Shared weights " << name_ << " isn't ready after 10 minutes, owner " << header_->owner << " is still alive." << std::endl;
+                    vt_panic("Shared weights isn't ready");
+                }
+                usleep(100 * 1000);
+            }
+            vt_assert( memcmp(header_->magic, magic, 8) == 0 && header_->size == size_, "Shared weights is made by other DAG");
+            fd_ = fd;
+            attach();
+            mprotect(base_ + data_, size_ - data_, PROT_READ);
+            std::cout << "Attached shared weights " << name_ << " ( " << attached() << " replicas )" << std::endl;
+            return true;
+        }
+
+        static tensor_t view(const std::string& device, DataType dtype, std::vector<size_t>& shape, void* mem) {
+            if ( device == "host" ) {
+                return create_host_view(dtype, shape, mem);
+            }
+#ifdef _USING_DEVICE_DNNL_
+            if ( device == "dnnl" ) {
+                return create_dnnl_view(dtype, shape, mem);
+            }
+#endif
+            vt_panic("Shared weights only support host & dnnl ( CPU ) tensors");
+            return nullptr;
+        }
+
+        const std::string name_;
+        bool owner_;
+        int fd_;                // kept open for locking the segment
+        size_t replica_;        // slot in replicas
+        char* base_;
+        size_t size_;
+        size_t data_;
+        size_t used_;
+        Header* header_;
+        Slot* slots_;
+    };
+
+    struct SharedOpen : public NativeWord {
+        void run(Stack& stack) override {
+            size_t size = stack.pop_number();
+            const auto& name = stack.pop_string();
+            SharedWeights* shared = new SharedWeights(name, size);
+
+            // pass object's address to tensor
+            std::vector<size_t> obj_shape;
+            obj_shape.push_back( sizeof(SharedWeights *) );
+            tensor_t obj_t = vt::create_host_int(obj_shape);
+            memcpy((char *)obj_t->device_data(), (char *)&shared, sizeof(SharedWeights *));
+            stack.push_tensor(obj_t);
+        }
+        NWORD_CREATOR_DEFINE_LR(SharedOpen)
+    };
+
+    // same order with op.create, object is replacing device
+    struct SharedCreate : public NativeWord {
+        void run(Stack& stack) override {
+            vt::DataType dtype = DataType_from( stack.pop_string().c_str() );
+            tensor_t obj_t = stack.pop_tensor();
+            const auto& device = stack.pop_string();
+            std::vector<size_t> shape;
+            for (auto n : stack.pop_number_list()) {
+                shape.push_back(n);
+            }
+
+            SharedWeights* shared;
+            memcpy( (char *)&shared, (char *)obj_t->device_data(), sizeof(SharedWeights *));
+            stack.push_tensor( shared->create(device, dtype, shape) );
+        }
+        NWORD_CREATOR_DEFINE_LR(SharedCreate)
+    };
+
+    struct SharedLoad : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t obj_t = stack.pop_tensor();
+            const auto& fileName = stack.pop_string();
+            tensor_t x = stack.pop_tensor();
+
+            SharedWeights* shared;
+            memcpy( (char *)&shared, (char *)obj_t->device_data(), sizeof(SharedWeights *));
+            shared->load(x, fileName);
+        }
+        NWORD_CREATOR_DEFINE_LR(SharedLoad)
+    };
+
+    struct SharedReady : public NativeWord {
+        void run(Stack& stack) override {
+            bool verify = stack.pop_number();
+            tensor_t obj_t = stack.pop_tensor();
+
+            SharedWeights* shared;
+            memcpy( (char *)&shared, (char *)obj_t->device_data(), sizeof(SharedWeights *));
+            shared->ready(verify);
+        }
+        NWORD_CREATOR_DEFINE_LR(SharedReady)
+    };
+
+    struct SharedClose : public NativeWord {
+        void run(Stack& stack) override {
+            tensor_t obj_t = stack.pop_tensor();
+
+            SharedWeights* shared;
+            memcpy( (char *)&shared, (char *)obj_t->device_data(), sizeof(SharedWeights *));
+            delete shared;
+        }
+        NWORD_CREATOR_DEFINE_LR(SharedClose)
+    };
+}
+
+
+void load_nn_weights(Enviroment& env) {
+    env.insert_native_word("io.pack_dir", io::PackDir::creator);
+    env.insert_native_word("io.pack_open", io::PackOpen::creator);
+    env.insert_native_word("io.pack_load", io::PackLoad::creator);
+    env.insert_native_word("io.pack_close", io::PackClose::creator);
+    env.insert_native_word("io.stream_open", io::StreamOpen::creator);
+    env.insert_native_word("io.stream_weight", io::StreamWeight::creator);
+    env.insert_native_word("io.stream_bind", io::StreamBind::creator);
+    env.insert_native_word("io.stream_next", io::StreamNext::creator);
+    env.insert_native_word("io.stream_close", io::StreamClose::creator);
+    env.insert_native_word("io.snapshot_save", io::SnapshotSave::creator);
+    env.insert_native_word("io.snapshot_load", io::SnapshotLoad::creator);
+    env.insert_native_word("io.shared_open", io::SharedOpen::creator);
+    env.insert_native_word("io.shared_create", io::SharedCreate::creator);
+    env.insert_native_word("io.shared_load", io::SharedLoad::creator);
+    env.insert_native_word("io.shared_ready", io::SharedReady::creator);
+    env.insert_native_word("io.shared_close", io::SharedClose::creator);
+}
+
+}// end of namespace vt
@@ -114,7 +114,9 @@ std::variant<ComputingReturn, tensor_t> TensorType::op_view(tensor_t self, size_
 
     ShapeType s(newShape);
     vt_assert(offset + s.numel() <= items() , "view out of shape!");
+    vt_assert(shape_.is_contiguous(), "Can't view a strided view");
     auto result = impl()->op_view(self, offset, newShape);
+    viewed_ = true;
     if ( result.index() == 0) {
         ComputingReturn ret = std::get<0>(result);
         op_check(ret, "view");
@@ -125,6 +127,7 @@ std::variant<ComputingReturn, tensor_t> TensorType::op_view(tensor_t self, size_
 std::variant<ComputingReturn, tensor_t> TensorType::op_view_as(tensor_t self, size_t offset, const std::vector<size_t>& newShape_, const char* dtype_ ) {
     vt_assert(self.get() == this, "can't be here!");
     auto result = impl()->op_view_as(self, offset, newShape_, dtype_);
+    viewed_ = true;
     if ( result.index() == 0) {
         ComputingReturn ret = std::get<0>(result);
         op_check(ret, "view_as");
@@ -132,6 +135,42 @@ std::variant<ComputingReturn, tensor_t> TensorType::op_view_as(tensor_t self, si
     return result;
 }
 
+std::variant<ComputingReturn, tensor_t> TensorType::op_view_strided(tensor_t self, size_t offset, const std::vector<size_t>& newShape, const std::vector<size_t>& newStrides) {
+    vt_assert(self.get() == this, "can't be here!");
+    ShapeType s(newShape, newStrides);
+    vt_assert(offset + s.span() <= items() , "view out of shape!");
+    vt_assert(shape_.is_contiguous(), "Can't view a strided view");
+    auto result = impl()->op_view_strided(self, offset, newShape, newStrides);
+    viewed_ = true;
+    if ( result.index() == 0) {
+        ComputingReturn ret = std::get<0>(result);
+        op_check(ret, "view_strided");
+    }
+    return result;
+}
+
+// moves a view created by op_view to another place of parent in place, OP_TODO_ERROR is returned
+// when backend can't do it, so callers create a new view instead.
+ComputingReturn TensorType::op_view_rebind(tensor_t self, tensor_t parent, size_t offset, const std::vector<size_t>& newShape) {
+    vt_assert(self.get() == this, "can't be here!");
+    vt_assert(parent->dtype() == dtype() && parent->device_name() == device_name(), "Rebind view must have same dtype & device with parent");
+    vt_assert(parent->shape().is_contiguous(), "Can't view a strided view");
+    size_t items = 1;
+    for (size_t i = 0; i < newShape.size(); i++) {
+        items *= newShape[i];
+    }
+    vt_assert(offset + items <= parent->items() , "view out of shape!");
+    auto ret = impl()->op_view_rebind(self, parent, offset, newShape);
+    parent->viewed_ = true;
+    if ( ret == OP_TODO_ERROR ) {
+        return ret;
+    }
+    if ( ret == OP_OK ) {
+        shape_.reset(newShape);
+    }
+    op_check(ret, "view_rebind");
+}
+
 ComputingReturn TensorType::op_reshape(tensor_t self, size_t offset, const std::vector<size_t>& newShape_) {
     vt_assert(self.get() == this, "can't be here!");
 
@@ -268,6 +307,13 @@ ComputingReturn TensorType::op_attn(tensor_t self, tensor_t v, tensor_t attn) {
     op_check(ret, "attn");
 }
 
+ComputingReturn TensorType::op_attn_score(tensor_t self, tensor_t score) {
+    vt_assert(self.get() == this, "can't be here!");
+    vt_assert(score->is_host() && score->is_float(), "attn_score accumulates into host float tensor");
+    auto ret = impl()->op_attn_score(self, score);
+    op_check(ret, "attn_score");
+}
+
 ComputingReturn TensorType::op_xattn(tensor_t self, tensor_t k, tensor_t v, tensor_t qk, tensor_t attn) {
     vt_assert(self.get() == this, "can't be here!");
     auto ret = impl()->op_xattn(self, k, v, qk, attn);
@@ -286,6 +332,52 @@ ComputingReturn TensorType::op_silu_product(tensor_t self, tensor_t up, tensor_t
     op_check(ret, "silu_product");
 }
 
+// fused words return OP_TODO_ERROR without panic, callers run the sequence then
+ComputingReturn TensorType::op_linear_add(tensor_t self, tensor_t w, tensor_t bias, tensor_t y, tensor_t r, tensor_t out) {
+    vt_assert(self.get() == this, "can't be here!");
+    vt_assert(shape().dim() == 3, " linear input shape: [batch, len, hidden] ");
+    vt_assert(w->shape().dim() == 2, " linear weight shape: [outSize, inSize] ");
+    vt_assert(w->shape()[1] == shape()[2], " linear input and weight must match" );
+    if ( r->shape() != y->shape() || out->shape() != y->shape() ) {
+        return OP_TODO_ERROR;
+    }
+    auto ret = impl()->op_linear_add(self, w, bias, y, r, out);
+    if ( ret == OP_TODO_ERROR ) {
+        return ret;
+    }
+    op_check(ret, "linear_add");
+}
+
+ComputingReturn TensorType::op_add_rmsnorm(tensor_t self, tensor_t b, tensor_t c, tensor_t scale, tensor_t norm2, tensor_t y, float eps) {
+    vt_assert(self.get() == this, "can't be here!");
+    vt_assert(self->shape().dim() == 3, "rmsnorm size error!");
+    vt_assert(y->shape() == self->shape(), "rmsnorm size error!");
+    vt_assert(self->shape()[-1] == scale->shape()[-1] , "rmsnorm size error!");
+    if ( b->shape() != shape() || c->shape() != shape() ) {
+        return OP_TODO_ERROR;
+    }
+    auto ret = impl()->op_add_rmsnorm(self, b, c, scale, norm2, y, eps);
+    if ( ret == OP_TODO_ERROR ) {
+        return ret;
+    }
+    op_check(ret, "add_rmsnorm");
+}
+
+ComputingReturn TensorType::op_linear_silu_product(tensor_t self, tensor_t w, tensor_t bias, tensor_t y, tensor_t up, tensor_t out) {
+    vt_assert(self.get() == this, "can't be here!");
+    vt_assert(shape().dim() == 3, " linear input shape: [batch, len, hidden] ");
+    vt_assert(w->shape().dim() == 2, " linear weight shape: [outSize, inSize] ");
+    vt_assert(w->shape()[1] == shape()[2], " linear input and weight must match" );
+    if ( up->shape() != y->shape() || out->shape() != y->shape() ) {
+        return OP_TODO_ERROR;
+    }
+    auto ret = impl()->op_linear_silu_product(self, w, bias, y, up, out);
+    if ( ret == OP_TODO_ERROR ) {
+        return ret;
+    }
+    op_check(ret, "linear_silu_product");
+}
+
 std::variant<ComputingReturn, int> TensorType::op_all_logits(tensor_t self, tensor_t mask, tensor_t lm_head, tensor_t output) {
     vt_assert(self.get() == this, "can't be here!");
     auto ret = impl()->op_all_logits(self, mask, lm_head, output);
@@ -316,6 +408,15 @@ std::variant<ComputingReturn, tensor_t> TensorType::op_sampling_top3(tensor_t se
     return ret;
 }
 
+ComputingReturn TensorType::op_logprob_topk(tensor_t self, tensor_t ids, tensor_t logprob, float temp) {
+    vt_assert(self.get() == this, "can't be here!");
+    vt_assert(ids->is_host() && ids->dtype() == DataType::Int, "logprob_topk output ids must be host int");
+    vt_assert(logprob->is_host() && logprob->is_float(), "logprob_topk output logprob must be host float");
+    vt_assert(ids->shape() == logprob->shape(), "logprob_topk outputs must have same shape");
+    auto ret = impl()->op_logprob_topk(self, ids, logprob, temp);
+    op_check(ret, "logprob_topk");
+}
+
 ComputingReturn TensorType::op_conv2d(tensor_t self, tensor_t weight, tensor_t bias, tensor_t dst, int stride, int padding) {
     vt_assert(self.get() == this, "can't be here!");
     // checking shape
@@ -403,6 +504,16 @@ ComputingReturn TensorType::io_save(tensor_t self, const char* fileName) {
     op_check(ret, "save");
 }
 
+ComputingReturn TensorType::io_mmap(tensor_t self, const char* fileName, bool populate) {
+    vt_assert(this == self.get() , "can't be here!");
+    // views taken before would be left on the freed memory, so the file is read into it
+    if ( viewed_ ) {
+        return io_load(self, fileName);
+    }
+    auto ret = impl()->io_mmap(self, fileName, populate);
+    op_check(ret, "mmap");
+}
+
 ComputingReturn TensorType::io_dump(tensor_t self) {
     vt_assert(self.get() == this, "can't be here!");
     std::cout << "--------------" << std::endl;
@@ -453,6 +564,18 @@ ComputingReturn TensorType::io_pipe_write(tensor_t self, int n) {
     op_check(ret, "pipe_write");
 }
 
+ComputingReturn TensorType::io_pipe_send(tensor_t self, int n) {
+    vt_assert(self.get() == this, "can't be here!");
+    auto ret = impl()->io_pipe_send(self, n);
+    op_check(ret, "pipe_send");
+}
+
+ComputingReturn TensorType::io_pipe_recv(tensor_t self, int n) {
+    vt_assert(self.get() == this, "can't be here!");
+    auto ret = impl()->io_pipe_recv(self, n);
+    op_check(ret, "pipe_recv");
+}
+
 TensorType::~TensorType() {
     if ( impl_index() == ImplType::HOST_FLOAT ) {
         host_float_t* tensor = std::get<HOST_FLOAT>(impl_);
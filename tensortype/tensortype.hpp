@@ -89,6 +89,22 @@ public:
             numel_ *= dims_[i];
         }
     }
+    // keeps storage, rebinding views in decoding loop doesn't allocate
+    void reset(const std::vector<size_t>& dims) {
+        dims_.assign(dims.begin(), dims.end());
+        strides_.clear();
+        numel_ = 1;
+        for(size_t i = 0; i < dims_.size(); i++) {
+            vt_assert( dims_[i] > 0, "Don't support zero dim vector");
+            numel_ *= dims_[i];
+        }
+    }
+    ShapeType(const std::vector<size_t>& dims, const std::vector<size_t>& strides) : ShapeType(dims) {
+        vt_assert( strides.size() == dims.size(), "Strides must have same dims with shape");
+        if ( strides != dense_strides() ) {
+            strides_ = strides;
+        }
+    }
     // all kinds accessors
     size_t numel() const {
         return numel_;
@@ -96,6 +112,25 @@ public:
     const std::vector<size_t>& vec() const {
         return dims_;
     }
+    // items between neighbours of each dim, views made by op_view_strided may not be row major
+    std::vector<size_t> strides() const {
+        if ( strides_.size() > 0 ) {
+            return strides_;
+        }
+        return dense_strides();
+    }
+    bool is_contiguous() const {
+        return strides_.size() == 0;
+    }
+    // items from first to last element
+    size_t span() const {
+        auto st = strides();
+        size_t s = 1;
+        for (size_t i = 0; i < dims_.size(); i++) {
+            s += (dims_[i] - 1) * st[i];
+        }
+        return s;
+    }
     const size_t* dims() const {
         return &dims_[0];
     }
@@ -140,11 +175,27 @@ public:
             ss << dims_[i] << " ";
         }
         ss << "]";
+        if ( strides_.size() > 0 ) {
+            ss << "/[";
+            for (size_t i = 0; i < dim(); i++) {
+                ss << strides_[i] << " ";
+            }
+            ss << "]";
+        }
         return ss.str();
     }
 
 private:
+    std::vector<size_t> dense_strides() const {
+        std::vector<size_t> st(dims_.size(), 1);
+        for (int i = (int)dims_.size() - 2; i >= 0; i--) {
+            st[i] = st[i+1] * dims_[i+1];
+        }
+        return st;
+    }
+
     std::vector<size_t>  dims_;
+    std::vector<size_t>  strides_;      // empty for contiguous
     mutable size_t numel_;
 };
 
@@ -762,6 +813,8 @@ public:
     ComputingReturn op_convert(tensor_t self, tensor_t src) override;
     std::variant<ComputingReturn, tensor_t> op_view(tensor_t self, size_t offset, const std::vector<size_t>& newShape) override;
     std::variant<ComputingReturn, tensor_t> op_view_as(tensor_t self, size_t offset, const std::vector<size_t>& newShape, const char* dtype) override;
+    std::variant<ComputingReturn, tensor_t> op_view_strided(tensor_t self, size_t offset, const std::vector<size_t>& newShape, const std::vector<size_t>& newStrides) override;
+    ComputingReturn op_view_rebind(tensor_t self, tensor_t parent, size_t offset, const std::vector<size_t>& newShape) override;
     ComputingReturn op_reshape(tensor_t self, size_t offset, const std::vector<size_t>& newShape) override;
     ComputingReturn op_quantize(tensor_t self, tensor_t out) override;
     ComputingReturn op_dequantize(tensor_t self, tensor_t out) override;
@@ -779,12 +832,17 @@ public:
     ComputingReturn op_qk(tensor_t self, tensor_t k, tensor_t qk) override;
     ComputingReturn op_softmax(tensor_t self, tensor_t out) override ;
     ComputingReturn op_attn(tensor_t self, tensor_t v, tensor_t attn) override;
+    ComputingReturn op_attn_score(tensor_t self, tensor_t score) override;
     ComputingReturn op_xattn(tensor_t self, tensor_t k, tensor_t v, tensor_t qk, tensor_t attn) override;
     ComputingReturn op_gelu(tensor_t self, tensor_t dst) override;
     ComputingReturn op_silu_product(tensor_t self, tensor_t up, tensor_t dst) override;
+    ComputingReturn op_linear_add(tensor_t self, tensor_t w, tensor_t bias, tensor_t y, tensor_t r, tensor_t out) override;
+    ComputingReturn op_add_rmsnorm(tensor_t self, tensor_t b, tensor_t c, tensor_t scale, tensor_t norm2, tensor_t y, float eps) override;
+    ComputingReturn op_linear_silu_product(tensor_t self, tensor_t w, tensor_t bias, tensor_t y, tensor_t up, tensor_t out) override;
     std::variant<ComputingReturn, int> op_all_logits(tensor_t self, tensor_t mask,  tensor_t lm_head, tensor_t output) override;
     std::variant<ComputingReturn, tensor_t> op_sampling_top1(tensor_t self) override;
     std::variant<ComputingReturn, tensor_t> op_sampling_top3(tensor_t self, float temp) override;
+    ComputingReturn op_logprob_topk(tensor_t self, tensor_t ids, tensor_t logprob, float temp) override;
     ComputingReturn op_conv2d(tensor_t self, tensor_t weight, tensor_t bias, tensor_t dst, int stride, int padding) override;
     ComputingReturn op_flash_attention(tensor_t query, tensor_t key, tensor_t value, tensor_t dst) override;
     std::variant<ComputingReturn, float> op_loss_backward(tensor_t self, tensor_t ids, tensor_t mask, tensor_t lm_head, tensor_t all_logits, tensor_t x_g, tensor_t lm_head_g) override;
@@ -799,6 +857,7 @@ public:
 
     ComputingReturn io_load(tensor_t self, const char* fileName) override;
     ComputingReturn io_save(tensor_t self, const char* fileName) override;
+    ComputingReturn io_mmap(tensor_t self, const char* fileName, bool populate) override;
     ComputingReturn io_dump(tensor_t self) override;
     ComputingReturn io_mpi_bcast(tensor_t self, int root) override;
     ComputingReturn io_mpi_recv(tensor_t self, int source) override;
@@ -807,11 +866,14 @@ public:
     ComputingReturn io_nccl_send(tensor_t self, int dst) override;
     ComputingReturn io_pipe_read(tensor_t self) override;
     ComputingReturn io_pipe_write(tensor_t self, int n) override;
+    ComputingReturn io_pipe_send(tensor_t self, int n) override;
+    ComputingReturn io_pipe_recv(tensor_t self, int n) override;
 
 private:
     // basic info about tensor
     ShapeType shape_;
     const DataType  dtype_;
+    bool viewed_ = false;       // views point into the storage, it can't be moved any more
 
     // ImplType enum order is same as TensorImpl's variant
     enum ImplType {
@@ -916,6 +978,7 @@ tensor_t create_host_int(std::vector<size_t>& shape);
 tensor_t create_host_q8(std::vector<size_t>& shape);
 tensor_t create_host_q4(std::vector<size_t>& shape);
 tensor_t create_host_pq(std::vector<size_t>& shape, int S);
+tensor_t create_host_view(DataType dtype, std::vector<size_t>& shape, void* mem);
 
 #ifdef _USING_DEVICE_CUDA_
 tensor_t create_cuda_float(std::vector<size_t>& shape);
@@ -955,6 +1018,7 @@ tensor_t create_dnnl_float(std::vector<size_t>& shape, bool gpu = false);
 tensor_t create_dnnl_fp16(std::vector<size_t>& shape, bool gpu = false);
 tensor_t create_dnnl_int(std::vector<size_t>& shape, bool gpu = false);
 tensor_t create_dnnl_q8(std::vector<size_t>& shape, bool gpu = false);
+tensor_t create_dnnl_view(DataType dtype, std::vector<size_t>& shape, void* mem);
 #endif
 
 